@@ -0,0 +1,655 @@
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "asm.h"
+
+#define MAX_LABELS 1024
+#define MAX_LABEL_LEN 64
+#define MAX_OPERANDS 16
+#define MAX_LINE_LEN 256
+#define MAX_REP_DEPTH 8
+
+typedef struct SourceLine
+{
+    const char *text;
+    unsigned int number;
+} SourceLine;
+
+typedef struct Label
+{
+    char name[MAX_LABEL_LEN];
+    uint16_t addr;
+} Label;
+
+typedef struct Assembler
+{
+    SourceLine *lines;
+    unsigned int line_count;
+    unsigned int line_capacity;
+    Label labels[MAX_LABELS];
+    unsigned int label_count;
+    uint8_t *program;
+    unsigned int len;
+    int pass;
+    unsigned int current_line;
+    char *error;
+    size_t error_size;
+} Assembler;
+
+typedef struct Statement
+{
+    char buffer[MAX_LINE_LEN];
+    char *label;
+    char *mnemonic;
+    char *operands[MAX_OPERANDS];
+    int operand_count;
+} Statement;
+
+static int SplitLines(Assembler *as, char *source, SourceLine **raw_lines, unsigned int *raw_count);
+static int ExpandLines(Assembler *as, SourceLine *raw_lines, unsigned int start, unsigned int end, unsigned int depth);
+static void AppendLine(Assembler *as, SourceLine line);
+static int FindMatchingEndr(SourceLine *raw_lines, unsigned int start, unsigned int end);
+static int ParseDirectiveCount(const char *text, const char *directive, long *count);
+static int ParseStatement(Assembler *as, const char *text, Statement *statement);
+static int RunPass(Assembler *as, int pass);
+static int DefineLabel(Assembler *as, const char *name);
+static int EmitStatement(Assembler *as, Statement *statement);
+static int EmitByte(Assembler *as, uint8_t byte);
+static int EncodeInstruction(Assembler *as, Statement *statement, uint16_t *opcode);
+static int ParseRegister(const char *operand, uint8_t *reg);
+static int EvaluateValue(Assembler *as, const char *operand, long max, long *value);
+static int EvaluateTerm(Assembler *as, const char *term, size_t len, long *value);
+static int Fail(Assembler *as, const char *fmt, ...);
+static char *Trim(char *str);
+
+int Asm_Assemble(const char *source, uint8_t program[ASM_PROGRAM_MAX_LEN], unsigned int *len, char *error, size_t error_size)
+{
+    Assembler *as = calloc(1, sizeof(Assembler));
+    char *source_copy = strdup(source);
+    SourceLine *raw_lines = NULL;
+    unsigned int raw_count = 0;
+    int ret = -1;
+
+    as->program = program;
+    as->error = error;
+    as->error_size = error_size;
+
+    if (error_size > 0) error[0] = 0;
+
+    if (SplitLines(as, source_copy, &raw_lines, &raw_count) == 0 &&
+            ExpandLines(as, raw_lines, 0, raw_count, 0) == 0 &&
+            RunPass(as, 1) == 0 &&
+            RunPass(as, 2) == 0)
+    {
+        *len = as->len;
+        ret = 0;
+    }
+
+    free(raw_lines);
+    free(as->lines);
+    free(source_copy);
+    free(as);
+
+    return ret;
+}
+
+static int SplitLines(Assembler *as, char *source, SourceLine **raw_lines, unsigned int *raw_count)
+{
+    unsigned int capacity = 0;
+    unsigned int number = 1;
+    char *line = source;
+
+    while (line)
+    {
+        char *next = strchr(line, '\n');
+
+        if (next) *next++ = 0;
+
+        char *comment = strchr(line, ';');
+
+        if (comment) *comment = 0;
+
+        if (strlen(line) >= MAX_LINE_LEN)
+        {
+            as->current_line = number;
+            return Fail(as, "line too long");
+        }
+
+        if (*raw_count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 256;
+            *raw_lines = realloc(*raw_lines, sizeof(SourceLine) * capacity);
+        }
+
+        (*raw_lines)[(*raw_count)++] = (SourceLine){Trim(line), number++};
+        line = next;
+    }
+
+    return 0;
+}
+
+static int ExpandLines(Assembler *as, SourceLine *raw_lines, unsigned int start, unsigned int end, unsigned int depth)
+{
+    for (unsigned int i = start; i < end; i++)
+    {
+        long count;
+
+        as->current_line = raw_lines[i].number;
+
+        if (strncasecmp(raw_lines[i].text, ".endr", 5) == 0)
+        {
+            return Fail(as, ".endr without .rep");
+        }
+
+        if (!ParseDirectiveCount(raw_lines[i].text, ".rep", &count))
+        {
+            AppendLine(as, raw_lines[i]);
+            continue;
+        }
+
+        if (count < 0 || depth >= MAX_REP_DEPTH)
+        {
+            return Fail(as, "invalid .rep (count must be positive, at most %d nested .rep)", MAX_REP_DEPTH);
+        }
+
+        int endr = FindMatchingEndr(raw_lines, i + 1, end);
+
+        if (endr < 0)
+        {
+            return Fail(as, ".rep without .endr");
+        }
+
+        for (long r = 0; r < count; r++)
+        {
+            if (ExpandLines(as, raw_lines, i + 1, endr, depth + 1) < 0)
+            {
+                return -1;
+            }
+        }
+
+        i = endr;
+    }
+
+    return 0;
+}
+
+static void AppendLine(Assembler *as, SourceLine line)
+{
+    if (line.text[0] == 0)
+    {
+        return;
+    }
+
+    if (as->line_count == as->line_capacity)
+    {
+        as->line_capacity = as->line_capacity ? as->line_capacity * 2 : 256;
+        as->lines = realloc(as->lines, sizeof(SourceLine) * as->line_capacity);
+    }
+
+    as->lines[as->line_count++] = line;
+}
+
+static int FindMatchingEndr(SourceLine *raw_lines, unsigned int start, unsigned int end)
+{
+    int nesting = 0;
+    long count;
+
+    for (unsigned int i = start; i < end; i++)
+    {
+        if (ParseDirectiveCount(raw_lines[i].text, ".rep", &count))
+        {
+            nesting++;
+        }
+        else if (strncasecmp(raw_lines[i].text, ".endr", 5) == 0)
+        {
+            if (nesting == 0) return i;
+
+            nesting--;
+        }
+    }
+
+    return -1;
+}
+
+static int ParseDirectiveCount(const char *text, const char *directive, long *count)
+{
+    size_t len = strlen(directive);
+
+    if (strncasecmp(text, directive, len) != 0 || !isspace((unsigned char)text[len]))
+    {
+        return 0;
+    }
+
+    *count = strtol(text + len, NULL, 0);
+
+    return 1;
+}
+
+static int ParseStatement(Assembler *as, const char *text, Statement *statement)
+{
+    memset(statement, 0, sizeof(Statement));
+    strcpy(statement->buffer, text);
+
+    char *cursor = statement->buffer;
+
+    // the disassembler prints the address of each instruction first, skip it
+    if (cursor[0] == '0' && (cursor[1] == 'x' || cursor[1] == 'X'))
+    {
+        char *end = cursor + 2;
+
+        while (isxdigit((unsigned char)*end)) end++;
+
+        if (isspace((unsigned char)*end))
+        {
+            cursor = Trim(end);
+        }
+    }
+
+    char *colon = strchr(cursor, ':');
+
+    if (colon)
+    {
+        *colon = 0;
+        statement->label = Trim(cursor);
+        cursor = Trim(colon + 1);
+    }
+
+    if (*cursor == 0)
+    {
+        return 0;
+    }
+
+    statement->mnemonic = cursor;
+
+    while (*cursor && !isspace((unsigned char)*cursor)) cursor++;
+
+    if (*cursor) *cursor++ = 0;
+
+    // "SHR Vx {, Vy}" is printed with the optional operand between braces
+    for (char *c = cursor; *c; c++)
+    {
+        if (*c == '{' || *c == '}') *c = ' ';
+    }
+
+    cursor = Trim(cursor);
+
+    while (*cursor)
+    {
+        if (statement->operand_count == MAX_OPERANDS)
+        {
+            return Fail(as, "too many operands");
+        }
+
+        char *comma = strchr(cursor, ',');
+
+        if (comma) *comma = 0;
+
+        statement->operands[statement->operand_count++] = Trim(cursor);
+
+        if (!comma) break;
+
+        cursor = comma + 1;
+    }
+
+    return 0;
+}
+
+static int RunPass(Assembler *as, int pass)
+{
+    Statement statement;
+
+    as->pass = pass;
+    as->len = 0;
+
+    for (unsigned int i = 0; i < as->line_count; i++)
+    {
+        as->current_line = as->lines[i].number;
+
+        if (ParseStatement(as, as->lines[i].text, &statement) < 0)
+        {
+            return -1;
+        }
+
+        if (pass == 1 && statement.label && DefineLabel(as, statement.label) < 0)
+        {
+            return -1;
+        }
+
+        if (statement.mnemonic && EmitStatement(as, &statement) < 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int DefineLabel(Assembler *as, const char *name)
+{
+    if (strlen(name) == 0 || strlen(name) >= MAX_LABEL_LEN || !(isalpha((unsigned char)name[0]) || name[0] == '_'))
+    {
+        return Fail(as, "invalid label '%s'", name);
+    }
+
+    for (unsigned int i = 0; i < as->label_count; i++)
+    {
+        if (strcmp(as->labels[i].name, name) == 0)
+        {
+            return Fail(as, "duplicate label '%s' (labels cannot be defined inside .rep)", name);
+        }
+    }
+
+    if (as->label_count == MAX_LABELS)
+    {
+        return Fail(as, "too many labels");
+    }
+
+    Label *label = &as->labels[as->label_count++];
+
+    strcpy(label->name, name);
+    label->addr = PROGRAM_START_ADDR + as->len;
+
+    return 0;
+}
+
+static int EmitStatement(Assembler *as, Statement *statement)
+{
+    const char *mnemonic = statement->mnemonic;
+
+    if (strcasecmp(mnemonic, "DB") == 0 || strcasecmp(mnemonic, "DW") == 0)
+    {
+        int word = strcasecmp(mnemonic, "DW") == 0;
+
+        for (int i = 0; i < statement->operand_count; i++)
+        {
+            long value = 0;
+
+            if (as->pass == 2 && EvaluateValue(as, statement->operands[i], word ? 0xFFFF : 0xFF, &value) < 0)
+            {
+                return -1;
+            }
+
+            if ((word && EmitByte(as, value >> 8) < 0) || EmitByte(as, value & 0xFF) < 0)
+            {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    uint16_t opcode = 0;
+
+    if (as->pass == 2 && EncodeInstruction(as, statement, &opcode) < 0)
+    {
+        return -1;
+    }
+
+    if (EmitByte(as, opcode >> 8) < 0 || EmitByte(as, opcode & 0xFF) < 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int EmitByte(Assembler *as, uint8_t byte)
+{
+    if (as->len >= ASM_PROGRAM_MAX_LEN)
+    {
+        return Fail(as, "program does not fit in memory");
+    }
+
+    if (as->pass == 2)
+    {
+        as->program[as->len] = byte;
+    }
+
+    as->len++;
+
+    return 0;
+}
+
+#define XY(x, y) (((x) << 8) | ((y) << 4))
+
+static int EncodeInstruction(Assembler *as, Statement *statement, uint16_t *opcode)
+{
+    const char *m = statement->mnemonic;
+    char **ops = statement->operands;
+    int count = statement->operand_count;
+    uint8_t x = 0, y = 0;
+    long value;
+
+    int x_reg = count >= 1 && ParseRegister(ops[0], &x);
+    int y_reg = count >= 2 && ParseRegister(ops[1], &y);
+
+    if (count == 0)
+    {
+        if (strcasecmp(m, "CLS") == 0) { *opcode = 0x00E0; return 0; }
+        if (strcasecmp(m, "RET") == 0) { *opcode = 0x00EE; return 0; }
+        // the disassembler prints unknown opcodes as NOP
+        if (strcasecmp(m, "NOP") == 0) { *opcode = 0x0000; return 0; }
+    }
+    else if (count == 1)
+    {
+        if (strcasecmp(m, "JP") == 0 || strcasecmp(m, "CALL") == 0)
+        {
+            if (EvaluateValue(as, ops[0], 0xFFF, &value) < 0) return -1;
+
+            *opcode = (strcasecmp(m, "JP") == 0 ? 0x1000 : 0x2000) | value;
+            return 0;
+        }
+
+        if (x_reg && strcasecmp(m, "SKP") == 0) { *opcode = 0xE09E | XY(x, 0); return 0; }
+        if (x_reg && strcasecmp(m, "SKNP") == 0) { *opcode = 0xE0A1 | XY(x, 0); return 0; }
+        if (x_reg && strcasecmp(m, "SHR") == 0) { *opcode = 0x8006 | XY(x, 0); return 0; }
+        if (x_reg && strcasecmp(m, "SHL") == 0) { *opcode = 0x800E | XY(x, 0); return 0; }
+    }
+    else if (count == 2)
+    {
+        static const struct { const char *mnemonic; uint16_t opcode; } alu_ops[] = {
+            {"OR", 0x8001}, {"AND", 0x8002}, {"XOR", 0x8003}, {"SUB", 0x8005},
+            {"SHR", 0x8006}, {"SUBN", 0x8007}, {"SHL", 0x800E}
+        };
+
+        if (strcasecmp(m, "JP") == 0 && x_reg && x == 0)
+        {
+            if (EvaluateValue(as, ops[1], 0xFFF, &value) < 0) return -1;
+
+            *opcode = 0xB000 | value;
+            return 0;
+        }
+
+        if (x_reg && y_reg)
+        {
+            if (strcasecmp(m, "SE") == 0) { *opcode = 0x5000 | XY(x, y); return 0; }
+            if (strcasecmp(m, "SNE") == 0) { *opcode = 0x9000 | XY(x, y); return 0; }
+            if (strcasecmp(m, "LD") == 0) { *opcode = 0x8000 | XY(x, y); return 0; }
+            if (strcasecmp(m, "ADD") == 0) { *opcode = 0x8004 | XY(x, y); return 0; }
+
+            for (size_t i = 0; i < sizeof(alu_ops) / sizeof(alu_ops[0]); i++)
+            {
+                if (strcasecmp(m, alu_ops[i].mnemonic) == 0) { *opcode = alu_ops[i].opcode | XY(x, y); return 0; }
+            }
+        }
+
+        if (strcasecmp(m, "LD") == 0)
+        {
+            if (strcasecmp(ops[0], "I") == 0)
+            {
+                if (EvaluateValue(as, ops[1], 0xFFF, &value) < 0) return -1;
+
+                *opcode = 0xA000 | value;
+                return 0;
+            }
+
+            if (x_reg && strcasecmp(ops[1], "DT") == 0) { *opcode = 0xF007 | XY(x, 0); return 0; }
+            if (x_reg && strcasecmp(ops[1], "K") == 0) { *opcode = 0xF00A | XY(x, 0); return 0; }
+            if (x_reg && strcasecmp(ops[1], "[I]") == 0) { *opcode = 0xF065 | XY(x, 0); return 0; }
+
+            if (ParseRegister(ops[1], &y))
+            {
+                if (strcasecmp(ops[0], "DT") == 0) { *opcode = 0xF015 | XY(y, 0); return 0; }
+                if (strcasecmp(ops[0], "ST") == 0) { *opcode = 0xF018 | XY(y, 0); return 0; }
+                if (strcasecmp(ops[0], "F") == 0) { *opcode = 0xF029 | XY(y, 0); return 0; }
+                if (strcasecmp(ops[0], "B") == 0) { *opcode = 0xF033 | XY(y, 0); return 0; }
+                if (strcasecmp(ops[0], "[I]") == 0) { *opcode = 0xF055 | XY(y, 0); return 0; }
+            }
+        }
+
+        if (strcasecmp(m, "ADD") == 0 && strcasecmp(ops[0], "I") == 0 && ParseRegister(ops[1], &y))
+        {
+            *opcode = 0xF01E | XY(y, 0);
+            return 0;
+        }
+
+        if (x_reg && !y_reg)
+        {
+            static const struct { const char *mnemonic; uint16_t opcode; } byte_ops[] = {
+                {"SE", 0x3000}, {"SNE", 0x4000}, {"LD", 0x6000}, {"ADD", 0x7000}, {"RND", 0xC000}
+            };
+
+            for (size_t i = 0; i < sizeof(byte_ops) / sizeof(byte_ops[0]); i++)
+            {
+                if (strcasecmp(m, byte_ops[i].mnemonic) == 0)
+                {
+                    if (EvaluateValue(as, ops[1], 0xFF, &value) < 0) return -1;
+
+                    *opcode = byte_ops[i].opcode | XY(x, 0) | value;
+                    return 0;
+                }
+            }
+        }
+    }
+    else if (count == 3 && strcasecmp(m, "DRW") == 0 && x_reg && y_reg)
+    {
+        if (EvaluateValue(as, ops[2], 0xF, &value) < 0) return -1;
+
+        *opcode = 0xD000 | XY(x, y) | value;
+        return 0;
+    }
+
+    return Fail(as, "invalid instruction '%s' with %d operand(s)", m, count);
+}
+
+static int ParseRegister(const char *operand, uint8_t *reg)
+{
+    if ((operand[0] != 'V' && operand[0] != 'v') || !isxdigit((unsigned char)operand[1]) || operand[2] != 0)
+    {
+        return 0;
+    }
+
+    *reg = isdigit((unsigned char)operand[1]) ? operand[1] - '0' : toupper((unsigned char)operand[1]) - 'A' + 10;
+
+    return 1;
+}
+
+static int EvaluateValue(Assembler *as, const char *operand, long max, long *value)
+{
+    const char *term = operand;
+    int sign = 1;
+
+    *value = 0;
+
+    // term ((+|-) term)*
+    for (;;)
+    {
+        while (isspace((unsigned char)*term)) term++;
+
+        size_t len = strcspn(term, "+-");
+        long term_value;
+
+        while (len > 0 && isspace((unsigned char)term[len - 1])) len--;
+
+        if (EvaluateTerm(as, term, len, &term_value) < 0)
+        {
+            return -1;
+        }
+
+        *value += sign * term_value;
+        term += strcspn(term, "+-");
+
+        if (*term == 0) break;
+
+        sign = *term == '-' ? -1 : 1;
+        term++;
+    }
+
+    if (*value < 0 || *value > max)
+    {
+        return Fail(as, "value '%s' out of range (max: 0x%lX)", operand, max);
+    }
+
+    return 0;
+}
+
+static int EvaluateTerm(Assembler *as, const char *term, size_t len, long *value)
+{
+    char buf[MAX_LABEL_LEN];
+
+    if (len == 0 || len >= sizeof(buf))
+    {
+        return Fail(as, "invalid operand");
+    }
+
+    memcpy(buf, term, len);
+    buf[len] = 0;
+
+    if (strcmp(buf, "$") == 0)
+    {
+        *value = PROGRAM_START_ADDR + as->len;
+        return 0;
+    }
+
+    if (isdigit((unsigned char)buf[0]))
+    {
+        char *end;
+
+        *value = strtol(buf, &end, 0);
+
+        return *end == 0 ? 0 : Fail(as, "invalid number '%s'", buf);
+    }
+
+    for (unsigned int i = 0; i < as->label_count; i++)
+    {
+        if (strcmp(as->labels[i].name, buf) == 0)
+        {
+            *value = as->labels[i].addr;
+            return 0;
+        }
+    }
+
+    return Fail(as, "unknown label '%s'", buf);
+}
+
+static int Fail(Assembler *as, const char *fmt, ...)
+{
+    va_list args;
+    int prefix_len = snprintf(as->error, as->error_size, "line %u: ", as->current_line);
+
+    if (prefix_len >= 0 && (size_t)prefix_len < as->error_size)
+    {
+        va_start(args, fmt);
+        vsnprintf(as->error + prefix_len, as->error_size - prefix_len, fmt, args);
+        va_end(args);
+    }
+
+    return -1;
+}
+
+static char *Trim(char *str)
+{
+    while (isspace((unsigned char)*str)) str++;
+
+    char *end = str + strlen(str);
+
+    while (end > str && isspace((unsigned char)end[-1])) end--;
+
+    *end = 0;
+
+    return str;
+}
@@ -0,0 +1,25 @@
+#ifndef ASM_H
+#define ASM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip-8.h"
+
+#define ASM_PROGRAM_MAX_LEN (RAM_SIZE - PROGRAM_START_ADDR)
+#define ASM_ERROR_MAX_LEN 256
+
+/*
+ * Assembles CHIP-8 source using the mnemonics printed by the disassembler.
+ *
+ * - one instruction per line, an optional leading address column (e.g. "0x200") is ignored
+ * - ';' starts a comment
+ * - "name:" defines a label, operands can be numbers, labels or '$' (current address), with an optional +/- offset
+ * - "DB b, ..." and "DW w, ..." emit data bytes and 16 bits big endian words
+ * - ".rep N" ... ".endr" repeats the enclosed lines N times (can be nested, cannot contain labels)
+ *
+ * Returns 0 and sets *len on success, -1 with a message in error otherwise.
+ */
+int Asm_Assemble(const char *source, uint8_t program[ASM_PROGRAM_MAX_LEN], unsigned int *len, char *error, size_t error_size);
+
+#endif // ASM_H
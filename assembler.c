@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "asm.h"
+
+static char *ReadSource(const char *path);
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        printf("Usage: assembler SOURCE_PATH ROM_PATH\n");
+        return 1;
+    }
+
+    const char *source_path = argv[1];
+    const char *rom_path = argv[2];
+    char *source = ReadSource(source_path);
+
+    if (!source)
+    {
+        printf("Failed to read source (path: %s)\n", source_path);
+        return 1;
+    }
+
+    uint8_t program[ASM_PROGRAM_MAX_LEN];
+    unsigned int len;
+    char error[ASM_ERROR_MAX_LEN];
+    int ret = Asm_Assemble(source, program, &len, error, sizeof(error));
+
+    free(source);
+
+    if (ret < 0)
+    {
+        printf("%s: %s\n", source_path, error);
+        return 1;
+    }
+
+    FILE *f = fopen(rom_path, "wb");
+
+    if (!f)
+    {
+        printf("Failed to open ROM (path: %s)\n", rom_path);
+        return 1;
+    }
+
+    size_t written = fwrite(program, 1, len, f);
+
+    if (fclose(f) != 0 || written != len)
+    {
+        printf("Failed to write ROM (path: %s)\n", rom_path);
+        return 1;
+    }
+
+    return 0;
+}
+
+static char *ReadSource(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+
+    if (!f)
+    {
+        return NULL;
+    }
+
+    size_t capacity = 4096;
+    size_t len = 0;
+    char *source = malloc(capacity);
+    size_t read;
+
+    while ((read = fread(source + len, 1, capacity - len - 1, f)) > 0)
+    {
+        len += read;
+
+        if (len == capacity - 1)
+        {
+            capacity *= 2;
+            source = realloc(source, capacity);
+        }
+    }
+
+    fclose(f);
+    source[len] = 0;
+
+    return source;
+}
@@ -0,0 +1,307 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chip-8.h"
+#include "vec_env.h"
+#include "pixels.h"
+
+#define BENCH_INSTRUCTIONS 20000000
+#define ROM_BENCH_INSTRUCTIONS 5000000
+#define BENCH_MAX_ROMS 64
+#define BENCH_PATH_MAX_LEN 1024
+#define VEC_ENV_BENCH_INSTANCES 64
+#define VEC_ENV_BENCH_STEPS 500
+#define PIXELS_BENCH_FRAMES 20000
+
+typedef struct BenchResult
+{
+    const char *name;
+    double nsecs_per_instruction;
+} BenchResult;
+
+static void RunDispatchBenchmarks(void);
+static BenchResult RunBenchmark(const char *name, const Chip8_Hooks *hooks);
+static void RunVecEnvBenchmark(void);
+static void RunPixelsBenchmark(void);
+static double RunPixelsUnpack(void (*unpack)(uint8_t *, const uint8_t *, const uint8_t *, const uint8_t *),
+        uint8_t *out, const uint8_t *display);
+static void RunRomBenchmarks(const char *roms_dir);
+static double RunRomBenchmark(const char *rom_path);
+static int CompareNames(const void *a, const void *b);
+static void LoadMixedProgram(Chip8 *chip8);
+static double GetSeconds(void);
+static void NopInstructionHook(Chip8 *chip8, Chip8_InstructionType instruction_type, uint16_t instruction, void *user_data);
+static void NopMemWriteHook(Chip8 *chip8, uint16_t addr, unsigned int len, void *user_data);
+
+int main(int argc, char **argv)
+{
+    if (argc > 2)
+    {
+        printf("Usage: bench [ROMS_DIR]\n");
+        return 1;
+    }
+
+    RunDispatchBenchmarks();
+    RunVecEnvBenchmark();
+    RunPixelsBenchmark();
+
+    // microbenchmark ROMs assembled from bench_roms/*.asm, one per opcode class
+    RunRomBenchmarks(argc == 2 ? argv[1] : BENCH_ROMS_DIR);
+
+    return 0;
+}
+
+static void RunDispatchBenchmarks(void)
+{
+    Chip8_Hooks nop_hooks = {
+        .pre_instruction = NopInstructionHook,
+        .post_instruction = NopInstructionHook,
+        .mem_write = NopMemWriteHook,
+        .user_data = NULL
+    };
+    Chip8_Hooks empty_hooks = {0};
+
+    // "hooks (none set)" measures the cost of the separate dispatch path alone,
+    // "hooks (all set)" adds the cost of calling three empty hooks per instruction
+    BenchResult results[] = {
+        RunBenchmark("handler table", NULL),
+        RunBenchmark("hooks (none set)", &empty_hooks),
+        RunBenchmark("hooks (all set)", &nop_hooks)
+    };
+    double baseline = results[0].nsecs_per_instruction;
+
+    for (size_t i = 0; i < sizeof(results) / sizeof(BenchResult); i++)
+    {
+        printf("%-20s %8.2f ns/instruction (%+.1f%%)\n",
+                results[i].name,
+                results[i].nsecs_per_instruction,
+                (results[i].nsecs_per_instruction / baseline - 1) * 100);
+    }
+}
+
+static BenchResult RunBenchmark(const char *name, const Chip8_Hooks *hooks)
+{
+    Chip8 chip8;
+
+    Chip8_Init(&chip8);
+    LoadMixedProgram(&chip8);
+
+    if (hooks)
+    {
+        Chip8_SetHooks(&chip8, hooks);
+    }
+
+    double start = GetSeconds();
+
+    for (int i = 0; i < BENCH_INSTRUCTIONS; i++)
+    {
+        Chip8_Tick(&chip8);
+    }
+
+    double elapsed = GetSeconds() - start;
+
+    return (BenchResult){name, elapsed * 1e9 / BENCH_INSTRUCTIONS};
+}
+
+static void RunVecEnvBenchmark(void)
+{
+    Chip8 *template = malloc(sizeof(Chip8));
+    VecEnv env;
+    uint8_t observations[VEC_ENV_BENCH_INSTANCES * DISPLAY_WIDTH * DISPLAY_HEIGHT];
+    float rewards[VEC_ENV_BENCH_INSTANCES];
+    uint8_t dones[VEC_ENV_BENCH_INSTANCES];
+    uint16_t actions[VEC_ENV_BENCH_INSTANCES] = {0};
+
+    Chip8_Init(template);
+    LoadMixedProgram(template);
+
+    if (VecEnv_Init(&env, template, VEC_ENV_BENCH_INSTANCES, 1, VEC_ENV_OBS_UNPACKED,
+            observations, rewards, dones) < 0)
+    {
+        printf("Failed to create the vectorized environment\n");
+        free(template);
+        return;
+    }
+
+    double start = GetSeconds();
+
+    for (int i = 0; i < VEC_ENV_BENCH_STEPS; i++)
+    {
+        VecEnv_Step(&env, actions);
+    }
+
+    double elapsed = GetSeconds() - start;
+
+    // one step is one frame of every instance
+    printf("\n%-20s %8.0f frames/s (%d instances)\n",
+            "vec env", VEC_ENV_BENCH_STEPS * VEC_ENV_BENCH_INSTANCES / elapsed, VEC_ENV_BENCH_INSTANCES);
+
+    VecEnv_Deinit(&env);
+    free(template);
+}
+
+// the framebuffer path of the emulator, Pixels_Unpack is the SIMD one when built with -msimd128
+static void RunPixelsBenchmark(void)
+{
+    static uint8_t out[PIXELS_RGBA_SIZE];
+    uint8_t display[DISPLAY_SIZE];
+    uint32_t x = 1;
+
+    for (int i = 0; i < DISPLAY_SIZE; i++)
+    {
+        // xorshift32, a display as busy as it gets
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        display[i] = x;
+    }
+
+    double scalar = RunPixelsUnpack(Pixels_UnpackScalar, out, display);
+
+    printf("\n%-20s %8.2f ns/frame (+0.0%%)\n", "unpack (scalar)", scalar);
+
+#ifdef __wasm_simd128__
+    double simd = RunPixelsUnpack(Pixels_Unpack, out, display);
+
+    printf("%-20s %8.2f ns/frame (%+.1f%%)\n", "unpack (wasm SIMD)", simd, (simd / scalar - 1) * 100);
+#endif
+}
+
+static double RunPixelsUnpack(void (*unpack)(uint8_t *, const uint8_t *, const uint8_t *, const uint8_t *),
+        uint8_t *out, const uint8_t *display)
+{
+    const uint8_t on[4] = {13, 0, 0, 255};
+    const uint8_t off[4] = {217, 199, 184, 255};
+    volatile uint8_t sink = 0;
+    double start = GetSeconds();
+
+    for (int i = 0; i < PIXELS_BENCH_FRAMES; i++)
+    {
+        unpack(out, display, on, off);
+        sink += out[i % PIXELS_RGBA_SIZE];
+    }
+
+    (void)sink;
+
+    return (GetSeconds() - start) * 1e9 / PIXELS_BENCH_FRAMES;
+}
+
+static void RunRomBenchmarks(const char *roms_dir)
+{
+    DIR *dir = opendir(roms_dir);
+    struct dirent *ent;
+    char *names[BENCH_MAX_ROMS];
+    int count = 0;
+
+    if (!dir)
+    {
+        printf("Failed to open the benchmark ROMs directory (path: %s)\n", roms_dir);
+        return;
+    }
+
+    while ((ent = readdir(dir)) != NULL && count < BENCH_MAX_ROMS)
+    {
+        if (ent->d_type == DT_REG)
+        {
+            names[count++] = strdup(ent->d_name);
+        }
+    }
+
+    closedir(dir);
+    qsort(names, count, sizeof(char *), CompareNames);
+
+    printf("\n");
+
+    for (int i = 0; i < count; i++)
+    {
+        char rom_path[BENCH_PATH_MAX_LEN];
+
+        snprintf(rom_path, sizeof(rom_path), "%s/%s", roms_dir, names[i]);
+
+        double nsecs = RunRomBenchmark(rom_path);
+
+        if (nsecs < 0)
+        {
+            printf("%-20s failed to load\n", names[i]);
+        }
+        else
+        {
+            printf("%-20s %8.2f ns/instruction\n", names[i], nsecs);
+        }
+
+        free(names[i]);
+    }
+}
+
+static double RunRomBenchmark(const char *rom_path)
+{
+    Chip8 chip8;
+
+    Chip8_Init(&chip8);
+
+    if (Chip8_LoadFromFile(&chip8, rom_path) < 0)
+    {
+        return -1;
+    }
+
+    double start = GetSeconds();
+
+    for (int i = 0; i < ROM_BENCH_INSTRUCTIONS; i++)
+    {
+        Chip8_Tick(&chip8);
+    }
+
+    return (GetSeconds() - start) * 1e9 / ROM_BENCH_INSTRUCTIONS;
+}
+
+static int CompareNames(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static void LoadMixedProgram(Chip8 *chip8)
+{
+    // a loop mixing register, memory and branching instructions
+    uint8_t program[] = {
+        0x60, 0x00, // 0x200: LD V0, 0x0
+        0x70, 0x01, // 0x202: ADD V0, 0x1
+        0x81, 0x04, // 0x204: ADD V1, V0
+        0x82, 0x13, // 0x206: XOR V2, V1
+        0xA3, 0x00, // 0x208: LD I, 0x300
+        0xF2, 0x33, // 0x20A: LD B, V2
+        0xF2, 0x55, // 0x20C: LD [I], V2
+        0x30, 0x40, // 0x20E: SE V0, 0x40
+        0x12, 0x02, // 0x210: JP 0x202
+        0x12, 0x00  // 0x212: JP 0x200
+    };
+
+    Chip8_Load(chip8, program, sizeof(program));
+}
+
+static double GetSeconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void NopInstructionHook(Chip8 *chip8, Chip8_InstructionType instruction_type, uint16_t instruction, void *user_data)
+{
+    (void)chip8;
+    (void)instruction_type;
+    (void)instruction;
+    (void)user_data;
+}
+
+static void NopMemWriteHook(Chip8 *chip8, uint16_t addr, unsigned int len, void *user_data)
+{
+    (void)chip8;
+    (void)addr;
+    (void)len;
+    (void)user_data;
+}
@@ -0,0 +1,15 @@
+; register arithmetic and logic: ADD, OR, AND, XOR, SUB, SUBN, SHR, SHL
+    LD V0, 0x35
+    LD V1, 0x0F
+loop:
+.rep 16
+    ADD V0, V1
+    OR V2, V0
+    AND V3, V1
+    XOR V2, V3
+    SUB V4, V1
+    SUBN V5, V0
+    SHR V6 {, V6}
+    SHL V7 {, V7}
+.endr
+    JP loop
@@ -0,0 +1,8 @@
+; subroutine calls: CALL and RET
+loop:
+.rep 64
+    CALL sub
+.endr
+    JP loop
+sub:
+    RET
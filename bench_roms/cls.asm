@@ -0,0 +1,6 @@
+; screen clearing: CLS
+loop:
+.rep 128
+    CLS
+.endr
+    JP loop
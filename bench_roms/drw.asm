@@ -0,0 +1,13 @@
+; sprite drawing: DRW with a 15 rows sprite, wrapping around the screen edges
+    LD I, sprite
+    LD V0, 60
+    LD V1, 28
+loop:
+.rep 64
+    DRW V0, V1, 0xF
+.endr
+    ADD V0, 1
+    JP loop
+sprite:
+    DB 0xFF, 0x81, 0xBD, 0xA5, 0xA5, 0xBD, 0x81, 0xFF
+    DB 0x3C, 0x42, 0x99, 0xA5, 0x99, 0x42, 0x3C
@@ -0,0 +1,6 @@
+; unconditional jumps: JP to the next instruction
+loop:
+.rep 128
+    JP $+2
+.endr
+    JP loop
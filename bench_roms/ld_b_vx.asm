@@ -0,0 +1,9 @@
+; BCD conversion: LD B, Vx
+    LD I, 0xE00
+    LD V2, 0xF3
+loop:
+.rep 64
+    LD B, V2
+    ADD V2, 1
+.endr
+    JP loop
@@ -0,0 +1,8 @@
+; register dump and load: LD [I], Vx and LD Vx, [I]
+    LD I, 0xE00
+loop:
+.rep 64
+    LD [I], VF
+    LD VF, [I]
+.endr
+    JP loop
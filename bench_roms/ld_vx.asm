@@ -0,0 +1,9 @@
+; register loads: LD Vx, byte, LD Vx, Vy, LD I, addr, LD F, Vx
+loop:
+.rep 32
+    LD V0, 0x12
+    LD V1, V0
+    LD I, 0x300
+    LD F, V1
+.endr
+    JP loop
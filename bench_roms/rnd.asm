@@ -0,0 +1,6 @@
+; random numbers: RND
+loop:
+.rep 128
+    RND V0, 0xFF
+.endr
+    JP loop
@@ -0,0 +1,14 @@
+; conditional skips: SE, SNE and SKP never taken, SKNP taken over an SE (no key is held)
+    LD V0, 0x1
+    LD V1, 0x2
+loop:
+.rep 16
+    SE V0, 0x2
+    SNE V0, 0x1
+    SE V0, V1
+    SNE V0, V0
+    SKP V0
+    SKNP V0
+    SE V0, 0x2
+.endr
+    JP loop
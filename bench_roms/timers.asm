@@ -0,0 +1,9 @@
+; timer registers: LD DT, Vx, LD ST, Vx, LD Vx, DT
+    LD V0, 0xFF
+loop:
+.rep 32
+    LD DT, V0
+    LD ST, V0
+    LD V1, DT
+.endr
+    JP loop
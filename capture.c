@@ -0,0 +1,304 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+
+#define SPAN_MAX_GAP 2                          // unchanged bytes worth copying rather than starting a new span
+
+static void WriteRepeat(Capture *capture);
+static int ReserveRecord(Capture *capture);
+static void EncodeHeader(const Capture_Header *header, uint8_t *out);
+static void DecodeHeader(const uint8_t *data, Capture_Header *header);
+
+_Static_assert(sizeof(Capture_Header) == 10, "the capture header must stay 10 bytes as encoded");
+_Static_assert(DISPLAY_SIZE <= 256, "span offsets and lengths are stored in a byte");
+
+int Capture_Open(Capture *capture, const char *path)
+{
+    memset(capture, 0, sizeof(Capture));
+
+    capture->f = fopen(path, "wb");
+
+    if (!capture->f)
+    {
+        return -1;
+    }
+
+    capture->buffer = malloc(CAPTURE_BUFFER_SIZE);
+
+    if (!capture->buffer)
+    {
+        fclose(capture->f);
+        return -1;
+    }
+
+    Capture_Header header = {
+        .version = CAPTURE_VERSION,
+        .display_width = DISPLAY_WIDTH,
+        .display_height = DISPLAY_HEIGHT,
+        .frame_rate = CAPTURE_FRAME_RATE
+    };
+
+    uint8_t header_bytes[sizeof(Capture_Header)];
+
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    EncodeHeader(&header, header_bytes);
+
+    if (fwrite(header_bytes, sizeof(header_bytes), 1, capture->f) != 1)
+    {
+        Capture_Close(capture);
+        return -1;
+    }
+
+    return 0;
+}
+
+void Capture_Frame(Capture *capture, const uint8_t *display)
+{
+    // the deltas after a lost chunk would decode against the wrong display
+    if (capture->error) return;
+
+    // most frames are identical to the previous one, they only cost this comparison
+    if (memcmp(display, capture->previous, DISPLAY_SIZE) == 0)
+    {
+        if (++capture->repeat_count == CAPTURE_MAX_REPEAT) WriteRepeat(capture);
+        return;
+    }
+
+    if (capture->repeat_count > 0) WriteRepeat(capture);
+
+    if (ReserveRecord(capture) < 0) return;
+
+    capture->buffer_len += Capture_EncodeDelta(capture->previous, display, capture->buffer + capture->buffer_len);
+    memcpy(capture->previous, display, DISPLAY_SIZE);
+}
+
+// writes the span count then the spans of bytes changed from previous to display, returns the length written
+unsigned int Capture_EncodeDelta(const uint8_t *previous, const uint8_t *display, uint8_t *out)
+{
+    uint8_t *start = out++;
+    unsigned int span_count = 0;
+
+    for (unsigned int i = 0; i < DISPLAY_SIZE;)
+    {
+        if (display[i] == previous[i])
+        {
+            i++;
+            continue;
+        }
+
+        unsigned int first = i;
+        unsigned int end = i + 1;
+
+        for (unsigned int j = end; j < DISPLAY_SIZE && j <= end + SPAN_MAX_GAP; j++)
+        {
+            if (display[j] != previous[j]) end = j + 1;
+        }
+
+        *out++ = first;
+        *out++ = end - first - 1;
+        memcpy(out, display + first, end - first);
+        out += end - first;
+        span_count++;
+        i = end;
+    }
+
+    *start = span_count;
+
+    return out - start;
+}
+
+// applies a delta written by Capture_EncodeDelta, returns the length read or -1 if it is corrupted
+int Capture_DecodeDelta(const uint8_t *data, unsigned int len, uint8_t *display)
+{
+    unsigned int pos = 1;
+
+    if (len == 0)
+    {
+        return -1;
+    }
+
+    for (unsigned int i = 0; i < data[0]; i++)
+    {
+        if (pos + 2 > len)
+        {
+            return -1;
+        }
+
+        unsigned int offset = data[pos];
+        unsigned int span_len = data[pos + 1] + 1;
+
+        if (offset + span_len > DISPLAY_SIZE || pos + 2 + span_len > len)
+        {
+            return -1;
+        }
+
+        memcpy(display + offset, data + pos + 2, span_len);
+        pos += 2 + span_len;
+    }
+
+    return pos;
+}
+
+// returns -1 if this or any previous flush failed
+int Capture_Flush(Capture *capture)
+{
+    if (!capture->error && fwrite(capture->buffer, 1, capture->buffer_len, capture->f) != capture->buffer_len)
+    {
+        capture->error = 1;
+    }
+
+    capture->buffer_len = 0;
+
+    return capture->error ? -1 : 0;
+}
+
+int Capture_Close(Capture *capture)
+{
+    if (capture->repeat_count > 0 && !capture->error) WriteRepeat(capture);
+
+    int ret = Capture_Flush(capture);
+
+    if (fclose(capture->f) != 0)
+    {
+        ret = -1;
+    }
+
+    free(capture->buffer);
+    capture->buffer = NULL;
+    capture->f = NULL;
+
+    return ret;
+}
+
+int Capture_OpenReader(Capture_Reader *reader, const char *path)
+{
+    memset(reader, 0, sizeof(Capture_Reader));
+
+    reader->f = fopen(path, "rb");
+
+    if (!reader->f)
+    {
+        return -1;
+    }
+
+    Capture_Header *header = &reader->header;
+    uint8_t header_bytes[sizeof(Capture_Header)];
+
+    if (fread(header_bytes, sizeof(header_bytes), 1, reader->f) != 1)
+    {
+        Capture_CloseReader(reader);
+        return -1;
+    }
+
+    DecodeHeader(header_bytes, header);
+
+    if (memcmp(header->magic, CAPTURE_MAGIC, sizeof(header->magic)) != 0
+            || header->version != CAPTURE_VERSION
+            || header->display_width != DISPLAY_WIDTH
+            || header->display_height != DISPLAY_HEIGHT
+            || header->frame_rate == 0)
+    {
+        Capture_CloseReader(reader);
+        return -1;
+    }
+
+    return 0;
+}
+
+// returns 1 when the next frame is in reader->display, 0 at the end of the capture, -1 if it is corrupted
+int Capture_ReadFrame(Capture_Reader *reader)
+{
+    if (reader->repeat_count > 0)
+    {
+        reader->repeat_count--;
+        return 1;
+    }
+
+    int span_count = fgetc(reader->f);
+
+    if (span_count == EOF)
+    {
+        return 0;
+    }
+
+    if (span_count == 0)
+    {
+        int count = fgetc(reader->f);
+
+        if (count == EOF || count == 0)
+        {
+            return -1;
+        }
+
+        reader->repeat_count = count - 1;
+        return 1;
+    }
+
+    for (int i = 0; i < span_count; i++)
+    {
+        int offset = fgetc(reader->f);
+        int len = fgetc(reader->f);
+
+        if (offset == EOF || len == EOF || offset + len + 1 > DISPLAY_SIZE)
+        {
+            return -1;
+        }
+
+        if (fread(reader->display + offset, 1, len + 1, reader->f) != (size_t)len + 1)
+        {
+            return -1;
+        }
+    }
+
+    return 1;
+}
+
+void Capture_CloseReader(Capture_Reader *reader)
+{
+    if (reader->f)
+    {
+        fclose(reader->f);
+        reader->f = NULL;
+    }
+}
+
+static void WriteRepeat(Capture *capture)
+{
+    if (ReserveRecord(capture) < 0) return;
+
+    capture->buffer[capture->buffer_len++] = 0;
+    capture->buffer[capture->buffer_len++] = capture->repeat_count;
+    capture->repeat_count = 0;
+}
+
+// makes room for a record, returns -1 if the flush failed
+static int ReserveRecord(Capture *capture)
+{
+    if (capture->buffer_len + CAPTURE_MAX_DELTA_LEN > CAPTURE_BUFFER_SIZE)
+    {
+        return Capture_Flush(capture);
+    }
+
+    return 0;
+}
+
+static void EncodeHeader(const Capture_Header *header, uint8_t *out)
+{
+    memcpy(out, header->magic, sizeof(header->magic));
+    out[4] = header->version & 0xFF;
+    out[5] = header->version >> 8;
+    out[6] = header->display_width;
+    out[7] = header->display_height;
+    out[8] = header->frame_rate & 0xFF;
+    out[9] = header->frame_rate >> 8;
+}
+
+static void DecodeHeader(const uint8_t *data, Capture_Header *header)
+{
+    memcpy(header->magic, data, sizeof(header->magic));
+    header->version = data[4] | (data[5] << 8);
+    header->display_width = data[6];
+    header->display_height = data[7];
+    header->frame_rate = data[8] | (data[9] << 8);
+}
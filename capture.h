@@ -0,0 +1,63 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip-8.h"
+
+#define CAPTURE_MAGIC "C8CP"
+#define CAPTURE_VERSION 1
+#define CAPTURE_FRAME_RATE 60
+#define CAPTURE_BUFFER_SIZE 65536   // bytes of records buffered in memory before being flushed to disk
+#define CAPTURE_MAX_REPEAT 255
+#define CAPTURE_MAX_DELTA_LEN (1 + DISPLAY_SIZE * 2) // more than an encoded delta can take
+
+/*
+ * A capture file is a Capture_Header (little endian, fields in the order below without padding) followed by one
+ * record per run of frames:
+ *
+ *   0, count                       count frames showing the same display as the last one
+ *   spans, (offset, len - 1, bytes[len]) * spans
+ *                                  one frame, with the display bytes changed since the last one (spans > 0)
+ *
+ * The display starts blank.
+ */
+typedef struct Capture_Header
+{
+    char magic[4];
+    uint16_t version;
+    uint8_t display_width;
+    uint8_t display_height;
+    uint16_t frame_rate;
+} Capture_Header;
+
+typedef struct Capture
+{
+    FILE *f;
+    uint8_t *buffer;
+    unsigned int buffer_len;
+    unsigned int repeat_count;          // identical frames not written yet
+    uint8_t previous[DISPLAY_SIZE];
+    int error;                          // set once a flush failed, the frames after it are not encoded
+} Capture;
+
+typedef struct Capture_Reader
+{
+    FILE *f;
+    Capture_Header header;
+    unsigned int repeat_count;          // frames left to return before reading the next record
+    uint8_t display[DISPLAY_SIZE];      // frame returned by Capture_ReadFrame
+} Capture_Reader;
+
+int Capture_Open(Capture *capture, const char *path);
+void Capture_Frame(Capture *capture, const uint8_t *display);
+int Capture_Flush(Capture *capture);
+int Capture_Close(Capture *capture);
+unsigned int Capture_EncodeDelta(const uint8_t *previous, const uint8_t *display, uint8_t *out);
+int Capture_DecodeDelta(const uint8_t *data, unsigned int len, uint8_t *display);
+int Capture_OpenReader(Capture_Reader *reader, const char *path);
+int Capture_ReadFrame(Capture_Reader *reader);
+void Capture_CloseReader(Capture_Reader *reader);
+
+#endif // CAPTURE_H
@@ -0,0 +1,417 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+
+#define DEFAULT_SCALE 8
+#define MAX_SCALE 1023              // GIF dimensions are 16 bits
+#define OUTPUT_PATH_MAX_LEN 4096
+#define GIF_MIN_CODE_SIZE 2         // smallest LZW code size GIF allows, enough for 2 colors
+#define GIF_CLEAR_CODE (1 << GIF_MIN_CODE_SIZE)
+#define GIF_END_CODE (GIF_CLEAR_CODE + 1)
+#define GIF_MAX_CODES 4096
+#define GIF_MAX_CODE_SIZE 12
+#define GIF_MIN_DELAY 2             // hundredths of a second, browsers slow shorter frames down to 1/10 s
+
+typedef struct ConvertOptions
+{
+    const char *capture_path;
+    const char *output_path;
+    unsigned int scale;
+} ConvertOptions;
+
+typedef struct GifEncoder
+{
+    FILE *f;
+    uint32_t bits;
+    unsigned int bit_count;
+    uint8_t block[255];
+    unsigned int block_len;
+    unsigned int code_size;
+    unsigned int next_code;
+    uint16_t children[GIF_MAX_CODES][2];    // code of a string followed by each pixel value, 0 if none yet
+} GifEncoder;
+
+static int ParseOptions(int argc, char **argv, ConvertOptions *options);
+static void PrintUsage(void);
+static int IsGifPath(const char *path);
+static long WritePbmSequence(Capture_Reader *reader, const ConvertOptions *options);
+static int WritePbm(const uint8_t *display, const char *path, unsigned int scale);
+static long WriteGif(Capture_Reader *reader, const ConvertOptions *options);
+static void WriteGifFrame(GifEncoder *encoder, const uint8_t *display, unsigned int scale, unsigned int delay);
+static void ResetCodes(GifEncoder *encoder);
+static void AddCode(GifEncoder *encoder);
+static void PutCode(GifEncoder *encoder, unsigned int code);
+static void PutByte(GifEncoder *encoder, uint8_t byte);
+static void FlushBlock(GifEncoder *encoder);
+static void PutWord(FILE *f, uint16_t word);
+static unsigned int GetPixel(const uint8_t *display, unsigned int x, unsigned int y);
+
+int main(int argc, char **argv)
+{
+    ConvertOptions options;
+
+    if (ParseOptions(argc, argv, &options) < 0)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    Capture_Reader reader;
+
+    if (Capture_OpenReader(&reader, options.capture_path) < 0)
+    {
+        printf("Failed to open capture (path: %s)\n", options.capture_path);
+        return 1;
+    }
+
+    long frame_count = IsGifPath(options.output_path)
+            ? WriteGif(&reader, &options)
+            : WritePbmSequence(&reader, &options);
+
+    Capture_CloseReader(&reader);
+
+    if (frame_count < 0)
+    {
+        return 1;
+    }
+
+    printf("Converted %ld frames\n", frame_count);
+
+    return 0;
+}
+
+static int ParseOptions(int argc, char **argv, ConvertOptions *options)
+{
+    memset(options, 0, sizeof(ConvertOptions));
+    options->scale = DEFAULT_SCALE;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+
+        if (strcmp(arg, "--scale") == 0 && i + 1 < argc)
+        {
+            options->scale = strtoul(argv[++i], NULL, 10);
+        }
+        else if (arg[0] != '-' && !options->capture_path)
+        {
+            options->capture_path = arg;
+        }
+        else if (arg[0] != '-' && !options->output_path)
+        {
+            options->output_path = arg;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    if (options->scale == 0 || options->scale > MAX_SCALE)
+    {
+        return -1;
+    }
+
+    return options->capture_path && options->output_path ? 0 : -1;
+}
+
+static void PrintUsage(void)
+{
+    printf("Usage: capture_convert [--scale N] CAPTURE_PATH OUTPUT.gif|OUTPUT_PREFIX\n");
+}
+
+static int IsGifPath(const char *path)
+{
+    size_t len = strlen(path);
+
+    return len > 4 && strcmp(path + len - 4, ".gif") == 0;
+}
+
+// writes one PBM image per frame, OUTPUT_PREFIX000000.pbm, OUTPUT_PREFIX000001.pbm...
+static long WritePbmSequence(Capture_Reader *reader, const ConvertOptions *options)
+{
+    long frame_count = 0;
+    int ret;
+
+    while ((ret = Capture_ReadFrame(reader)) > 0)
+    {
+        char path[OUTPUT_PATH_MAX_LEN];
+
+        snprintf(path, sizeof(path), "%s%06ld.pbm", options->output_path, frame_count);
+
+        if (WritePbm(reader->display, path, options->scale) < 0)
+        {
+            printf("Failed to write image (path: %s)\n", path);
+            return -1;
+        }
+
+        frame_count++;
+    }
+
+    if (ret < 0)
+    {
+        printf("Corrupted capture (frame: %ld)\n", frame_count);
+        return -1;
+    }
+
+    return frame_count;
+}
+
+static int WritePbm(const uint8_t *display, const char *path, unsigned int scale)
+{
+    unsigned int width = DISPLAY_WIDTH * scale;
+    unsigned int row_len = (width + 7) / 8;
+    uint8_t *row = malloc(row_len);
+    FILE *f = fopen(path, "wb");
+
+    if (!row || !f)
+    {
+        free(row);
+        if (f) fclose(f);
+        return -1;
+    }
+
+    fprintf(f, "P4\n%u %u\n", width, DISPLAY_HEIGHT * scale);
+
+    for (unsigned int y = 0; y < DISPLAY_HEIGHT * scale; y++)
+    {
+        memset(row, 0, row_len);
+
+        // PBM bits are black pixels, lit pixels are drawn white as on screen
+        for (unsigned int x = 0; x < width; x++)
+        {
+            if (!GetPixel(display, x / scale, y / scale)) row[x / 8] |= 0x80 >> (x % 8);
+        }
+
+        fwrite(row, 1, row_len, f);
+    }
+
+    free(row);
+
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+// writes an animated GIF, holding each distinct frame for as long as the capture shows it
+static long WriteGif(Capture_Reader *reader, const ConvertOptions *options)
+{
+    FILE *f = fopen(options->output_path, "wb");
+    GifEncoder *encoder = calloc(1, sizeof(GifEncoder));
+    uint8_t shown[DISPLAY_SIZE];
+    unsigned int frame_rate = reader->header.frame_rate;
+    long frame_count = 0;
+    unsigned long shown_since = 0;   // hundredths of a second
+    int ret;
+
+    if (!f || !encoder)
+    {
+        printf("Failed to open output (path: %s)\n", options->output_path);
+        free(encoder);
+        if (f) fclose(f);
+        return -1;
+    }
+
+    encoder->f = f;
+
+    static const uint8_t palette[] = {0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF};
+    static const uint8_t loop_extension[] = {0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0',
+            0x03, 0x01, 0x00, 0x00, 0x00};
+
+    fwrite("GIF89a", 1, 6, f);
+    PutWord(f, DISPLAY_WIDTH * options->scale);
+    PutWord(f, DISPLAY_HEIGHT * options->scale);
+    fputc(0x80, f); // global color table of 2 colors
+    fputc(0, f);
+    fputc(0, f);
+    fwrite(palette, 1, sizeof(palette), f);
+    fwrite(loop_extension, 1, sizeof(loop_extension), f);
+
+    while ((ret = Capture_ReadFrame(reader)) > 0)
+    {
+        unsigned long now = frame_count * 100 / frame_rate;
+
+        if (frame_count == 0)
+        {
+            memcpy(shown, reader->display, DISPLAY_SIZE);
+        }
+        else if (memcmp(shown, reader->display, DISPLAY_SIZE) != 0)
+        {
+            // frames too short for a GIF are dropped, the next one takes their time so the playback speed is kept
+            if (now - shown_since >= GIF_MIN_DELAY)
+            {
+                WriteGifFrame(encoder, shown, options->scale, now - shown_since);
+                shown_since = now;
+            }
+
+            memcpy(shown, reader->display, DISPLAY_SIZE);
+        }
+
+        frame_count++;
+    }
+
+    if (frame_count > 0)
+    {
+        unsigned long delay = frame_count * 100 / frame_rate - shown_since;
+
+        WriteGifFrame(encoder, shown, options->scale, delay < GIF_MIN_DELAY ? GIF_MIN_DELAY : delay);
+    }
+
+    fputc(0x3B, f);
+    free(encoder);
+
+    if (fclose(f) != 0)
+    {
+        printf("Failed to write output (path: %s)\n", options->output_path);
+        return -1;
+    }
+
+    if (ret < 0)
+    {
+        printf("Corrupted capture (frame: %ld)\n", frame_count);
+        return -1;
+    }
+
+    return frame_count;
+}
+
+static void WriteGifFrame(GifEncoder *encoder, const uint8_t *display, unsigned int scale, unsigned int delay)
+{
+    FILE *f = encoder->f;
+    unsigned int width = DISPLAY_WIDTH * scale;
+    unsigned int height = DISPLAY_HEIGHT * scale;
+
+    // graphic control extension, then an image descriptor covering the whole screen
+    fputc(0x21, f);
+    fputc(0xF9, f);
+    fputc(4, f);
+    fputc(0, f);
+    PutWord(f, delay > UINT16_MAX ? UINT16_MAX : delay);
+    fputc(0, f);
+    fputc(0, f);
+    fputc(0x2C, f);
+    PutWord(f, 0);
+    PutWord(f, 0);
+    PutWord(f, width);
+    PutWord(f, height);
+    fputc(0, f);
+    fputc(GIF_MIN_CODE_SIZE, f);
+
+    ResetCodes(encoder);
+    PutCode(encoder, GIF_CLEAR_CODE);
+
+    unsigned int prefix = GetPixel(display, 0, 0);
+
+    for (unsigned int pos = 1; pos < width * height; pos++)
+    {
+        unsigned int x = pos % width;
+        unsigned int y = pos / width;
+        unsigned int pixel = GetPixel(display, x / scale, y / scale);
+        unsigned int child = encoder->children[prefix][pixel];
+
+        if (child)
+        {
+            prefix = child;
+            continue;
+        }
+
+        PutCode(encoder, prefix);
+
+        if (encoder->next_code < GIF_MAX_CODES)
+        {
+            encoder->children[prefix][pixel] = encoder->next_code;
+            AddCode(encoder);
+        }
+        else
+        {
+            PutCode(encoder, GIF_CLEAR_CODE);
+            ResetCodes(encoder);
+        }
+
+        prefix = pixel;
+    }
+
+    // the decoder adds a code when it reads the last one, which may widen the end code
+    PutCode(encoder, prefix);
+    AddCode(encoder);
+    PutCode(encoder, GIF_END_CODE);
+
+    if (encoder->bit_count > 0)
+    {
+        PutByte(encoder, encoder->bits);
+    }
+
+    encoder->bits = 0;
+    encoder->bit_count = 0;
+
+    FlushBlock(encoder);
+    fputc(0, f);
+}
+
+static void ResetCodes(GifEncoder *encoder)
+{
+    memset(encoder->children, 0, sizeof(encoder->children));
+    encoder->code_size = GIF_MIN_CODE_SIZE + 1;
+    encoder->next_code = GIF_END_CODE + 1;
+}
+
+static void AddCode(GifEncoder *encoder)
+{
+    if (encoder->next_code == GIF_MAX_CODES)
+    {
+        return;
+    }
+
+    // the decoder adds its codes one step behind the encoder, so it widens them one code later
+    if (++encoder->next_code > (1u << encoder->code_size) && encoder->code_size < GIF_MAX_CODE_SIZE)
+    {
+        encoder->code_size++;
+    }
+}
+
+static void PutCode(GifEncoder *encoder, unsigned int code)
+{
+    encoder->bits |= code << encoder->bit_count;
+    encoder->bit_count += encoder->code_size;
+
+    while (encoder->bit_count >= 8)
+    {
+        PutByte(encoder, encoder->bits & 0xFF);
+        encoder->bits >>= 8;
+        encoder->bit_count -= 8;
+    }
+}
+
+static void PutByte(GifEncoder *encoder, uint8_t byte)
+{
+    encoder->block[encoder->block_len++] = byte;
+
+    if (encoder->block_len == sizeof(encoder->block))
+    {
+        FlushBlock(encoder);
+    }
+}
+
+static void FlushBlock(GifEncoder *encoder)
+{
+    if (encoder->block_len > 0)
+    {
+        fputc(encoder->block_len, encoder->f);
+        fwrite(encoder->block, 1, encoder->block_len, encoder->f);
+    }
+
+    encoder->block_len = 0;
+}
+
+static void PutWord(FILE *f, uint16_t word)
+{
+    fputc(word & 0xFF, f);
+    fputc(word >> 8, f);
+}
+
+static unsigned int GetPixel(const uint8_t *display, unsigned int x, unsigned int y)
+{
+    unsigned int pos = y * DISPLAY_WIDTH + x;
+
+    return (display[pos / 8] >> (7 - pos % 8)) & 1;
+}
@@ -11,8 +11,10 @@
 #define HIGH_BYTE(instr) (instr >> 8)
 #define LOW_BYTE(instr) (instr & 0xFF)
 #define KEY_MASK(k) (0x1 << (0xF - k))
+#define I_ADDR(chip8) ((chip8)->i & 0xFFF)
 
 // --- op handlers ---
+static uint16_t UnknownHandler(Chip8 *chip8, uint16_t instruction);
 static uint16_t JpAddrHandler(Chip8 *chip8, uint16_t instruction);
 static uint16_t CallAddrHandler(Chip8 *chip8, uint16_t instruction);
 static uint16_t RetHandler(Chip8 *chip8, uint16_t instruction);
@@ -47,28 +49,151 @@ static uint16_t LdFVxHandler(Chip8 *chip8, uint16_t instruction);
 static uint16_t LdBVxHandler(Chip8 *chip8, uint16_t instruction);
 static uint16_t LdIVxHandler(Chip8 *chip8, uint16_t instruction);
 static uint16_t LdVxIHandler(Chip8 *chip8, uint16_t instruction);
+
+// quirk variants of the handlers (see QUIRK_HANDLERS)
+static uint16_t ShrQuirkHandler(Chip8 *chip8, uint16_t instruction);
+static uint16_t ShlQuirkHandler(Chip8 *chip8, uint16_t instruction);
+static uint16_t LdIVxQuirkHandler(Chip8 *chip8, uint16_t instruction);
+static uint16_t LdVxIQuirkHandler(Chip8 *chip8, uint16_t instruction);
+static uint16_t DrwQuirkHandler(Chip8 *chip8, uint16_t instruction);
+static uint16_t OrQuirkHandler(Chip8 *chip8, uint16_t instruction);
+static uint16_t AndQuirkHandler(Chip8 *chip8, uint16_t instruction);
+static uint16_t XorQuirkHandler(Chip8 *chip8, uint16_t instruction);
 // -------------------
 
+// Instructions affected by a quirk are implemented once, with the quirk as a parameter, and instantiated
+// twice with the quirk as a compile-time constant. Chip8_SetQuirks installs the variants in the handler
+// table, so quirks cost nothing at run time.
+#define QUIRK_HANDLERS(name) \
+    static uint16_t name##Handler(Chip8 *chip8, uint16_t instruction) { return name(chip8, instruction, 0); } \
+    static uint16_t name##QuirkHandler(Chip8 *chip8, uint16_t instruction) { return name(chip8, instruction, 1); }
+
 static void StoreDigitSpritesInMemory(Chip8 *chip8);
-static void PutAddrOnStack(Chip8 *chip8, uint16_t addr);
-static uint16_t GetAddrFromStack(Chip8 *chip8);
+static uint64_t HashBytes(uint64_t hash, const void *data, unsigned int len);
+static uint64_t HashMemAndDisplay(const Chip8 *chip8);
+static inline uint64_t HashLocation(unsigned int pos, uint8_t value);
+#ifdef CHIP8_STATE_HASH
+static inline void UpdateMemHash(Chip8 *chip8, unsigned int addr, uint8_t value);
+static inline void UpdateDisplayHash(Chip8 *chip8, unsigned int index, uint8_t value);
+#endif
+static inline uint16_t ReadKeys(Chip8 *chip8);
+static int PutAddrOnStack(Chip8 *chip8, uint16_t addr);
+static int GetAddrFromStack(Chip8 *chip8, uint16_t *addr);
 static void GetInstructionRegisters(uint16_t instruction, uint8_t *reg_x, uint8_t *reg_y);
 static void DrawPixel(Chip8 *chip8, unsigned int draw_pos, uint8_t sprite_pixel, unsigned int *collision);
+static unsigned int CheckRange(Chip8 *chip8, uint16_t addr, unsigned int len);
+
+static uint16_t ExecuteHooked(Chip8 *chip8, Chip8_InstructionType instruction_type, uint16_t instruction);
+
+// Instrumented instances dispatch through these trampolines instead of the handlers themselves, so
+// uninstrumented instances keep the plain handler table and pay nothing for the hooks.
+#define HOOK_TRAMPOLINE(type) \
+    static uint16_t Hooked_##type(Chip8 *chip8, uint16_t instruction) { return ExecuteHooked(chip8, type, instruction); }
+
+HOOK_TRAMPOLINE(UNKNOWN_INSTRUCTION)
+HOOK_TRAMPOLINE(CLS)
+HOOK_TRAMPOLINE(DRW)
+HOOK_TRAMPOLINE(RET)
+HOOK_TRAMPOLINE(JP_ADDR)
+HOOK_TRAMPOLINE(JP_V0_ADDR)
+HOOK_TRAMPOLINE(CALL_ADDR)
+HOOK_TRAMPOLINE(LD_VX_BYTE)
+HOOK_TRAMPOLINE(LD_VX_VY)
+HOOK_TRAMPOLINE(LD_I_ADDR)
+HOOK_TRAMPOLINE(LD_VX_DT)
+HOOK_TRAMPOLINE(LD_VX_K)
+HOOK_TRAMPOLINE(LD_DT_VX)
+HOOK_TRAMPOLINE(LD_ST_VX)
+HOOK_TRAMPOLINE(LD_F_VX)
+HOOK_TRAMPOLINE(LD_B_VX)
+HOOK_TRAMPOLINE(LD_I_VX)
+HOOK_TRAMPOLINE(LD_VX_I)
+HOOK_TRAMPOLINE(ADD_VX_BYTE)
+HOOK_TRAMPOLINE(ADD_VX_VY)
+HOOK_TRAMPOLINE(ADD_I_VX)
+HOOK_TRAMPOLINE(SUB)
+HOOK_TRAMPOLINE(SHR)
+HOOK_TRAMPOLINE(SUBN)
+HOOK_TRAMPOLINE(SHL)
+HOOK_TRAMPOLINE(RND)
+HOOK_TRAMPOLINE(OR)
+HOOK_TRAMPOLINE(AND)
+HOOK_TRAMPOLINE(XOR)
+HOOK_TRAMPOLINE(SE_VX_BYTE)
+HOOK_TRAMPOLINE(SNE_VX_BYTE)
+HOOK_TRAMPOLINE(SE_VX_VY)
+HOOK_TRAMPOLINE(SNE_VX_VY)
+HOOK_TRAMPOLINE(SKP)
+HOOK_TRAMPOLINE(SKNP)
+
+static const Chip8_InstructionHandler hook_trampolines[INSTRUCTION_COUNT] = {
+    Hooked_UNKNOWN_INSTRUCTION, Hooked_CLS, Hooked_DRW, Hooked_RET, Hooked_JP_ADDR, Hooked_JP_V0_ADDR,
+    Hooked_CALL_ADDR, Hooked_LD_VX_BYTE, Hooked_LD_VX_VY, Hooked_LD_I_ADDR, Hooked_LD_VX_DT, Hooked_LD_VX_K,
+    Hooked_LD_DT_VX, Hooked_LD_ST_VX, Hooked_LD_F_VX, Hooked_LD_B_VX, Hooked_LD_I_VX, Hooked_LD_VX_I,
+    Hooked_ADD_VX_BYTE, Hooked_ADD_VX_VY, Hooked_ADD_I_VX, Hooked_SUB, Hooked_SHR, Hooked_SUBN, Hooked_SHL,
+    Hooked_RND, Hooked_OR, Hooked_AND, Hooked_XOR, Hooked_SE_VX_BYTE, Hooked_SNE_VX_BYTE, Hooked_SE_VX_VY,
+    Hooked_SNE_VX_VY, Hooked_SKP, Hooked_SKNP
+};
+
+#ifdef CHIP8_PROFILER
+static uint64_t GetNanoseconds(void);
+static void ProfilerBeforeInstruction(Chip8_Profiler *profiler, uint16_t pc, Chip8_InstructionType instruction_type);
+static void ProfilerAfterInstruction(Chip8_Profiler *profiler, uint16_t pc, Chip8_InstructionType instruction_type);
+static void ProfilerEnterCall(Chip8_Profiler *profiler, uint16_t addr);
+static void ProfilerLeaveCall(Chip8_Profiler *profiler);
+static void WriteCallNodePath(Chip8_Profiler *profiler, unsigned int node, FILE *f);
+#endif
+
+static const char *instruction_names[INSTRUCTION_COUNT] = {
+    [UNKNOWN_INSTRUCTION] = "UNKNOWN",
+    [CLS] = "CLS",
+    [DRW] = "DRW",
+    [RET] = "RET",
+    [JP_ADDR] = "JP_ADDR",
+    [JP_V0_ADDR] = "JP_V0_ADDR",
+    [CALL_ADDR] = "CALL_ADDR",
+    [LD_VX_BYTE] = "LD_VX_BYTE",
+    [LD_VX_VY] = "LD_VX_VY",
+    [LD_I_ADDR] = "LD_I_ADDR",
+    [LD_VX_DT] = "LD_VX_DT",
+    [LD_VX_K] = "LD_VX_K",
+    [LD_DT_VX] = "LD_DT_VX",
+    [LD_ST_VX] = "LD_ST_VX",
+    [LD_F_VX] = "LD_F_VX",
+    [LD_B_VX] = "LD_B_VX",
+    [LD_I_VX] = "LD_I_VX",
+    [LD_VX_I] = "LD_VX_I",
+    [ADD_VX_BYTE] = "ADD_VX_BYTE",
+    [ADD_VX_VY] = "ADD_VX_VY",
+    [ADD_I_VX] = "ADD_I_VX",
+    [SUB] = "SUB",
+    [SHR] = "SHR",
+    [SUBN] = "SUBN",
+    [SHL] = "SHL",
+    [RND] = "RND",
+    [OR] = "OR",
+    [AND] = "AND",
+    [XOR] = "XOR",
+    [SE_VX_BYTE] = "SE_VX_BYTE",
+    [SNE_VX_BYTE] = "SNE_VX_BYTE",
+    [SE_VX_VY] = "SE_VX_VY",
+    [SNE_VX_VY] = "SNE_VX_VY",
+    [SKP] = "SKP",
+    [SKNP] = "SKNP"
+};
 
 void Chip8_Init(Chip8 *chip8)
 {
-    srand(time(NULL));
     memset(chip8, 0, sizeof(Chip8));
 
     chip8->pc = PROGRAM_START_ADDR;
     chip8->program_len = 0;
 
-    for (int i = 0; i < INSTRUCTION_COUNT; i++)
-    {
-        chip8->instruction_handlers[i] = NULL;
-    }
-
     StoreDigitSpritesInMemory(chip8); 
+    Chip8_RehashState(chip8);
+
+    // every slot has a handler, so dispatching never needs to check for NULL
+    chip8->instruction_handlers[UNKNOWN_INSTRUCTION] = UnknownHandler;
 
     chip8->instruction_handlers[RET] = RetHandler;
     chip8->instruction_handlers[JP_ADDR] = JpAddrHandler;
@@ -109,6 +234,10 @@ void Chip8_Init(Chip8 *chip8)
 
     chip8->instruction_handlers[DRW] = DrwHandler;
     chip8->instruction_handlers[CLS] = ClsHandler;
+
+    Chip8_SetQuirks(chip8, 0);
+    Chip8_SetFrequency(chip8, CPU_FREQUENCY);
+    Chip8_SetSeed(chip8, time(NULL));
 }
 
 void Chip8_Reset(Chip8 *chip8)
@@ -123,6 +252,9 @@ void Chip8_Reset(Chip8 *chip8)
     chip8->pc = PROGRAM_START_ADDR;
     chip8->sp = 0;
     chip8->time_acc = 0;
+    chip8->faults = 0;
+
+    Chip8_RehashState(chip8);
 }
 
 int Chip8_Load(Chip8 *chip8, uint8_t *data, unsigned int len)
@@ -136,6 +268,9 @@ int Chip8_Load(Chip8 *chip8, uint8_t *data, unsigned int len)
     memcpy(chip8->mem + PROGRAM_START_ADDR, data, len);
 
     chip8->program_len = len;
+    chip8->program_hash = Chip8_Hash(data, len);
+
+    Chip8_RehashState(chip8);
 
     return 0;
 }
@@ -162,6 +297,46 @@ int Chip8_LoadFromFile(Chip8 *chip8, const char *path)
     return Chip8_Load(chip8, data, len);
 }
 
+uint64_t Chip8_Hash(const uint8_t *data, unsigned int len)
+{
+    // 64 bits FNV-1a
+    return HashBytes(0xCBF29CE484222325, data, len);
+}
+
+uint64_t Chip8_StateHash(const Chip8 *chip8)
+{
+    // only the emulated machine: two instances running the same program through different handlers,
+    // hooks or profilers hash the same as long as they behave the same
+    // the registers are hashed on every call, they are a few dozen bytes and change with almost every instruction
+    uint64_t hash = Chip8_Hash(chip8->v, sizeof(chip8->v));
+
+    hash = HashBytes(hash, &chip8->dt, sizeof(chip8->dt));
+    hash = HashBytes(hash, &chip8->st, sizeof(chip8->st));
+    hash = HashBytes(hash, &chip8->i, sizeof(chip8->i));
+    hash = HashBytes(hash, &chip8->pc, sizeof(chip8->pc));
+    hash = HashBytes(hash, &chip8->sp, sizeof(chip8->sp));
+    hash = HashBytes(hash, chip8->stack, sizeof(chip8->stack));
+    hash = HashBytes(hash, &chip8->time_acc, sizeof(chip8->time_acc));
+    hash = HashBytes(hash, &chip8->faults, sizeof(chip8->faults));
+    hash = HashBytes(hash, &chip8->rng_state, sizeof(chip8->rng_state));
+
+#ifdef CHIP8_STATE_HASH
+    return hash ^ chip8->state_hash;
+#else
+    return hash ^ HashMemAndDisplay(chip8);
+#endif
+}
+
+void Chip8_RehashState(Chip8 *chip8)
+{
+    // needed after writing mem or display directly, handlers keep the hash up to date themselves
+#ifdef CHIP8_STATE_HASH
+    chip8->state_hash = HashMemAndDisplay(chip8);
+#else
+    (void)chip8;
+#endif
+}
+
 int Chip8_GetNextInstruction(Chip8 *chip8, Chip8_InstructionType *instruction_type, uint16_t *instruction)
 {
     if (chip8->pc >= PROGRAM_START_ADDR + chip8->program_len)
@@ -169,14 +344,21 @@ int Chip8_GetNextInstruction(Chip8 *chip8, Chip8_InstructionType *instruction_ty
         return 0;
     }
 
-    uint8_t high_byte = chip8->mem[chip8->pc];
-    uint8_t low_byte = chip8->mem[chip8->pc + 1];
-    uint8_t opcode = high_byte >> 4;
+    uint16_t opcode = (chip8->mem[chip8->pc] << 8) | chip8->mem[chip8->pc + 1];
+
+    Chip8_DecodeInstruction(opcode, instruction_type, instruction);
+
+    return 1;
+}
+
+void Chip8_DecodeInstruction(uint16_t opcode, Chip8_InstructionType *instruction_type, uint16_t *instruction)
+{
+    uint8_t low_byte = LOW_BYTE(opcode);
 
     *instruction_type = UNKNOWN_INSTRUCTION;
-    *instruction = ((high_byte & 0x0F) << 8) | (uint16_t)low_byte;
+    *instruction = opcode & 0x0FFF;
 
-    switch (opcode)
+    switch (opcode >> 12)
     {
         case 0x00:
             if (*instruction == 0xE0)
@@ -334,20 +516,11 @@ int Chip8_GetNextInstruction(Chip8 *chip8, Chip8_InstructionType *instruction_ty
             }
             break;
     }
-
-    return 1;
 }
 
 uint16_t Chip8_ExecuteInstruction(Chip8 *chip8, Chip8_InstructionType opcode, uint16_t instruction)
 {
-    Chip8_InstructionHandler handler = chip8->instruction_handlers[opcode];
-
-    if (!handler)
-    {
-        return 0;
-    }
-
-    return handler(chip8, instruction);
+    return chip8->instruction_handlers[opcode](chip8, instruction);
 }
 
 unsigned int Chip8_GetPixel(Chip8 *chip8, unsigned int pos)
@@ -358,9 +531,17 @@ unsigned int Chip8_GetPixel(Chip8 *chip8, unsigned int pos)
     return (byte & (1 << offset)) >> offset;
 }
 
-void Chip8_SetGetKeysCallback(Chip8 *chip8, GetKeysCb cb)
+// sets the keys held, read by the key instructions until the next call
+void Chip8_SetKeys(Chip8 *chip8, uint16_t keys)
+{
+    chip8->keys = keys;
+}
+
+// for frontends polling the keys only when the program checks them, NULL to only use Chip8_SetKeys
+void Chip8_SetGetKeysCallback(Chip8 *chip8, GetKeysCb cb, void *user_data)
 {
     chip8->get_keys = cb;
+    chip8->get_keys_user_data = user_data;
 }
 
 int Chip8_Tick(Chip8 *chip8)
@@ -373,11 +554,32 @@ int Chip8_Tick(Chip8 *chip8)
         return 0;
     }
 
+#ifdef CHIP8_PROFILER
+    Chip8_Profiler *profiler = chip8->profiler;
+    uint64_t drw_start = 0;
+
+    if (profiler)
+    {
+        ProfilerBeforeInstruction(profiler, chip8->pc, instruction_type);
+
+        if (instruction_type == DRW) drw_start = GetNanoseconds();
+    }
+#endif
+
     chip8->pc += Chip8_ExecuteInstruction(chip8, instruction_type, instruction);
 
+#ifdef CHIP8_PROFILER
+    if (profiler)
+    {
+        if (instruction_type == DRW) profiler->drw_nsecs += GetNanoseconds() - drw_start;
+
+        ProfilerAfterInstruction(profiler, chip8->pc, instruction_type);
+    }
+#endif
+
     // Update timers
 
-    chip8->time_acc += CPU_TICK_SECS;
+    chip8->time_acc += chip8->tick_secs;
 
     if (chip8->time_acc >= TIMER_TICK_SECS)
     {
@@ -394,9 +596,159 @@ int Chip8_Tick(Chip8 *chip8)
         chip8->time_acc = 0;
     }
 
-    return chip8->pc;
+    // faults are rare, checking them once per instruction here keeps the handlers free of extra branches
+    return chip8->faults ? 0 : chip8->pc;
 }
 
+unsigned long Chip8_Run(Chip8 *chip8, unsigned long cycles)
+{
+    unsigned long executed = 0;
+
+    while (executed < cycles && Chip8_Tick(chip8))
+    {
+        executed++;
+    }
+
+    return executed;
+}
+
+const char *Chip8_GetFaultName(unsigned int faults)
+{
+    if (faults & CHIP8_FAULT_STACK_OVERFLOW) return "stack overflow";
+    if (faults & CHIP8_FAULT_STACK_UNDERFLOW) return "stack underflow";
+    if (faults & CHIP8_FAULT_OUT_OF_RANGE) return "out of range memory access";
+    if (faults & CHIP8_FAULT_UNKNOWN_INSTRUCTION) return "unknown instruction";
+
+    return "none";
+}
+
+const char *Chip8_GetInstructionName(Chip8_InstructionType instruction_type)
+{
+    return instruction_names[instruction_type];
+}
+
+void Chip8_SetHooks(Chip8 *chip8, const Chip8_Hooks *hooks)
+{
+    if (hooks && !chip8->hooked)
+    {
+        memcpy(chip8->hooked_handlers, chip8->instruction_handlers, sizeof(chip8->instruction_handlers));
+        memcpy(chip8->instruction_handlers, hook_trampolines, sizeof(chip8->instruction_handlers));
+        chip8->hooked = 1;
+    }
+    else if (!hooks && chip8->hooked)
+    {
+        memcpy(chip8->instruction_handlers, chip8->hooked_handlers, sizeof(chip8->instruction_handlers));
+        chip8->hooked = 0;
+    }
+
+    if (hooks)
+    {
+        chip8->hooks = *hooks;
+    }
+    else
+    {
+        memset(&chip8->hooks, 0, sizeof(Chip8_Hooks));
+    }
+}
+
+void Chip8_SetQuirks(Chip8 *chip8, unsigned int quirks)
+{
+    // the trampolines of a hooked instance call hooked_handlers
+    Chip8_InstructionHandler *handlers = chip8->hooked ? chip8->hooked_handlers : chip8->instruction_handlers;
+
+    handlers[SHR] = (quirks & CHIP8_QUIRK_SHIFT_VY) ? ShrQuirkHandler : ShrHandler;
+    handlers[SHL] = (quirks & CHIP8_QUIRK_SHIFT_VY) ? ShlQuirkHandler : ShlHandler;
+    handlers[LD_I_VX] = (quirks & CHIP8_QUIRK_LOAD_STORE_I) ? LdIVxQuirkHandler : LdIVxHandler;
+    handlers[LD_VX_I] = (quirks & CHIP8_QUIRK_LOAD_STORE_I) ? LdVxIQuirkHandler : LdVxIHandler;
+    handlers[DRW] = (quirks & CHIP8_QUIRK_DRAW_CLIP) ? DrwQuirkHandler : DrwHandler;
+    handlers[OR] = (quirks & CHIP8_QUIRK_VF_RESET) ? OrQuirkHandler : OrHandler;
+    handlers[AND] = (quirks & CHIP8_QUIRK_VF_RESET) ? AndQuirkHandler : AndHandler;
+    handlers[XOR] = (quirks & CHIP8_QUIRK_VF_RESET) ? XorQuirkHandler : XorHandler;
+
+    chip8->quirks = quirks;
+}
+
+void Chip8_SetSeed(Chip8 *chip8, uint32_t seed)
+{
+    // xorshift32 never leaves a zero state
+    chip8->rng_state = seed ? seed : 1;
+}
+
+void Chip8_SetFrequency(Chip8 *chip8, double frequency)
+{
+    // timers keep ticking at 60Hz of emulated time whatever the frequency
+    chip8->frequency = frequency;
+    chip8->tick_secs = 1 / frequency;
+}
+
+#ifdef CHIP8_PROFILER
+
+void Chip8_SetProfiler(Chip8 *chip8, Chip8_Profiler *profiler)
+{
+    chip8->profiler = profiler;
+}
+
+void Chip8_ResetProfiler(Chip8_Profiler *profiler)
+{
+    memset(profiler, 0, sizeof(Chip8_Profiler));
+
+    // the root of the call tree stands for the code reached from the program entry point
+    profiler->call_nodes[0].addr = PROGRAM_START_ADDR;
+    profiler->call_node_count = 1;
+    profiler->current_call_node = 0;
+}
+
+void Chip8_WriteProfileJSON(Chip8_Profiler *profiler, FILE *f)
+{
+    uint64_t total = 0;
+
+    for (int i = 0; i < INSTRUCTION_COUNT; i++)
+    {
+        total += profiler->instruction_counts[i];
+    }
+
+    fprintf(f, "{\n  \"total_instructions\": %llu,\n", (unsigned long long)total);
+    fprintf(f, "  \"drw_nsecs\": %llu,\n", (unsigned long long)profiler->drw_nsecs);
+    fprintf(f, "  \"instructions\": {");
+
+    const char *sep = "";
+
+    for (int i = 0; i < INSTRUCTION_COUNT; i++)
+    {
+        if (profiler->instruction_counts[i] == 0) continue;
+
+        fprintf(f, "%s\n    \"%s\": %llu", sep, instruction_names[i], (unsigned long long)profiler->instruction_counts[i]);
+        sep = ",";
+    }
+
+    fprintf(f, "\n  },\n  \"pcs\": {");
+    sep = "";
+
+    for (int pc = 0; pc < RAM_SIZE; pc++)
+    {
+        if (profiler->pc_counts[pc] == 0) continue;
+
+        fprintf(f, "%s\n    \"0x%03X\": %llu", sep, pc, (unsigned long long)profiler->pc_counts[pc]);
+        sep = ",";
+    }
+
+    fprintf(f, "\n  }\n}\n");
+}
+
+void Chip8_WriteProfileCollapsed(Chip8_Profiler *profiler, FILE *f)
+{
+    // one line per call path: "0x200;0x2A4;0x310 <count>", as expected by flamegraph.pl and friends
+    for (unsigned int i = 0; i < profiler->call_node_count; i++)
+    {
+        if (profiler->call_nodes[i].instruction_count == 0) continue;
+
+        WriteCallNodePath(profiler, i, f);
+        fprintf(f, " %llu\n", (unsigned long long)profiler->call_nodes[i].instruction_count);
+    }
+}
+
+#endif // CHIP8_PROFILER
+
 static void StoreDigitSpritesInMemory(Chip8 *chip8)
 {
     static uint8_t sprites[16][SPRITE_SIZE] = {
@@ -424,29 +776,115 @@ static void StoreDigitSpritesInMemory(Chip8 *chip8)
     }
 }
 
-static void PutAddrOnStack(Chip8 *chip8, uint16_t addr)
+static uint64_t HashBytes(uint64_t hash, const void *data, unsigned int len)
+{
+    const uint8_t *bytes = data;
+
+    for (unsigned int i = 0; i < len; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3;
+    }
+
+    return hash;
+}
+
+// Memory and display are hashed as the XOR of a hash per (location, value), so a write only has to
+// XOR out the hash of the old value and XOR in the one of the new value (Zobrist hashing).
+static uint64_t HashMemAndDisplay(const Chip8 *chip8)
+{
+    uint64_t hash = 0;
+
+    for (unsigned int addr = 0; addr < RAM_SIZE; addr++)
+    {
+        hash ^= HashLocation(addr, chip8->mem[addr]);
+    }
+
+    for (unsigned int i = 0; i < DISPLAY_SIZE; i++)
+    {
+        hash ^= HashLocation(RAM_SIZE + i, chip8->display[i]);
+    }
+
+    return hash;
+}
+
+static inline uint64_t HashLocation(unsigned int pos, uint8_t value)
+{
+    // splitmix64 finalizer, computed instead of stored to avoid a 6 MB table of random numbers
+    uint64_t x = (((uint64_t)pos << 8) | value) + 0x9E3779B97F4A7C15;
+
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+
+    return x ^ (x >> 31);
+}
+
+#ifdef CHIP8_STATE_HASH
+
+// called before writing value at addr, writes to the memory padding are not part of the state
+static inline void UpdateMemHash(Chip8 *chip8, unsigned int addr, uint8_t value)
+{
+    if (addr < RAM_SIZE)
+    {
+        chip8->state_hash ^= HashLocation(addr, chip8->mem[addr]) ^ HashLocation(addr, value);
+    }
+}
+
+static inline void UpdateDisplayHash(Chip8 *chip8, unsigned int index, uint8_t value)
+{
+    chip8->state_hash ^= HashLocation(RAM_SIZE + index, chip8->display[index]) ^ HashLocation(RAM_SIZE + index, value);
+}
+
+#endif // CHIP8_STATE_HASH
+
+// the key instructions read a plain mask, only frontends that set a callback pay for an indirect call
+static inline uint16_t ReadKeys(Chip8 *chip8)
+{
+    if (chip8->get_keys)
+    {
+        chip8->keys = chip8->get_keys(chip8->get_keys_user_data);
+    }
+
+    return chip8->keys;
+}
+
+static int PutAddrOnStack(Chip8 *chip8, uint16_t addr)
 {
     if (chip8->sp >= STACK_SIZE)
     {
-        // stack overflow
-        abort();
+        chip8->faults |= CHIP8_FAULT_STACK_OVERFLOW;
+        return -1;
     }
 
     chip8->stack[chip8->sp] = addr;
     chip8->sp++;
+
+    return 0;
 }
 
-static uint16_t GetAddrFromStack(Chip8 *chip8)
+static int GetAddrFromStack(Chip8 *chip8, uint16_t *addr)
 {
     if (chip8->sp == 0)
     {
-        // nothing on the stack
-        abort();
+        chip8->faults |= CHIP8_FAULT_STACK_UNDERFLOW;
+        return -1;
     }
 
     chip8->sp--;
+    *addr = chip8->stack[chip8->sp];
 
-    return chip8->stack[chip8->sp];
+    return 0;
+}
+
+// flags the access of len bytes at addr (a 12 bits address) if it goes past the end of the RAM; the access
+// itself lands in the memory padding, so the handler can go on without branching
+static unsigned int CheckRange(Chip8 *chip8, uint16_t addr, unsigned int len)
+{
+    unsigned int fault = addr + len > RAM_SIZE ? CHIP8_FAULT_OUT_OF_RANGE : 0;
+
+    chip8->faults |= fault;
+
+    return fault;
 }
 
 static void GetInstructionRegisters(uint16_t instruction, uint8_t *reg_x, uint8_t *reg_y)
@@ -456,9 +894,19 @@ static void GetInstructionRegisters(uint16_t instruction, uint8_t *reg_x, uint8_
     if (reg_y) *reg_y = (LOW_BYTE(instruction) & 0xF0) >> 4;
 }
 
+static uint16_t UnknownHandler(Chip8 *chip8, uint16_t instruction)
+{
+    (void)instruction;
+    chip8->faults |= CHIP8_FAULT_UNKNOWN_INSTRUCTION;
+
+    return 0;
+}
+
 static uint16_t CallAddrHandler(Chip8 *chip8, uint16_t instruction)
 {
-    PutAddrOnStack(chip8, chip8->pc);
+    // on faults the PC stays on the faulting instruction
+    if (PutAddrOnStack(chip8, chip8->pc) < 0) return 0;
+
     chip8->pc = ADDR(instruction);
 
     return 0;
@@ -474,7 +922,8 @@ static uint16_t JpAddrHandler(Chip8 *chip8, uint16_t instruction)
 static uint16_t RetHandler(Chip8 *chip8, uint16_t instruction)
 {
     (void)instruction;
-    chip8->pc = GetAddrFromStack(chip8); 
+
+    if (GetAddrFromStack(chip8, &chip8->pc) < 0) return 0;
 
     return 2;
 }
@@ -540,7 +989,7 @@ static uint16_t LdVxVyHandler(Chip8 *chip8, uint16_t instruction)
     return 2;
 }
 
-static uint16_t OrHandler(Chip8 *chip8, uint16_t instruction)
+static inline uint16_t Or(Chip8 *chip8, uint16_t instruction, const int vf_reset)
 {
     uint8_t reg_x, reg_y;
 
@@ -548,10 +997,14 @@ static uint16_t OrHandler(Chip8 *chip8, uint16_t instruction)
 
     chip8->v[reg_x] |= chip8->v[reg_y];
 
+    if (vf_reset) chip8->v[0xF] = 0;
+
     return 2;
 }
 
-static uint16_t AndHandler(Chip8 *chip8, uint16_t instruction)
+QUIRK_HANDLERS(Or)
+
+static inline uint16_t And(Chip8 *chip8, uint16_t instruction, const int vf_reset)
 {
     uint8_t reg_x, reg_y;
 
@@ -559,10 +1012,14 @@ static uint16_t AndHandler(Chip8 *chip8, uint16_t instruction)
 
     chip8->v[reg_x] &= chip8->v[reg_y];
 
+    if (vf_reset) chip8->v[0xF] = 0;
+
     return 2;
 }
 
-static uint16_t XorHandler(Chip8 *chip8, uint16_t instruction)
+QUIRK_HANDLERS(And)
+
+static inline uint16_t Xor(Chip8 *chip8, uint16_t instruction, const int vf_reset)
 {
     uint8_t reg_x, reg_y;
 
@@ -570,9 +1027,13 @@ static uint16_t XorHandler(Chip8 *chip8, uint16_t instruction)
 
     chip8->v[reg_x] ^= chip8->v[reg_y];
 
+    if (vf_reset) chip8->v[0xF] = 0;
+
     return 2;
 }
 
+QUIRK_HANDLERS(Xor)
+
 static uint16_t AddVxVyHandler(Chip8 *chip8, uint16_t instruction)
 {
     uint8_t reg_x, reg_y;
@@ -611,11 +1072,13 @@ static uint16_t SubnHandler(Chip8 *chip8, uint16_t instruction)
     return 2;
 }
 
-static uint16_t ShrHandler(Chip8 *chip8, uint16_t instruction)
+static inline uint16_t Shr(Chip8 *chip8, uint16_t instruction, const int shift_vy)
 {
-    uint8_t reg_x;
+    uint8_t reg_x, reg_y;
 
-    GetInstructionRegisters(instruction, &reg_x, NULL);
+    GetInstructionRegisters(instruction, &reg_x, &reg_y);
+
+    if (shift_vy) chip8->v[reg_x] = chip8->v[reg_y];
 
     chip8->v[0xF] = chip8->v[reg_x] & 0x1;
     chip8->v[reg_x] /= 2;
@@ -623,11 +1086,15 @@ static uint16_t ShrHandler(Chip8 *chip8, uint16_t instruction)
     return 2;
 }
 
-static uint16_t ShlHandler(Chip8 *chip8, uint16_t instruction)
+QUIRK_HANDLERS(Shr)
+
+static inline uint16_t Shl(Chip8 *chip8, uint16_t instruction, const int shift_vy)
 {
-    uint8_t reg_x;
+    uint8_t reg_x, reg_y;
 
-    GetInstructionRegisters(instruction, &reg_x, NULL);
+    GetInstructionRegisters(instruction, &reg_x, &reg_y);
+
+    if (shift_vy) chip8->v[reg_x] = chip8->v[reg_y];
 
     chip8->v[0xF] = (chip8->v[reg_x] & (0x1 << 7)) > 0;
     chip8->v[reg_x] *= 2;
@@ -635,6 +1102,8 @@ static uint16_t ShlHandler(Chip8 *chip8, uint16_t instruction)
     return 2;
 }
 
+QUIRK_HANDLERS(Shl)
+
 static uint16_t SneVxVyHandler(Chip8 *chip8, uint16_t instruction)
 {
     uint8_t reg_x, reg_y;
@@ -661,7 +1130,12 @@ static uint16_t JpV0AddrHandler(Chip8 *chip8, uint16_t instruction)
 static uint16_t RndHandler(Chip8 *chip8, uint16_t instruction)
 {
     uint8_t reg_x;
-    uint8_t random = rand() % 256;
+    // per instance xorshift32, so instances running side by side don't share (or race on) a global generator
+    chip8->rng_state ^= chip8->rng_state << 13;
+    chip8->rng_state ^= chip8->rng_state >> 17;
+    chip8->rng_state ^= chip8->rng_state << 5;
+
+    uint8_t random = chip8->rng_state & 0xFF;
 
     GetInstructionRegisters(instruction, &reg_x, NULL);
 
@@ -670,25 +1144,32 @@ static uint16_t RndHandler(Chip8 *chip8, uint16_t instruction)
     return 2;
 }
 
-static uint16_t DrwHandler(Chip8 *chip8, uint16_t instruction)
+static inline uint16_t Drw(Chip8 *chip8, uint16_t instruction, const int clip)
 {
     uint8_t reg_x, reg_y;
 
     GetInstructionRegisters(instruction, &reg_x, &reg_y); 
 
-    unsigned int start_x = chip8->v[reg_x];
-    unsigned int start_y = chip8->v[reg_y];
+    // when clipping, the sprite position still wraps around but not the sprite itself
+    unsigned int start_x = clip ? chip8->v[reg_x] % DISPLAY_WIDTH : chip8->v[reg_x];
+    unsigned int start_y = clip ? chip8->v[reg_y] % DISPLAY_HEIGHT : chip8->v[reg_y];
     unsigned int sprite_height = NIBBLE(instruction); // sprite height
     unsigned int collision = 0;
+    uint16_t addr = I_ADDR(chip8);
+    unsigned int fault = CheckRange(chip8, addr, sprite_height);
 
     // printf("Draw sprite at (%d,%d)\n", start_x, start_y);
 
     for (unsigned int i = 0; i < sprite_height; i++)
     {
-        uint8_t sprite_byte = chip8->mem[chip8->i + i];
+        uint8_t sprite_byte = chip8->mem[addr + i];
+
+        if (clip && start_y + i >= DISPLAY_HEIGHT) break;
 
         for (unsigned int j = 0; j < 8; j++)
         {
+            if (clip && start_x + j >= DISPLAY_WIDTH) break;
+
             unsigned int x = (start_x + j) % DISPLAY_WIDTH;
             unsigned int y = (start_y + i) % DISPLAY_HEIGHT;
             unsigned int draw_pos = (y * DISPLAY_WIDTH) + x;
@@ -702,12 +1183,22 @@ static uint16_t DrwHandler(Chip8 *chip8, uint16_t instruction)
 
     chip8->v[0xF] = collision;
 
-    return 2;
+    return fault ? 0 : 2;
 }
 
+QUIRK_HANDLERS(Drw)
+
 static uint16_t ClsHandler(Chip8 *chip8, uint16_t instruction)
 {
     (void)instruction;
+
+#ifdef CHIP8_STATE_HASH
+    for (unsigned int i = 0; i < DISPLAY_SIZE; i++)
+    {
+        UpdateDisplayHash(chip8, i, 0);
+    }
+#endif
+
     memset(chip8->display, 0, DISPLAY_SIZE);
     return 2;
 }
@@ -718,7 +1209,7 @@ static uint16_t SkpHandler(Chip8 *chip8, uint16_t instruction)
 
     GetInstructionRegisters(instruction, &reg_x, NULL);
 
-    return (chip8->get_keys() & KEY_MASK(chip8->v[reg_x])) > 0 ? 4 : 2;
+    return (ReadKeys(chip8) & KEY_MASK(chip8->v[reg_x])) > 0 ? 4 : 2;
 }
 
 static uint16_t SknpHandler(Chip8 *chip8, uint16_t instruction)
@@ -727,7 +1218,7 @@ static uint16_t SknpHandler(Chip8 *chip8, uint16_t instruction)
 
     GetInstructionRegisters(instruction, &reg_x, NULL);
 
-    return (chip8->get_keys() & KEY_MASK(chip8->v[reg_x])) > 0 ? 2 : 4;
+    return (ReadKeys(chip8) & KEY_MASK(chip8->v[reg_x])) > 0 ? 2 : 4;
 }
 
 static uint16_t LdVxDtHandler(Chip8 *chip8, uint16_t instruction)
@@ -744,7 +1235,7 @@ static uint16_t LdVxDtHandler(Chip8 *chip8, uint16_t instruction)
 static uint16_t LdVxKHandler(Chip8 *chip8, uint16_t instruction)
 {
     uint8_t reg_x;
-    uint16_t keys = chip8->get_keys();
+    uint16_t keys = ReadKeys(chip8);
 
     GetInstructionRegisters(instruction, &reg_x, NULL);
 
@@ -820,38 +1311,105 @@ static uint16_t LdBVxHandler(Chip8 *chip8, uint16_t instruction)
 
     uint8_t val = chip8->v[reg_x];
     uint8_t hundreds_digit = val / 100;
+    uint16_t addr = I_ADDR(chip8);
+    unsigned int fault = CheckRange(chip8, addr, 3);
 
-    chip8->mem[chip8->i] = hundreds_digit;
+#ifdef CHIP8_STATE_HASH
+    UpdateMemHash(chip8, addr, hundreds_digit);
+    UpdateMemHash(chip8, addr + 1, (val / 10) % 10);
+    UpdateMemHash(chip8, addr + 2, val % 10);
+#endif
+
+    chip8->mem[addr] = hundreds_digit;
     val -= hundreds_digit * 100;
 
     uint8_t tens_digit = val / 10;
 
-    chip8->mem[chip8->i + 1] = tens_digit;
+    chip8->mem[addr + 1] = tens_digit;
     val -= tens_digit * 10;
 
-    chip8->mem[chip8->i + 2] = val;
+    chip8->mem[addr + 2] = val;
 
-    return 2;
+    return fault ? 0 : 2;
 }
 
-static uint16_t LdIVxHandler(Chip8 *chip8, uint16_t instruction)
+static inline uint16_t LdIVx(Chip8 *chip8, uint16_t instruction, const int increment_i)
 {
     uint8_t reg_x;
 
     GetInstructionRegisters(instruction, &reg_x, NULL);
-    memcpy(chip8->mem + chip8->i, chip8->v, reg_x + 1);
 
-    return 2;
+    uint16_t addr = I_ADDR(chip8);
+    unsigned int fault = CheckRange(chip8, addr, reg_x + 1);
+
+#ifdef CHIP8_STATE_HASH
+    for (unsigned int k = 0; k <= reg_x; k++)
+    {
+        UpdateMemHash(chip8, addr + k, chip8->v[k]);
+    }
+#endif
+
+    memcpy(chip8->mem + addr, chip8->v, reg_x + 1);
+
+    if (increment_i) chip8->i += reg_x + 1;
+
+    return fault ? 0 : 2;
 }
 
-static uint16_t LdVxIHandler(Chip8 *chip8, uint16_t instruction)
+QUIRK_HANDLERS(LdIVx)
+
+static inline uint16_t LdVxI(Chip8 *chip8, uint16_t instruction, const int increment_i)
 {
     uint8_t reg_x;
 
     GetInstructionRegisters(instruction, &reg_x, NULL);
-    memcpy(chip8->v, chip8->mem + chip8->i, reg_x + 1);
 
-    return 2;
+    uint16_t addr = I_ADDR(chip8);
+    unsigned int fault = CheckRange(chip8, addr, reg_x + 1);
+
+    memcpy(chip8->v, chip8->mem + addr, reg_x + 1);
+
+    if (increment_i) chip8->i += reg_x + 1;
+
+    return fault ? 0 : 2;
+}
+
+QUIRK_HANDLERS(LdVxI)
+
+static uint16_t ExecuteHooked(Chip8 *chip8, Chip8_InstructionType instruction_type, uint16_t instruction)
+{
+    Chip8_Hooks *hooks = &chip8->hooks;
+    Chip8_InstructionHandler handler = chip8->hooked_handlers[instruction_type];
+    uint16_t write_addr = I_ADDR(chip8);
+    unsigned int faults = chip8->faults;
+    uint16_t ret;
+
+    if (hooks->pre_instruction) hooks->pre_instruction(chip8, instruction_type, instruction, hooks->user_data);
+
+    ret = handler(chip8, instruction);
+
+    // a faulting write is not reported, and a write never reaches past the RAM (into the padding)
+    if (hooks->mem_write && chip8->faults == faults)
+    {
+        unsigned int len = 0;
+
+        if (instruction_type == LD_B_VX)
+        {
+            len = 3;
+        }
+        else if (instruction_type == LD_I_VX)
+        {
+            len = (HIGH_BYTE(instruction) & 0x0F) + 1;
+        }
+
+        if (len > (unsigned int)(RAM_SIZE - write_addr)) len = RAM_SIZE - write_addr;
+
+        if (len > 0) hooks->mem_write(chip8, write_addr, len, hooks->user_data);
+    }
+
+    if (hooks->post_instruction) hooks->post_instruction(chip8, instruction_type, instruction, hooks->user_data);
+
+    return ret;
 }
 
 static void DrawPixel(Chip8 *chip8, unsigned int draw_pos, uint8_t sprite_pixel, unsigned int *collision)
@@ -867,6 +1425,10 @@ static void DrawPixel(Chip8 *chip8, unsigned int draw_pos, uint8_t sprite_pixel,
 
     assert(display_index >= 0 && display_index < DISPLAY_SIZE);
 
+#ifdef CHIP8_STATE_HASH
+    UpdateDisplayHash(chip8, display_index, draw_pixel ? display_byte | draw_mask : display_byte & ~draw_mask);
+#endif
+
     if (draw_pixel)
     {
         chip8->display[display_index] |= draw_mask;
@@ -876,3 +1438,97 @@ static void DrawPixel(Chip8 *chip8, unsigned int draw_pos, uint8_t sprite_pixel,
         chip8->display[display_index] &= ~draw_mask;
     }
 }
+
+#ifdef CHIP8_PROFILER
+
+static uint64_t GetNanoseconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void ProfilerBeforeInstruction(Chip8_Profiler *profiler, uint16_t pc, Chip8_InstructionType instruction_type)
+{
+    profiler->instruction_counts[instruction_type]++;
+    profiler->pc_counts[pc % RAM_SIZE]++;
+    profiler->call_nodes[profiler->current_call_node].instruction_count++;
+}
+
+static void ProfilerAfterInstruction(Chip8_Profiler *profiler, uint16_t pc, Chip8_InstructionType instruction_type)
+{
+    if (instruction_type == CALL_ADDR)
+    {
+        ProfilerEnterCall(profiler, pc);
+    }
+    else if (instruction_type == RET)
+    {
+        ProfilerLeaveCall(profiler);
+    }
+}
+
+static void ProfilerEnterCall(Chip8_Profiler *profiler, uint16_t addr)
+{
+    if (profiler->untracked_call_depth > 0)
+    {
+        profiler->untracked_call_depth++;
+        return;
+    }
+
+    Chip8_ProfilerCallNode *caller = &profiler->call_nodes[profiler->current_call_node];
+
+    for (unsigned int child = caller->first_child; child != 0; child = profiler->call_nodes[child].next_sibling)
+    {
+        if (profiler->call_nodes[child].addr == addr)
+        {
+            profiler->current_call_node = child;
+            return;
+        }
+    }
+
+    if (profiler->call_node_count >= PROFILER_MAX_CALL_NODES)
+    {
+        // call tree is full, keep attributing to the caller until we get back to it
+        profiler->untracked_call_depth = 1;
+        return;
+    }
+
+    unsigned int node = profiler->call_node_count++;
+
+    profiler->call_nodes[node] = (Chip8_ProfilerCallNode){
+        .addr = addr,
+        .parent = profiler->current_call_node,
+        .first_child = 0,
+        .next_sibling = caller->first_child,
+        .instruction_count = 0
+    };
+    caller->first_child = node;
+    profiler->current_call_node = node;
+}
+
+static void ProfilerLeaveCall(Chip8_Profiler *profiler)
+{
+    if (profiler->untracked_call_depth > 0)
+    {
+        profiler->untracked_call_depth--;
+        return;
+    }
+
+    // a RET at the root is a bug in the ROM, stay at the root
+    profiler->current_call_node = profiler->call_nodes[profiler->current_call_node].parent;
+}
+
+static void WriteCallNodePath(Chip8_Profiler *profiler, unsigned int node, FILE *f)
+{
+    if (node != 0)
+    {
+        WriteCallNodePath(profiler, profiler->call_nodes[node].parent, f);
+        fputc(';', f);
+    }
+
+    fprintf(f, "0x%03X", profiler->call_nodes[node].addr);
+}
+
+#endif // CHIP8_PROFILER
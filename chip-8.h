@@ -2,8 +2,12 @@
 #define CHIP8_H
 
 #include <stdint.h>
+#include <stdio.h>
 
 #define RAM_SIZE 4096
+// bytes past the end of the RAM that instructions addressing memory through I can reach (I + 15 at most),
+// so their handlers never need a bounds check
+#define MEM_PADDING 16
 #define PROGRAM_START_ADDR 0x200
 #define INSTRUCTION_COUNT 35
 #define REGISTER_COUNT 16
@@ -16,28 +20,6 @@
 #define CPU_TICK_SECS (1 / CPU_FREQUENCY) 
 #define TIMER_TICK_SECS (1 / 60.0) // timer ticks at 60Hz
 
-typedef struct Chip8 Chip8;
-
-typedef uint16_t (*Chip8_InstructionHandler)(Chip8 *, uint16_t);
-typedef uint16_t (*GetKeysCb)(void);
-
-struct Chip8
-{
-    uint8_t v[REGISTER_COUNT];                                  // 16 8 bits general purpose registers
-    uint8_t dt;                                                 // special purpose 8 bits register used for delay timer
-    uint8_t st;                                                 // special purpose 8 bits register used for sound timer
-    uint16_t i;                                                 // 16 bit register generally used to store memory addresses (only 12 lowest bits are used)
-    uint16_t pc;                                                // program counter
-    uint8_t sp;                                                 // stack pointer
-    uint16_t stack[STACK_SIZE];                                 // stack
-    uint8_t mem[RAM_SIZE];                                      // RAM
-    uint8_t display[DISPLAY_SIZE];                              // pixels to display
-    unsigned int program_len;                                   // size of the program
-    double time_acc;                                            // time accumulator for timers
-    Chip8_InstructionHandler instruction_handlers[INSTRUCTION_COUNT];
-    GetKeysCb get_keys;                                         // is key pressed callback
-};
-
 typedef enum Chip8_InstructionType
 {
     UNKNOWN_INSTRUCTION,
@@ -95,14 +77,130 @@ typedef enum Chip8_InstructionType
     SKNP
 } Chip8_InstructionType;
 
+typedef struct Chip8 Chip8;
+
+#ifdef CHIP8_PROFILER
+
+#define PROFILER_MAX_CALL_NODES 1024
+
+typedef struct Chip8_ProfilerCallNode
+{
+    uint16_t addr;                                              // entry address of the subroutine (PROGRAM_START_ADDR for the root)
+    uint16_t parent;                                            // index of the caller node
+    uint16_t first_child;                                       // index of the first callee node (0 if none)
+    uint16_t next_sibling;                                      // index of the next callee of the same caller (0 if none)
+    uint64_t instruction_count;                                 // instructions executed while this node was on top of the call stack
+} Chip8_ProfilerCallNode;
+
+typedef struct Chip8_Profiler
+{
+    uint64_t instruction_counts[INSTRUCTION_COUNT];             // executions per instruction type
+    uint64_t pc_counts[RAM_SIZE];                               // executions per PC address
+    uint64_t drw_nsecs;                                         // time spent in DRW
+    Chip8_ProfilerCallNode call_nodes[PROFILER_MAX_CALL_NODES]; // call tree built from CALL/RET (node 0 is the root)
+    unsigned int call_node_count;
+    unsigned int current_call_node;
+    unsigned int untracked_call_depth;                          // calls made once the call tree was full
+} Chip8_Profiler;
+
+#endif // CHIP8_PROFILER
+
+// behaviours that differ between interpreters, the default (0) is the historical behaviour of this emulator
+typedef enum Chip8_Quirk
+{
+    CHIP8_QUIRK_SHIFT_VY = 1 << 0,      // SHR/SHL shift VY into VX instead of shifting VX
+    CHIP8_QUIRK_LOAD_STORE_I = 1 << 1,  // LD [I], VX and LD VX, [I] increment I by X + 1
+    CHIP8_QUIRK_DRAW_CLIP = 1 << 2,     // sprites are clipped at the screen edges instead of wrapping around
+    CHIP8_QUIRK_VF_RESET = 1 << 3       // OR, AND and XOR reset VF
+} Chip8_Quirk;
+
+#define CHIP8_QUIRK_COUNT 4
+#define CHIP8_QUIRK_ALL ((1 << CHIP8_QUIRK_COUNT) - 1)
+
+// errors of the running program, an instance stops running at the first one (see Chip8_Tick)
+typedef enum Chip8_Fault
+{
+    CHIP8_FAULT_STACK_OVERFLOW = 1 << 0,        // CALL with a full stack
+    CHIP8_FAULT_STACK_UNDERFLOW = 1 << 1,       // RET with an empty stack
+    CHIP8_FAULT_OUT_OF_RANGE = 1 << 2,          // memory access through I past the end of the RAM
+    CHIP8_FAULT_UNKNOWN_INSTRUCTION = 1 << 3
+} Chip8_Fault;
+
+typedef uint16_t (*Chip8_InstructionHandler)(Chip8 *, uint16_t);
+typedef uint16_t (*GetKeysCb)(void *user_data);
+
+typedef struct Chip8_Hooks
+{
+    // called before the handler of every instruction (instruction is the 12 lowest bits, as passed to the handlers)
+    void (*pre_instruction)(Chip8 *chip8, Chip8_InstructionType instruction_type, uint16_t instruction, void *user_data);
+    // called after the handler, before the PC is advanced
+    void (*post_instruction)(Chip8 *chip8, Chip8_InstructionType instruction_type, uint16_t instruction, void *user_data);
+    // called after an instruction wrote len bytes of RAM starting at addr (not for writes that fault)
+    void (*mem_write)(Chip8 *chip8, uint16_t addr, unsigned int len, void *user_data);
+    void *user_data;
+} Chip8_Hooks;
+
+struct Chip8
+{
+    uint8_t v[REGISTER_COUNT];                                  // 16 8 bits general purpose registers
+    uint8_t dt;                                                 // special purpose 8 bits register used for delay timer
+    uint8_t st;                                                 // special purpose 8 bits register used for sound timer
+    uint16_t i;                                                 // 16 bit register generally used to store memory addresses (only 12 lowest bits are used)
+    uint16_t pc;                                                // program counter
+    uint8_t sp;                                                 // stack pointer
+    uint16_t stack[STACK_SIZE];                                 // stack
+    uint8_t mem[RAM_SIZE + MEM_PADDING];                        // RAM (see MEM_PADDING)
+    uint8_t display[DISPLAY_SIZE];                              // pixels to display
+    unsigned int program_len;                                   // size of the program
+    uint64_t program_hash;                                      // Chip8_Hash of the program, set by Chip8_Load
+    double frequency;                                           // instructions per second (see Chip8_SetFrequency)
+    double tick_secs;                                           // emulated duration of an instruction (1 / frequency)
+    double time_acc;                                            // time accumulator for timers
+    Chip8_InstructionHandler instruction_handlers[INSTRUCTION_COUNT];
+    uint16_t keys;                                              // keys held, bit 0xF - k for key k (see Chip8_SetKeys)
+    GetKeysCb get_keys;                                         // optional, refreshes keys before each key check
+    void *get_keys_user_data;
+    Chip8_Hooks hooks;                                          // instrumentation hooks (see Chip8_SetHooks)
+    Chip8_InstructionHandler hooked_handlers[INSTRUCTION_COUNT]; // original handlers, called by the hook trampolines
+    int hooked;                                                 // 1 when the hook trampolines are installed
+    unsigned int quirks;                                        // Chip8_Quirk flags (see Chip8_SetQuirks)
+    unsigned int faults;                                        // Chip8_Fault flags, cleared by Chip8_Reset
+    uint32_t rng_state;                                         // RND generator state (see Chip8_SetSeed)
+#ifdef CHIP8_STATE_HASH
+    uint64_t state_hash;                                        // memory and display part of Chip8_StateHash, kept up to date by the handlers
+#endif
+#ifdef CHIP8_PROFILER
+    Chip8_Profiler *profiler;                                   // NULL when not profiling
+#endif
+};
+
 void Chip8_Init(Chip8 *chip8);
 void Chip8_Reset(Chip8 *chip8);
 int Chip8_Load(Chip8 *chip8, uint8_t *data, unsigned int len);
 int Chip8_LoadFromFile(Chip8 *chip8, const char *path);
+uint64_t Chip8_Hash(const uint8_t *data, unsigned int len);
+uint64_t Chip8_StateHash(const Chip8 *chip8);
+void Chip8_RehashState(Chip8 *chip8);
 int Chip8_GetNextInstruction(Chip8 *chip8, Chip8_InstructionType *instruction_type, uint16_t *instruction);
+void Chip8_DecodeInstruction(uint16_t opcode, Chip8_InstructionType *instruction_type, uint16_t *instruction);
 uint16_t Chip8_ExecuteInstruction(Chip8 *chip8, Chip8_InstructionType opcode, uint16_t instruction);
 unsigned int Chip8_GetPixel(Chip8 *chip8, unsigned int pos);
-void Chip8_SetGetKeysCallback(Chip8 *chip8, GetKeysCb cb);
+void Chip8_SetKeys(Chip8 *chip8, uint16_t keys);
+void Chip8_SetGetKeysCallback(Chip8 *chip8, GetKeysCb cb, void *user_data);
 int Chip8_Tick(Chip8 *chip8);
+unsigned long Chip8_Run(Chip8 *chip8, unsigned long cycles);
+const char *Chip8_GetFaultName(unsigned int faults);
+const char *Chip8_GetInstructionName(Chip8_InstructionType instruction_type);
+void Chip8_SetHooks(Chip8 *chip8, const Chip8_Hooks *hooks);
+void Chip8_SetQuirks(Chip8 *chip8, unsigned int quirks);
+void Chip8_SetFrequency(Chip8 *chip8, double frequency);
+void Chip8_SetSeed(Chip8 *chip8, uint32_t seed);
+
+#ifdef CHIP8_PROFILER
+void Chip8_SetProfiler(Chip8 *chip8, Chip8_Profiler *profiler);
+void Chip8_ResetProfiler(Chip8_Profiler *profiler);
+void Chip8_WriteProfileJSON(Chip8_Profiler *profiler, FILE *f);
+void Chip8_WriteProfileCollapsed(Chip8_Profiler *profiler, FILE *f);
+#endif
 
 #endif // CHIP8_H
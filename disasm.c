@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "disasm.h"
+
+static int IsSkip(Chip8_InstructionType instruction_type);
+static int DecodeAt(Chip8 *chip8, Disasm_BlockMap *map, uint16_t addr, Chip8_InstructionType *instruction_type, uint16_t *instruction);
+static void MarkLeader(Disasm_BlockMap *map, uint16_t addr, uint8_t flags);
+static void TraverseCode(Chip8 *chip8, Disasm_BlockMap *map);
+static void SplitBlocks(Chip8 *chip8, Disasm_BlockMap *map);
+static void AddSuccessor(Disasm_BlockMap *map, Disasm_Block *block, unsigned int addr);
+
+int Disasm_FormatInstruction(Chip8_InstructionType instruction_type, uint16_t instruction, char *buf, size_t size)
+{
+    uint8_t x_reg = (instruction & 0x0F00) >> 8;
+    uint8_t y_reg = (instruction & 0x00F0) >> 4;
+    uint8_t low_byte = instruction & 0xFF;
+    uint8_t nibble = low_byte & 0xF;
+
+    switch (instruction_type)
+    {
+        case UNKNOWN_INSTRUCTION:
+            return snprintf(buf, size, "NOP");
+
+        case CLS:
+            return snprintf(buf, size, "CLS");
+
+        case RET:
+            return snprintf(buf, size, "RET");
+
+        case JP_ADDR:
+            return snprintf(buf, size, "JP 0x%X", instruction);
+
+        case CALL_ADDR:
+            return snprintf(buf, size, "CALL 0x%X", instruction);
+
+        case SE_VX_BYTE:
+            return snprintf(buf, size, "SE V%X, 0x%X", x_reg, low_byte);
+
+        case SNE_VX_BYTE:
+            return snprintf(buf, size, "SNE V%X, 0x%X", x_reg, low_byte);
+
+        case SE_VX_VY:
+            return snprintf(buf, size, "SE V%X, V%X", x_reg, y_reg);
+
+        case LD_VX_BYTE:
+            return snprintf(buf, size, "LD V%X, 0x%X", x_reg, low_byte);
+
+        case ADD_VX_BYTE:
+            return snprintf(buf, size, "ADD V%X, 0x%X", x_reg, low_byte);
+
+        case LD_VX_VY:
+            return snprintf(buf, size, "LD V%X, V%X", x_reg, y_reg);
+
+        case OR:
+            return snprintf(buf, size, "OR V%X, V%X", x_reg, y_reg);
+
+        case AND:
+            return snprintf(buf, size, "AND V%X, V%X", x_reg, y_reg);
+
+        case XOR:
+            return snprintf(buf, size, "XOR V%X, V%X", x_reg, y_reg);
+
+        case ADD_VX_VY:
+            return snprintf(buf, size, "ADD V%X, V%X", x_reg, y_reg);
+
+        case SUB:
+            return snprintf(buf, size, "SUB V%X, V%X", x_reg, y_reg);
+
+        case SHR:
+            return snprintf(buf, size, "SHR V%X {, V%X}", x_reg, y_reg);
+
+        case SUBN:
+            return snprintf(buf, size, "SUBN V%X, V%X", x_reg, y_reg);
+
+        case SHL:
+            return snprintf(buf, size, "SHL V%X {, V%X}", x_reg, y_reg);
+
+        case SNE_VX_VY:
+            return snprintf(buf, size, "SNE V%X, V%X", x_reg, y_reg);
+
+        case LD_I_ADDR:
+            return snprintf(buf, size, "LD I, 0x%X", instruction);
+
+        case JP_V0_ADDR:
+            return snprintf(buf, size, "JP V0, 0x%X", instruction);
+
+        case RND:
+            return snprintf(buf, size, "RND V%X, 0x%X", x_reg, low_byte);
+
+        case DRW:
+            return snprintf(buf, size, "DRW V%X, V%X, 0x%X", x_reg, y_reg, nibble);
+
+        case SKP:
+            return snprintf(buf, size, "SKP V%X", x_reg);
+
+        case SKNP:
+            return snprintf(buf, size, "SKNP V%X", x_reg);
+
+        case LD_VX_DT:
+            return snprintf(buf, size, "LD V%X, DT", x_reg);
+
+        case LD_VX_K:
+            return snprintf(buf, size, "LD V%X, K", x_reg);
+
+        case LD_DT_VX:
+            return snprintf(buf, size, "LD DT, V%X", x_reg);
+
+        case LD_ST_VX:
+            return snprintf(buf, size, "LD ST, V%X", x_reg);
+
+        case ADD_I_VX:
+            return snprintf(buf, size, "ADD I, V%X", x_reg);
+
+        case LD_F_VX:
+            return snprintf(buf, size, "LD F, V%X", x_reg);
+
+        case LD_B_VX:
+            return snprintf(buf, size, "LD B, V%X", x_reg);
+
+        case LD_I_VX:
+            return snprintf(buf, size, "LD [I], V%X", x_reg);
+
+        case LD_VX_I:
+            return snprintf(buf, size, "LD V%X, [I]", x_reg);
+
+        default:
+            return snprintf(buf, size, "???");
+    }
+}
+
+void Disasm_BuildBlockMap(Chip8 *chip8, Disasm_BlockMap *map)
+{
+    memset(map, 0, sizeof(Disasm_BlockMap));
+
+    map->program_start = PROGRAM_START_ADDR;
+    map->program_end = PROGRAM_START_ADDR + chip8->program_len;
+
+    TraverseCode(chip8, map);
+    SplitBlocks(chip8, map);
+}
+
+const Disasm_Block *Disasm_FindBlock(const Disasm_BlockMap *map, uint16_t addr)
+{
+    unsigned int low = 0;
+    unsigned int high = map->block_count;
+
+    while (low < high)
+    {
+        unsigned int mid = (low + high) / 2;
+        const Disasm_Block *block = &map->blocks[mid];
+
+        if (addr < block->start)
+        {
+            high = mid;
+        }
+        else if (addr >= block->end)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            return block;
+        }
+    }
+
+    return NULL;
+}
+
+static int IsSkip(Chip8_InstructionType instruction_type)
+{
+    return instruction_type == SE_VX_BYTE || instruction_type == SNE_VX_BYTE ||
+        instruction_type == SE_VX_VY || instruction_type == SNE_VX_VY ||
+        instruction_type == SKP || instruction_type == SKNP;
+}
+
+static int DecodeAt(Chip8 *chip8, Disasm_BlockMap *map, uint16_t addr, Chip8_InstructionType *instruction_type, uint16_t *instruction)
+{
+    if (addr < map->program_start || addr + 1 >= map->program_end)
+    {
+        return 0;
+    }
+
+    Chip8_DecodeInstruction((chip8->mem[addr] << 8) | chip8->mem[addr + 1], instruction_type, instruction);
+
+    return *instruction_type != UNKNOWN_INSTRUCTION;
+}
+
+static void MarkLeader(Disasm_BlockMap *map, uint16_t addr, uint8_t flags)
+{
+    if (addr < RAM_SIZE)
+    {
+        map->flags[addr] |= DISASM_LEADER | flags;
+    }
+}
+
+static void TraverseCode(Chip8 *chip8, Disasm_BlockMap *map)
+{
+    // an instruction is followed once (when its DISASM_INSTRUCTION flag is set) and pushes at most one address,
+    // so RAM_SIZE entries is enough
+    uint16_t *worklist = map->worklist;
+    unsigned int worklist_len = 0;
+
+    worklist[worklist_len++] = map->program_start;
+    MarkLeader(map, map->program_start, 0);
+
+    while (worklist_len > 0)
+    {
+        uint16_t addr = worklist[--worklist_len];
+        Chip8_InstructionType instruction_type;
+        uint16_t instruction;
+
+        // follow the straight line code until control leaves it
+        while (DecodeAt(chip8, map, addr, &instruction_type, &instruction) && !(map->flags[addr] & DISASM_INSTRUCTION))
+        {
+            map->flags[addr] |= DISASM_CODE | DISASM_INSTRUCTION;
+            map->flags[addr + 1] |= DISASM_CODE;
+
+            uint16_t next = addr + 2;
+
+            if (instruction_type == JP_ADDR)
+            {
+                MarkLeader(map, instruction, DISASM_JUMP_TARGET);
+                worklist[worklist_len++] = instruction;
+                break;
+            }
+            else if (instruction_type == CALL_ADDR)
+            {
+                MarkLeader(map, instruction, DISASM_SUBROUTINE);
+                MarkLeader(map, next, 0);
+                worklist[worklist_len++] = instruction;
+            }
+            else if (IsSkip(instruction_type))
+            {
+                MarkLeader(map, next, 0);
+                MarkLeader(map, next + 2, 0);
+                worklist[worklist_len++] = next + 2;
+            }
+            else if (instruction_type == RET || instruction_type == JP_V0_ADDR)
+            {
+                break;
+            }
+
+            addr = next;
+        }
+    }
+}
+
+static void SplitBlocks(Chip8 *chip8, Disasm_BlockMap *map)
+{
+    Disasm_Block *block = NULL;
+
+    for (unsigned int addr = map->program_start; addr < map->program_end; addr++)
+    {
+        if (!(map->flags[addr] & DISASM_INSTRUCTION))
+        {
+            continue;
+        }
+
+        if (!block || block->end != addr || (map->flags[addr] & DISASM_LEADER))
+        {
+            block = &map->blocks[map->block_count++];
+            block->start = addr;
+            block->exit = DISASM_EXIT_END;
+            map->flags[addr] |= DISASM_LEADER;
+        }
+
+        Chip8_InstructionType instruction_type;
+        uint16_t instruction;
+
+        DecodeAt(chip8, map, addr, &instruction_type, &instruction);
+
+        block->end = addr + 2;
+
+        if (instruction_type == JP_ADDR)
+        {
+            block->exit = DISASM_EXIT_JUMP;
+            AddSuccessor(map, block, instruction);
+        }
+        else if (instruction_type == CALL_ADDR)
+        {
+            block->exit = DISASM_EXIT_CALL;
+            AddSuccessor(map, block, instruction);
+            AddSuccessor(map, block, addr + 2);
+        }
+        else if (IsSkip(instruction_type))
+        {
+            block->exit = DISASM_EXIT_SKIP;
+            AddSuccessor(map, block, addr + 2);
+            AddSuccessor(map, block, addr + 4);
+        }
+        else if (instruction_type == RET)
+        {
+            block->exit = DISASM_EXIT_RETURN;
+        }
+        else if (instruction_type == JP_V0_ADDR)
+        {
+            block->exit = DISASM_EXIT_INDIRECT;
+        }
+        else if (addr + 2 < RAM_SIZE && (map->flags[addr + 2] & DISASM_INSTRUCTION) && (map->flags[addr + 2] & DISASM_LEADER))
+        {
+            block->exit = DISASM_EXIT_FALLTHROUGH;
+            AddSuccessor(map, block, addr + 2);
+        }
+        else
+        {
+            continue;
+        }
+
+        // control flow instructions always end their block
+        block = NULL;
+    }
+}
+
+// only addresses starting a block are successors, control leaving the reachable code (past the end of the
+// program, into data or an unknown instruction) has no block to go to
+static void AddSuccessor(Disasm_BlockMap *map, Disasm_Block *block, unsigned int addr)
+{
+    if (addr < RAM_SIZE && (map->flags[addr] & DISASM_INSTRUCTION))
+    {
+        block->successors[block->successor_count++] = addr;
+    }
+}
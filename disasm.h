@@ -0,0 +1,59 @@
+#ifndef DISASM_H
+#define DISASM_H
+
+#include <stddef.h>
+
+#include "chip-8.h"
+
+#define DISASM_MNEMONIC_MAX_LEN 32
+#define DISASM_MAX_BLOCKS RAM_SIZE      // a block per address, instructions overlapping at odd addresses included
+
+// per address flags of a block map
+#define DISASM_CODE (1 << 0)        // byte belongs to an instruction reached from the entry point
+#define DISASM_INSTRUCTION (1 << 1) // first byte of a reachable instruction
+#define DISASM_LEADER (1 << 2)      // first instruction of a basic block
+#define DISASM_JUMP_TARGET (1 << 3) // target of a JP
+#define DISASM_SUBROUTINE (1 << 4)  // target of a CALL
+
+// how a basic block ends
+typedef enum Disasm_BlockExit
+{
+    DISASM_EXIT_FALLTHROUGH,        // next block starts right after (it is the target of a branch)
+    DISASM_EXIT_JUMP,               // JP addr
+    DISASM_EXIT_CALL,               // CALL addr, returns to the next block
+    DISASM_EXIT_SKIP,               // SE/SNE/SKP/SKNP, continues 2 or 4 bytes further
+    DISASM_EXIT_RETURN,             // RET
+    DISASM_EXIT_INDIRECT,           // JP V0, addr (target unknown statically)
+    DISASM_EXIT_END                 // runs into data, an unknown instruction or the end of the program
+} Disasm_BlockExit;
+
+typedef struct Disasm_Block
+{
+    uint16_t start;                 // address of the first instruction
+    uint16_t end;                   // address right after the last instruction
+    Disasm_BlockExit exit;
+    uint16_t successors[2];         // addresses of the blocks control can flow to, none outside the reachable code
+    unsigned int successor_count;
+} Disasm_Block;
+
+typedef struct Disasm_BlockMap
+{
+    uint16_t program_start;
+    uint16_t program_end;
+    uint8_t flags[RAM_SIZE];
+    Disasm_Block blocks[DISASM_MAX_BLOCKS]; // sorted by start address
+    unsigned int block_count;
+    uint16_t worklist[RAM_SIZE];            // scratch of Disasm_BuildBlockMap, one per map so maps build concurrently
+} Disasm_BlockMap;
+
+// writes the mnemonic of an instruction (as decoded by Chip8_DecodeInstruction) in buf, returns snprintf's result
+int Disasm_FormatInstruction(Chip8_InstructionType instruction_type, uint16_t instruction, char *buf, size_t size);
+
+// follows JP/CALL/skips/RET from PROGRAM_START_ADDR to split the loaded program into basic blocks,
+// everything that is never reached stays unflagged and is considered data
+void Disasm_BuildBlockMap(Chip8 *chip8, Disasm_BlockMap *map);
+
+// returns the block containing addr or NULL if addr is not reachable code
+const Disasm_Block *Disasm_FindBlock(const Disasm_BlockMap *map, uint16_t addr);
+
+#endif // DISASM_H
@@ -0,0 +1,496 @@
+#include <dirent.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "chip-8.h"
+#include "disasm.h"
+#include "disasm_batch.h"
+
+#define OUTPUT_BUFFER_INITIAL_SIZE (256 * 1024)
+#define BATCH_PATH_MAX_LEN 4096
+
+typedef struct OutputBuffer
+{
+    char *data;
+    size_t len;
+    size_t capacity;
+} OutputBuffer;
+
+typedef struct BatchStats
+{
+    unsigned long long instruction_counts[INSTRUCTION_COUNT];
+    unsigned long rom_count;
+    unsigned long failed_rom_count;
+    unsigned long roms_with_unknown_count;
+    unsigned long blocks_into_unknown_count;    // recursive mode only, see DisassembleRecursive
+    unsigned long roms_with_blocks_into_unknown_count;
+    unsigned long long bytes;
+} BatchStats;
+
+typedef struct Batch
+{
+    const Disasm_BatchOptions *options;
+    char **rom_names;
+    unsigned int rom_count;
+    atomic_uint next_rom;
+    FILE *jsonl_file;
+    pthread_mutex_t jsonl_mutex;
+    Chip8 template_chip8;
+} Batch;
+
+typedef struct Worker
+{
+    pthread_t thread;
+    Batch *batch;
+    Chip8 chip8;
+    Disasm_BlockMap *map;
+    OutputBuffer output;
+    BatchStats stats;
+} Worker;
+
+static int ListRoms(Batch *batch);
+static void *RunWorker(void *data);
+static void DisassembleRom(Worker *worker, const char *rom_name);
+static unsigned long DisassembleLinear(Worker *worker, int json);
+static unsigned long DisassembleRecursive(Worker *worker, int json, unsigned long *blocks_into_unknown);
+static void AppendInstruction(Worker *worker, uint16_t addr, Chip8_InstructionType instruction_type, uint16_t instruction, int json, int *first);
+static int WriteOutput(Worker *worker, const char *rom_name);
+static void Append(OutputBuffer *buffer, const char *fmt, ...);
+static void AppendJsonString(OutputBuffer *buffer, const char *str);
+static void MergeStats(BatchStats *total, const BatchStats *stats);
+static void PrintStats(const BatchStats *stats, int recursive, unsigned int jobs, double elapsed_secs);
+static int CompareNames(const void *a, const void *b);
+static double GetSeconds(void);
+
+int Disasm_RunBatch(const Disasm_BatchOptions *options)
+{
+    Batch batch;
+
+    memset(&batch, 0, sizeof(Batch));
+    batch.options = options;
+
+    if (ListRoms(&batch) < 0)
+    {
+        fprintf(stderr, "Failed to read ROMs directory (path: %s)\n", options->roms_dir);
+        return -1;
+    }
+
+    if (options->jsonl_path)
+    {
+        batch.jsonl_file = fopen(options->jsonl_path, "w");
+
+        if (!batch.jsonl_file)
+        {
+            fprintf(stderr, "Failed to open %s\n", options->jsonl_path);
+            return -1;
+        }
+    }
+    else
+    {
+        mkdir(options->out_dir, 0755);
+    }
+
+    pthread_mutex_init(&batch.jsonl_mutex, NULL);
+    atomic_init(&batch.next_rom, 0);
+
+    // workers copy this instance instead of calling Chip8_Init themselves
+    Chip8_Init(&batch.template_chip8);
+
+    unsigned int jobs = options->jobs ? options->jobs : (unsigned int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (jobs == 0) jobs = 1;
+
+    Worker *workers = calloc(jobs, sizeof(Worker));
+    double start = GetSeconds();
+
+    for (unsigned int i = 0; i < jobs; i++)
+    {
+        workers[i].batch = &batch;
+        pthread_create(&workers[i].thread, NULL, RunWorker, &workers[i]);
+    }
+
+    BatchStats total;
+
+    memset(&total, 0, sizeof(BatchStats));
+
+    for (unsigned int i = 0; i < jobs; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        MergeStats(&total, &workers[i].stats);
+    }
+
+    PrintStats(&total, options->recursive, jobs, GetSeconds() - start);
+
+    if (batch.jsonl_file) fclose(batch.jsonl_file);
+
+    pthread_mutex_destroy(&batch.jsonl_mutex);
+
+    for (unsigned int i = 0; i < batch.rom_count; i++)
+    {
+        free(batch.rom_names[i]);
+    }
+
+    free(batch.rom_names);
+    free(workers);
+
+    return total.failed_rom_count > 0 ? -1 : 0;
+}
+
+static int ListRoms(Batch *batch)
+{
+    DIR *dir = opendir(batch->options->roms_dir);
+    struct dirent *ent;
+    unsigned int capacity = 0;
+
+    if (!dir)
+    {
+        return -1;
+    }
+
+    while ((ent = readdir(dir)) != NULL)
+    {
+        if (ent->d_type != DT_REG)
+        {
+            continue;
+        }
+
+        if (batch->rom_count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            batch->rom_names = realloc(batch->rom_names, sizeof(char *) * capacity);
+        }
+
+        batch->rom_names[batch->rom_count++] = strdup(ent->d_name);
+    }
+
+    closedir(dir);
+
+    // work is handed out in name order, the JSON lines stream is still written in completion order
+    qsort(batch->rom_names, batch->rom_count, sizeof(char *), CompareNames);
+
+    return 0;
+}
+
+static void *RunWorker(void *data)
+{
+    Worker *worker = data;
+    Batch *batch = worker->batch;
+
+    worker->output.capacity = OUTPUT_BUFFER_INITIAL_SIZE;
+    worker->output.data = malloc(worker->output.capacity);
+
+    if (batch->options->recursive)
+    {
+        worker->map = malloc(sizeof(Disasm_BlockMap));
+    }
+
+    unsigned int rom;
+
+    while ((rom = atomic_fetch_add(&batch->next_rom, 1)) < batch->rom_count)
+    {
+        DisassembleRom(worker, batch->rom_names[rom]);
+    }
+
+    free(worker->output.data);
+    free(worker->map);
+
+    return NULL;
+}
+
+static void DisassembleRom(Worker *worker, const char *rom_name)
+{
+    const Disasm_BatchOptions *options = worker->batch->options;
+    char rom_path[BATCH_PATH_MAX_LEN];
+    int json = options->jsonl_path != NULL;
+
+    snprintf(rom_path, sizeof(rom_path), "%s/%s", options->roms_dir, rom_name);
+    memcpy(&worker->chip8, &worker->batch->template_chip8, sizeof(Chip8));
+
+    if (Chip8_LoadFromFile(&worker->chip8, rom_path) < 0)
+    {
+        fprintf(stderr, "Failed to load ROM (path: %s)\n", rom_path);
+        worker->stats.failed_rom_count++;
+        return;
+    }
+
+    OutputBuffer *output = &worker->output;
+
+    output->len = 0;
+
+    if (json)
+    {
+        Append(output, "{\"rom\": ");
+        AppendJsonString(output, rom_name);
+        Append(output, ", \"length\": %u, \"listing\": [", worker->chip8.program_len);
+    }
+    else
+    {
+        Append(output, "; %s (program length: %u)\n", rom_name, worker->chip8.program_len);
+    }
+
+    unsigned long blocks_into_unknown = 0;
+    unsigned long unknown_count = options->recursive ?
+        DisassembleRecursive(worker, json, &blocks_into_unknown) : DisassembleLinear(worker, json);
+
+    // "unknown" counts the unknown opcodes listed in both modes
+    if (json && options->recursive)
+    {
+        Append(output, "], \"unknown\": %lu, \"blocks_into_unknown\": %lu}\n", unknown_count, blocks_into_unknown);
+    }
+    else if (json)
+    {
+        Append(output, "], \"unknown\": %lu}\n", unknown_count);
+    }
+
+    if (WriteOutput(worker, rom_name) < 0)
+    {
+        fprintf(stderr, "Failed to write the disassembly of %s\n", rom_name);
+        worker->stats.failed_rom_count++;
+        return;
+    }
+
+    worker->stats.rom_count++;
+    worker->stats.bytes += worker->chip8.program_len;
+
+    if (unknown_count > 0) worker->stats.roms_with_unknown_count++;
+
+    worker->stats.blocks_into_unknown_count += blocks_into_unknown;
+
+    if (blocks_into_unknown > 0) worker->stats.roms_with_blocks_into_unknown_count++;
+}
+
+static unsigned long DisassembleLinear(Worker *worker, int json)
+{
+    Chip8 *chip8 = &worker->chip8;
+    Chip8_InstructionType instruction_type;
+    uint16_t instruction;
+    unsigned long unknown_count = 0;
+    int first = 1;
+
+    while (Chip8_GetNextInstruction(chip8, &instruction_type, &instruction))
+    {
+        AppendInstruction(worker, chip8->pc, instruction_type, instruction, json, &first);
+
+        if (instruction_type == UNKNOWN_INSTRUCTION) unknown_count++;
+
+        chip8->pc += 2;
+    }
+
+    return unknown_count;
+}
+
+// returns the unknown opcodes listed, and the blocks running into one in blocks_into_unknown
+static unsigned long DisassembleRecursive(Worker *worker, int json, unsigned long *blocks_into_unknown)
+{
+    Chip8 *chip8 = &worker->chip8;
+    Disasm_BlockMap *map = worker->map;
+    unsigned long unknown_count = 0;
+    int first = 1;
+
+    Disasm_BuildBlockMap(chip8, map);
+
+    for (unsigned int b = 0; b < map->block_count; b++)
+    {
+        const Disasm_Block *block = &map->blocks[b];
+
+        if (!json)
+        {
+            Append(&worker->output, "%s_%03X:\n", (map->flags[block->start] & DISASM_SUBROUTINE) ? "sub" : "block", block->start);
+        }
+
+        for (unsigned int addr = block->start; addr < block->end; addr += 2)
+        {
+            Chip8_InstructionType instruction_type;
+            uint16_t instruction;
+
+            Chip8_DecodeInstruction((chip8->mem[addr] << 8) | chip8->mem[addr + 1], &instruction_type, &instruction);
+            AppendInstruction(worker, addr, instruction_type, instruction, json, &first);
+
+            if (instruction_type == UNKNOWN_INSTRUCTION) unknown_count++;
+        }
+    }
+
+    // blocks stop before unknown instructions, so the listing has none: count the blocks running into one instead
+    for (unsigned int b = 0; b < map->block_count; b++)
+    {
+        uint16_t end = map->blocks[b].end;
+
+        if (map->blocks[b].exit == DISASM_EXIT_END && end + 1 < map->program_end && !(map->flags[end] & DISASM_INSTRUCTION))
+        {
+            (*blocks_into_unknown)++;
+        }
+    }
+
+    return unknown_count;
+}
+
+static void AppendInstruction(Worker *worker, uint16_t addr, Chip8_InstructionType instruction_type, uint16_t instruction, int json, int *first)
+{
+    char mnemonic[DISASM_MNEMONIC_MAX_LEN];
+
+    Disasm_FormatInstruction(instruction_type, instruction, mnemonic, sizeof(mnemonic));
+    worker->stats.instruction_counts[instruction_type]++;
+
+    if (json)
+    {
+        Append(&worker->output, "%s[%u, \"%s\"]", *first ? "" : ", ", addr, mnemonic);
+        *first = 0;
+    }
+    else
+    {
+        Append(&worker->output, "0x%x\t%s\n", addr, mnemonic);
+    }
+}
+
+static int WriteOutput(Worker *worker, const char *rom_name)
+{
+    Batch *batch = worker->batch;
+    OutputBuffer *output = &worker->output;
+
+    if (batch->jsonl_file)
+    {
+        pthread_mutex_lock(&batch->jsonl_mutex);
+
+        size_t written = fwrite(output->data, 1, output->len, batch->jsonl_file);
+
+        pthread_mutex_unlock(&batch->jsonl_mutex);
+
+        return written == output->len ? 0 : -1;
+    }
+
+    char path[BATCH_PATH_MAX_LEN];
+
+    snprintf(path, sizeof(path), "%s/%s.asm", batch->options->out_dir, rom_name);
+
+    FILE *f = fopen(path, "w");
+
+    if (!f)
+    {
+        return -1;
+    }
+
+    size_t written = fwrite(output->data, 1, output->len, f);
+
+    return (fclose(f) == 0 && written == output->len) ? 0 : -1;
+}
+
+static void Append(OutputBuffer *buffer, const char *fmt, ...)
+{
+    va_list args;
+
+    for (;;)
+    {
+        size_t available = buffer->capacity - buffer->len;
+
+        va_start(args, fmt);
+        int len = vsnprintf(buffer->data + buffer->len, available, fmt, args);
+        va_end(args);
+
+        if (len < 0)
+        {
+            return;
+        }
+
+        if ((size_t)len < available)
+        {
+            buffer->len += len;
+            return;
+        }
+
+        buffer->capacity *= 2;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+}
+
+static void AppendJsonString(OutputBuffer *buffer, const char *str)
+{
+    Append(buffer, "\"");
+
+    for (const char *c = str; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            Append(buffer, "\\%c", *c);
+        }
+        else if ((unsigned char)*c < 0x20)
+        {
+            Append(buffer, "\\u%04x", *c);
+        }
+        else
+        {
+            Append(buffer, "%c", *c);
+        }
+    }
+
+    Append(buffer, "\"");
+}
+
+static void MergeStats(BatchStats *total, const BatchStats *stats)
+{
+    for (int i = 0; i < INSTRUCTION_COUNT; i++)
+    {
+        total->instruction_counts[i] += stats->instruction_counts[i];
+    }
+
+    total->rom_count += stats->rom_count;
+    total->failed_rom_count += stats->failed_rom_count;
+    total->roms_with_unknown_count += stats->roms_with_unknown_count;
+    total->blocks_into_unknown_count += stats->blocks_into_unknown_count;
+    total->roms_with_blocks_into_unknown_count += stats->roms_with_blocks_into_unknown_count;
+    total->bytes += stats->bytes;
+}
+
+static void PrintStats(const BatchStats *stats, int recursive, unsigned int jobs, double elapsed_secs)
+{
+    unsigned long long total_instructions = 0;
+
+    for (int i = 0; i < INSTRUCTION_COUNT; i++)
+    {
+        total_instructions += stats->instruction_counts[i];
+    }
+
+    printf("ROMs: %lu disassembled, %lu failed, %lu with unknown opcodes\n",
+            stats->rom_count, stats->failed_rom_count, stats->roms_with_unknown_count);
+    printf("Bytes: %llu, instructions: %llu, unknown opcodes: %llu\n",
+            stats->bytes, total_instructions, stats->instruction_counts[UNKNOWN_INSTRUCTION]);
+
+    if (recursive)
+    {
+        printf("Blocks running into an unknown opcode: %lu (ROMs: %lu)\n",
+                stats->blocks_into_unknown_count, stats->roms_with_blocks_into_unknown_count);
+    }
+
+    printf("Time: %.3fs (worker threads: %u)\n\n", elapsed_secs, jobs);
+    printf("Opcode histogram:\n");
+
+    for (int i = 0; i < INSTRUCTION_COUNT; i++)
+    {
+        if (stats->instruction_counts[i] == 0) continue;
+
+        printf("  %-12s %12llu (%5.2f%%)\n",
+                Chip8_GetInstructionName(i),
+                stats->instruction_counts[i],
+                stats->instruction_counts[i] * 100.0 / total_instructions);
+    }
+}
+
+static int CompareNames(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static double GetSeconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
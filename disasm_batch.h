@@ -0,0 +1,16 @@
+#ifndef DISASM_BATCH_H
+#define DISASM_BATCH_H
+
+typedef struct Disasm_BatchOptions
+{
+    const char *roms_dir;       // directory containing the ROMs to disassemble
+    const char *out_dir;        // write one <rom>.asm listing per ROM in this directory...
+    const char *jsonl_path;     // ...or one JSON object per line per ROM in this file
+    unsigned int jobs;          // worker threads (0 = one per core)
+    int recursive;              // use the block map instead of a linear sweep
+} Disasm_BatchOptions;
+
+// disassembles every ROM of a directory on a pool of worker threads and prints summary statistics on stdout
+int Disasm_RunBatch(const Disasm_BatchOptions *options);
+
+#endif // DISASM_BATCH_H
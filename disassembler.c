@@ -1,19 +1,99 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "chip-8.h"
+#include "disasm.h"
+#include "disasm_batch.h"
 
+#define DATA_BYTES_PER_LINE 8
+
+typedef enum CfgFormat
+{
+    CFG_NONE,
+    CFG_DOT,
+    CFG_JSON
+} CfgFormat;
+
+static void PrintUsage(void);
 static void Disassemble(Chip8 *chip8);
+static void DisassembleRecursive(Chip8 *chip8, Disasm_BlockMap *map);
+static void PrintLabel(Disasm_BlockMap *map, uint16_t addr, const char *line_end);
+static void PrintBlockInstructions(Chip8 *chip8, const Disasm_Block *block, const char *separator, const char *line_end);
+static void PrintCfgDot(Chip8 *chip8, Disasm_BlockMap *map);
+static void PrintCfgJson(Disasm_BlockMap *map);
+static const char *GetBlockExitName(Disasm_BlockExit exit);
 
 int main(int argc, char **argv)
 {
-    if (argc != 2)
+    const char *rom_path = NULL;
+    int recursive = 0;
+    CfgFormat cfg_format = CFG_NONE;
+    Disasm_BatchOptions batch_options = {0};
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--recursive") == 0)
+        {
+            recursive = 1;
+        }
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+        {
+            batch_options.roms_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--out-dir") == 0 && i + 1 < argc)
+        {
+            batch_options.out_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--jsonl") == 0 && i + 1 < argc)
+        {
+            batch_options.jsonl_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+        {
+            batch_options.jobs = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--cfg") == 0 && i + 1 < argc)
+        {
+            i++;
+            cfg_format = strcmp(argv[i], "dot") == 0 ? CFG_DOT : strcmp(argv[i], "json") == 0 ? CFG_JSON : CFG_NONE;
+
+            if (cfg_format == CFG_NONE)
+            {
+                rom_path = NULL;
+                break;
+            }
+        }
+        else if (!rom_path)
+        {
+            rom_path = argv[i];
+        }
+        else
+        {
+            rom_path = NULL;
+            break;
+        }
+    }
+
+    if (batch_options.roms_dir)
     {
-        printf("Usage: disassembler ROM_PATH\n");
+        if (rom_path || cfg_format != CFG_NONE || !batch_options.out_dir == !batch_options.jsonl_path)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        batch_options.recursive = recursive;
+
+        return Disasm_RunBatch(&batch_options) < 0 ? 1 : 0;
+    }
+
+    if (!rom_path)
+    {
+        PrintUsage();
         return 1;
     }
 
-    const char *rom_path = argv[1];
     Chip8 chip8;
 
     Chip8_Init(&chip8);
@@ -24,173 +104,209 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    printf("ROM loaded (program length: %d)\n", chip8.program_len);
+    if (!recursive && cfg_format == CFG_NONE)
+    {
+        printf("ROM loaded (program length: %d)\n", chip8.program_len);
 
-    Disassemble(&chip8);
+        Disassemble(&chip8);
+
+        return 0;
+    }
+
+    Disasm_BlockMap *map = malloc(sizeof(Disasm_BlockMap));
+
+    Disasm_BuildBlockMap(&chip8, map);
+
+    if (cfg_format == CFG_DOT)
+    {
+        PrintCfgDot(&chip8, map);
+    }
+    else if (cfg_format == CFG_JSON)
+    {
+        PrintCfgJson(map);
+    }
+    else
+    {
+        printf("ROM loaded (program length: %d, blocks: %d)\n", chip8.program_len, map->block_count);
+
+        DisassembleRecursive(&chip8, map);
+    }
+
+    free(map);
 
     return 0;
 }
 
+static void PrintUsage(void)
+{
+    printf("Usage: disassembler [--recursive] [--cfg dot|json] ROM_PATH\n");
+    printf("       disassembler --batch ROMS_DIR (--out-dir DIR | --jsonl PATH) [--recursive] [--jobs N]\n");
+}
+
 static void Disassemble(Chip8 *chip8)
 {
     Chip8_InstructionType instruction_type;
     uint16_t instruction;
+    char mnemonic[DISASM_MNEMONIC_MAX_LEN];
 
     while (Chip8_GetNextInstruction(chip8, &instruction_type, &instruction))
     {
-        uint8_t x_reg = (instruction & 0x0F00) >> 8;
-        uint8_t y_reg = (instruction & 0x00F0) >> 4;
-        uint8_t low_byte = instruction & 0xFF;
-        uint8_t nibble = low_byte & 0xF;
+        Disasm_FormatInstruction(instruction_type, instruction, mnemonic, sizeof(mnemonic));
+        printf("0x%x\t%s\n", chip8->pc, mnemonic);
 
-        printf("0x%x\t", chip8->pc);
-
-        switch (instruction_type)
-        {
-            case UNKNOWN_INSTRUCTION:
-                printf("NOP\n");
-                break;
-
-            case CLS:
-                printf("CLS\n");
-                break;
-
-            case RET:
-                printf("RET\n");
-                break;
-
-            case JP_ADDR:
-                printf("JP 0x%X\n", instruction);
-                break;
-
-            case CALL_ADDR:
-                printf("CALL 0x%X\n", instruction);
-                break;
+        chip8->pc += 2;
+    }
+}
 
-            case SE_VX_BYTE:
-                printf("SE V%X, 0x%X\n", x_reg, low_byte);
-                break;
+static void DisassembleRecursive(Chip8 *chip8, Disasm_BlockMap *map)
+{
+    unsigned int addr = map->program_start;
+    unsigned int block_index = 0;
 
-            case SNE_VX_BYTE:
-                printf("SNE V%X, 0x%X\n", x_reg, low_byte);
-                break;
+    while (addr < map->program_end)
+    {
+        if (block_index < map->block_count && map->blocks[block_index].start == addr)
+        {
+            const Disasm_Block *block = &map->blocks[block_index++];
 
-            case SE_VX_VY:
-                printf("SE V%X, V%X\n", x_reg, y_reg);
-                break;
+            PrintLabel(map, addr, "\n");
+            PrintBlockInstructions(chip8, block, "\t", "\n");
+            addr = block->end;
+            continue;
+        }
 
-            case LD_VX_BYTE:
-                printf("LD V%X, 0x%X\n", x_reg, low_byte);
-                break;
+        // data: everything up to the next block
+        unsigned int data_end = block_index < map->block_count ? map->blocks[block_index].start : map->program_end;
 
-            case ADD_VX_BYTE:
-                printf("ADD V%X, 0x%X\n", x_reg, low_byte);
-                break;
+        if (data_end < addr)
+        {
+            // overlapping instructions (code jumping in the middle of another instruction)
+            block_index++;
+            continue;
+        }
 
-            case LD_VX_VY:
-                printf("LD V%X, V%X\n", x_reg, y_reg);
-                break;
+        while (addr < data_end)
+        {
+            printf("0x%x\tDB", addr);
 
-            case OR:
-                printf("OR V%X, V%X\n", x_reg, y_reg);
-                break;
+            for (unsigned int i = 0; i < DATA_BYTES_PER_LINE && addr < data_end; i++, addr++)
+            {
+                printf("%s0x%02X", i == 0 ? " " : ", ", chip8->mem[addr]);
+            }
 
-            case AND:
-                printf("AND V%X, V%X\n", x_reg, y_reg);
-                break;
+            printf("\n");
+        }
+    }
+}
 
-            case XOR:
-                printf("XOR V%X, V%X\n", x_reg, y_reg);
-                break;
+static void PrintLabel(Disasm_BlockMap *map, uint16_t addr, const char *line_end)
+{
+    const char *prefix = (map->flags[addr] & DISASM_SUBROUTINE) ? "sub" : "block";
 
-            case ADD_VX_VY:
-                printf("ADD V%X, V%X\n", x_reg, y_reg);
-                break;
+    printf("%s_%03X:%s", prefix, addr, line_end);
+}
 
-            case SUB:
-                printf("SUB V%X, V%X\n", x_reg, y_reg);
-                break;
+static void PrintBlockInstructions(Chip8 *chip8, const Disasm_Block *block, const char *separator, const char *line_end)
+{
+    Chip8_InstructionType instruction_type;
+    uint16_t instruction;
+    char mnemonic[DISASM_MNEMONIC_MAX_LEN];
 
-            case SHR:
-                printf("SHR V%X {, V%X}\n", x_reg, y_reg);
-                break;
+    for (unsigned int addr = block->start; addr < block->end; addr += 2)
+    {
+        Chip8_DecodeInstruction((chip8->mem[addr] << 8) | chip8->mem[addr + 1], &instruction_type, &instruction);
+        Disasm_FormatInstruction(instruction_type, instruction, mnemonic, sizeof(mnemonic));
+        printf("0x%x%s%s%s", addr, separator, mnemonic, line_end);
+    }
+}
 
-            case SUBN:
-                printf("SUBN V%X, V%X\n", x_reg, y_reg);
-                break;
+static void PrintCfgDot(Chip8 *chip8, Disasm_BlockMap *map)
+{
+    printf("digraph cfg {\n");
+    printf("    node [shape=box, fontname=monospace];\n");
 
-            case SHL:
-                printf("SHL V%X {, V%X}\n", x_reg, y_reg);
-                break;
+    for (unsigned int i = 0; i < map->block_count; i++)
+    {
+        const Disasm_Block *block = &map->blocks[i];
 
-            case SNE_VX_VY:
-                printf("SNE V%X, V%X\n", x_reg, y_reg);
-                break;
+        printf("    b%03X [label=\"", block->start);
+        PrintLabel(map, block->start, "\\l");
+        PrintBlockInstructions(chip8, block, "  ", "\\l");
+        printf("\"];\n");
+    }
 
-            case LD_I_ADDR:
-                printf("LD I, 0x%X\n", instruction);
-                break;
+    for (unsigned int i = 0; i < map->block_count; i++)
+    {
+        const Disasm_Block *block = &map->blocks[i];
 
-            case JP_V0_ADDR:
-                printf("JP V0, 0x%X\n", instruction);
-                break;
+        for (unsigned int s = 0; s < block->successor_count; s++)
+        {
+            const char *style = block->exit == DISASM_EXIT_CALL && s == 0 ? " [style=dashed]" : "";
 
-            case RND:
-                printf("RND V%X, 0x%X\n", x_reg, low_byte);
-                break;
+            printf("    b%03X -> b%03X%s;\n", block->start, block->successors[s], style);
+        }
+    }
 
-            case DRW:
-                printf("DRW V%X, V%X, 0x%X\n", x_reg, y_reg, nibble);
-                break;
+    printf("}\n");
+}
 
-            case SKP:
-                printf("SKP V%X\n", x_reg);
-                break;
+static void PrintCfgJson(Disasm_BlockMap *map)
+{
+    printf("{\n  \"blocks\": [");
 
-            case SKNP:
-                printf("SKNP V%X\n", x_reg);
-                break;
+    for (unsigned int i = 0; i < map->block_count; i++)
+    {
+        const Disasm_Block *block = &map->blocks[i];
 
-            case LD_VX_DT:
-                printf("LD V%X, DT\n", x_reg);
-                break;
+        printf("%s\n    {\"start\": %d, \"end\": %d, \"exit\": \"%s\", \"subroutine\": %s, \"successors\": [",
+                i == 0 ? "" : ",",
+                block->start,
+                block->end,
+                GetBlockExitName(block->exit),
+                (map->flags[block->start] & DISASM_SUBROUTINE) ? "true" : "false");
 
-            case LD_VX_K:
-                printf("LD V%X, K\n", x_reg);
-                break;
+        for (unsigned int s = 0; s < block->successor_count; s++)
+        {
+            printf("%s%d", s == 0 ? "" : ", ", block->successors[s]);
+        }
 
-            case LD_DT_VX:
-                printf("LD DT, V%X\n", x_reg);
-                break;
+        printf("]}");
+    }
 
-            case LD_ST_VX:
-                printf("LD ST, V%X\n", x_reg);
-                break;
+    printf("\n  ],\n  \"data\": [");
 
-            case ADD_I_VX:
-                printf("ADD I, V%X\n", x_reg);
-                break;
+    const char *sep = "";
 
-            case LD_F_VX:
-                printf("LD F, V%X\n", x_reg);
-                break;
+    for (unsigned int addr = map->program_start; addr < map->program_end;)
+    {
+        if (map->flags[addr] & DISASM_CODE)
+        {
+            addr++;
+            continue;
+        }
 
-            case LD_B_VX:
-                printf("LD B, V%X\n", x_reg);
-                break;
+        unsigned int start = addr;
 
-            case LD_I_VX:
-                printf("LD [I], V%X\n", x_reg);
-                break;
+        while (addr < map->program_end && !(map->flags[addr] & DISASM_CODE)) addr++;
 
-            case LD_VX_I:
-                printf("LD V%X, [I]\n", x_reg);
-                break;
+        printf("%s\n    {\"start\": %d, \"end\": %d}", sep, start, addr);
+        sep = ",";
+    }
 
-            default:
-                abort();
-        }
+    printf("\n  ]\n}\n");
+}
 
-        chip8->pc += 2;
-    }
+static const char *GetBlockExitName(Disasm_BlockExit exit)
+{
+    static const char *names[] = {
+        [DISASM_EXIT_FALLTHROUGH] = "fallthrough",
+        [DISASM_EXIT_JUMP] = "jump",
+        [DISASM_EXIT_CALL] = "call",
+        [DISASM_EXIT_SKIP] = "skip",
+        [DISASM_EXIT_RETURN] = "return",
+        [DISASM_EXIT_INDIRECT] = "indirect",
+        [DISASM_EXIT_END] = "end"
+    };
+
+    return names[exit];
 }
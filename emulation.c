@@ -0,0 +1,222 @@
+#include <string.h>
+#include <time.h>
+
+#include "emulation.h"
+
+static void RunSlice(Emulation *emulation);
+static int RunUntil(Emulation *emulation, unsigned long target, unsigned long *ran);
+static void PublishFrame(Emulation *emulation);
+#ifndef __EMSCRIPTEN__
+static void *RunThread(void *data);
+#endif
+
+int Emulation_Start(Emulation *emulation, const Chip8 *chip8)
+{
+    memset(emulation, 0, sizeof(Emulation));
+    memcpy(&emulation->chip8, chip8, sizeof(Chip8));
+    Chip8_SetGetKeysCallback(&emulation->chip8, NULL, NULL);
+    Chip8_SetKeys(&emulation->chip8, 0);
+
+    emulation->frequency = chip8->frequency;
+    emulation->back = 0;
+    emulation->shared = 1;
+    emulation->front = 2;
+    emulation->last_time = Emulation_GetTime();
+
+    PublishFrame(emulation);
+
+#ifndef __EMSCRIPTEN__
+    if (pthread_create(&emulation->thread, NULL, RunThread, emulation) != 0)
+    {
+        return -1;
+    }
+#endif
+
+    return 0;
+}
+
+void Emulation_Stop(Emulation *emulation)
+{
+#ifndef __EMSCRIPTEN__
+    emulation->quit = 1;
+    pthread_join(emulation->thread, NULL);
+#else
+    (void)emulation;
+#endif
+}
+
+// runs the instructions due since the last call when built without threads, does nothing otherwise
+void Emulation_Update(Emulation *emulation)
+{
+#ifdef __EMSCRIPTEN__
+    RunSlice(emulation);
+#else
+    (void)emulation;
+#endif
+}
+
+// queues a key change, events must be pushed in time order; returns -1 when the queue is full
+int Emulation_PushKeys(Emulation *emulation, double time, uint16_t new_keys)
+{
+    unsigned int head = atomic_load_explicit(&emulation->input_head, memory_order_relaxed);
+
+    if (head - atomic_load_explicit(&emulation->input_tail, memory_order_acquire) == EMULATION_INPUT_QUEUE_LEN)
+    {
+        return -1;
+    }
+
+    emulation->inputs[head % EMULATION_INPUT_QUEUE_LEN] = (Emulation_InputEvent){time, new_keys};
+    atomic_store_explicit(&emulation->input_head, head + 1, memory_order_release);
+
+    return 0;
+}
+
+void Emulation_Reset(Emulation *emulation)
+{
+    emulation->reset = 1;
+}
+
+// returns the latest frame published, which stays valid until the next call
+const Emulation_Frame *Emulation_GetFrame(Emulation *emulation)
+{
+    if (atomic_load(&emulation->shared) & EMULATION_FRESH)
+    {
+        emulation->front = atomic_exchange(&emulation->shared, emulation->front) & ~EMULATION_FRESH;
+    }
+
+    return &emulation->frames[emulation->front];
+}
+
+static void RunSlice(Emulation *emulation)
+{
+    Chip8 *chip8 = &emulation->chip8;
+    double now = Emulation_GetTime();
+
+    if (atomic_exchange(&emulation->reset, 0))
+    {
+        Chip8_Reset(chip8);
+    }
+
+    emulation->time_acc += now - emulation->last_time;
+    emulation->last_time = now;
+
+    if (emulation->time_acc > EMULATION_MAX_CATCH_UP_SECS)
+    {
+        emulation->time_acc = EMULATION_MAX_CATCH_UP_SECS;
+    }
+
+    // the instruction about to run matches this point in time, the due ones cover the time until now
+    double start = now - emulation->time_acc;
+    unsigned long due = emulation->time_acc / chip8->tick_secs;
+    unsigned long ran = 0;
+    int stopped = 0;
+
+    for (;;)
+    {
+        unsigned int tail = atomic_load_explicit(&emulation->input_tail, memory_order_relaxed);
+
+        if (tail == atomic_load_explicit(&emulation->input_head, memory_order_acquire)) break;
+
+        const Emulation_InputEvent *event = &emulation->inputs[tail % EMULATION_INPUT_QUEUE_LEN];
+
+        // events after the end of the slice wait for the next one
+        if (event->time >= now) break;
+
+        // events timestamped before the current instruction (late or out of order) apply right away
+        double offset = (event->time - start) / chip8->tick_secs;
+        unsigned long target = offset > 0 ? (unsigned long)offset : 0;
+
+        if (target > due) target = due;
+
+        // a stopped instance still takes the keys, so the queue never fills up
+        if (!stopped && RunUntil(emulation, target, &ran) < 0)
+        {
+            stopped = 1;
+        }
+
+        Chip8_SetKeys(&emulation->chip8, event->keys);
+        atomic_store_explicit(&emulation->input_tail, tail + 1, memory_order_release);
+    }
+
+    if (!stopped)
+    {
+        stopped = RunUntil(emulation, due, &ran) < 0;
+    }
+
+    // a faulted instance stays where it is, without accumulating time
+    emulation->time_acc = stopped ? 0 : emulation->time_acc - ran * chip8->tick_secs;
+
+    PublishFrame(emulation);
+}
+
+// runs the instructions of the slice up to target, returns -1 if the instance stopped before
+static int RunUntil(Emulation *emulation, unsigned long target, unsigned long *ran)
+{
+    if (target <= *ran)
+    {
+        return 0;
+    }
+
+    unsigned long count = Chip8_Run(&emulation->chip8, target - *ran);
+
+    *ran += count;
+    emulation->cycles += count;
+
+    return *ran < target ? -1 : 0;
+}
+
+static void PublishFrame(Emulation *emulation)
+{
+    Emulation_Frame *frame = &emulation->frames[emulation->back];
+    const Chip8 *chip8 = &emulation->chip8;
+
+    memcpy(frame->display, chip8->display, DISPLAY_SIZE);
+    frame->st = chip8->st;
+    frame->pc = chip8->pc;
+    frame->faults = chip8->faults;
+    frame->cycles = emulation->cycles;
+
+    emulation->back = atomic_exchange(&emulation->shared, emulation->back | EMULATION_FRESH) & ~EMULATION_FRESH;
+}
+
+// clock of the input events
+double Emulation_GetTime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#ifndef __EMSCRIPTEN__
+
+static void *RunThread(void *data)
+{
+    Emulation *emulation = data;
+    double next = Emulation_GetTime();
+
+    while (!emulation->quit)
+    {
+        RunSlice(emulation);
+
+        // sleeps until the next slice on a fixed schedule, so the cadence does not drift with the slice length
+        next += 1.0 / EMULATION_SLICE_HZ;
+
+        double delay = next - Emulation_GetTime();
+
+        if (delay <= 0)
+        {
+            next -= delay;
+            continue;
+        }
+
+        struct timespec ts = {.tv_sec = 0, .tv_nsec = delay * 1e9};
+
+        nanosleep(&ts, NULL);
+    }
+
+    return NULL;
+}
+
+#endif // __EMSCRIPTEN__
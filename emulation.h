@@ -0,0 +1,75 @@
+#ifndef EMULATION_H
+#define EMULATION_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#ifndef __EMSCRIPTEN__
+#include <pthread.h>
+#endif
+
+#include "chip-8.h"
+
+#define EMULATION_SLICE_HZ 240              // emulation wakes up this many times per second
+#define EMULATION_MAX_CATCH_UP_SECS 0.1     // emulated time dropped rather than run in a burst after a stall
+#define EMULATION_FRESH 4                   // flag of the shared triple buffer index, set when it holds a new frame
+#define EMULATION_INPUT_QUEUE_LEN 64        // key changes pending, a power of 2
+#define EMULATION_TAP_SECS (1.0 / 60)       // how long a key pressed and released between two samples is held
+
+// keys held from a point in time on (Emulation_GetTime clock)
+typedef struct Emulation_InputEvent
+{
+    double time;
+    uint16_t keys;
+} Emulation_InputEvent;
+
+// what the render side needs from the instance, published after each slice
+typedef struct Emulation_Frame
+{
+    uint8_t display[DISPLAY_SIZE];
+    uint8_t st;
+    uint16_t pc;
+    unsigned int faults;
+    uint64_t cycles;                        // instructions run since the start
+} Emulation_Frame;
+
+/*
+ * Runs an instance at its frequency on a dedicated thread (or on each Emulation_Update call when built without
+ * threads, e.g. with emscripten), in small slices at a steady cadence so rendering never paces the emulation.
+ * Frames go to the render side through a lock-free triple buffer: the emulation writes the back buffer and swaps
+ * it with the shared one, the render side swaps the shared one with its front buffer when it holds a new frame.
+ *
+ * Key changes go the other way through a single producer, single consumer queue of timestamped events: each
+ * event is applied at the instruction matching its time in the emulated timeline rather than at the start of
+ * the next slice, so the input latency does not depend on when the slice runs.
+ */
+typedef struct Emulation
+{
+    Chip8 chip8;                            // owned by the emulation thread once started
+    double frequency;
+    Emulation_Frame frames[3];
+    _Atomic unsigned int shared;            // index of the shared buffer, with EMULATION_FRESH
+    unsigned int back;                      // written by the emulation
+    unsigned int front;                     // read by the render side
+    double last_time;
+    double time_acc;
+    uint64_t cycles;
+    Emulation_InputEvent inputs[EMULATION_INPUT_QUEUE_LEN];
+    _Atomic unsigned int input_head;        // next event pushed, written by the render side
+    _Atomic unsigned int input_tail;        // next event applied, written by the emulation
+    _Atomic int reset;
+    _Atomic int quit;
+#ifndef __EMSCRIPTEN__
+    pthread_t thread;
+#endif
+} Emulation;
+
+int Emulation_Start(Emulation *emulation, const Chip8 *chip8);
+void Emulation_Stop(Emulation *emulation);
+void Emulation_Update(Emulation *emulation);
+int Emulation_PushKeys(Emulation *emulation, double time, uint16_t keys);
+double Emulation_GetTime(void);
+void Emulation_Reset(Emulation *emulation);
+const Emulation_Frame *Emulation_GetFrame(Emulation *emulation);
+
+#endif // EMULATION_H
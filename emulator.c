@@ -1,19 +1,25 @@
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __EMSCRIPTEN__
+#include <emscripten/emscripten.h>
+#endif
+
 #include "raylib.h"
 #include "chip-8.h"
 #include "rom_picker.h"
+#include "preloader.h"
+#include "rom_db.h"
+#include "thumbnailer.h"
+#include "render.h"
+#include "emulation.h"
 
-#define GAME_WIDTH 640
-#define GAME_HEIGHT 320
-#define HUD_TOP_HEIGHT 25
-#define HUD_BOTTOM_HEIGHT 25
-#define SCREEN_WIDTH GAME_WIDTH
-#define SCREEN_HEIGHT (GAME_HEIGHT + HUD_TOP_HEIGHT + HUD_BOTTOM_HEIGHT)
 #define ROM_PICKER_FONT_SIZE 20
-#define HUD_FONT_SIZE 15
+#define ROM_DB_OVERRIDE_ENV "CHIP8_ROM_DB"
+#define ROM_PICKER_ROWS (GAME_HEIGHT / ROM_PICKER_FONT_SIZE)
+#define THUMBNAIL_TEXTURE_COUNT (ROM_PICKER_ROWS * 4)
 
 typedef enum EmulatorStateType
 {
@@ -31,29 +37,43 @@ typedef struct EmulatorState
 
 typedef struct GameStateData
 {
-    Chip8 chip8;
-    void *pixels;
-    RenderTexture2D display_render_texture;
-    double last_time;
-    double time_acc;
+    Chip8 chip8;                        // the loaded ROM, copied to the emulation thread
+    Emulation emulation;
+    bool running;
+    const Emulation_Frame *frame;       // latest frame drawn
+    Render_Display display;
 } GameStateData;
 
+typedef struct ThumbnailTexture
+{
+    uint64_t hash;
+    Texture2D texture;
+    unsigned long last_used;
+} ThumbnailTexture;
+
 typedef struct RomSelectionData
 {
     RomPicker picker;
+    ThumbnailTexture thumbnails[THUMBNAIL_TEXTURE_COUNT];
+    unsigned int thumbnail_count;
+    unsigned long frame;
 } RomSelectionData;
 
-typedef struct EmulatorSkin
-{
-    Color colors[4];
-} EmulatorSkin;
-
+static void UpdateFrame(void);
+#ifndef __EMSCRIPTEN__
+static void Shutdown(void);
+#endif
 static int ChangeState(EmulatorStateType new_state_type, void *data);
-static void DrawGameScreen(RenderTexture2D display_render_texture);
 static void DrawHUD(void);
-static void UpdateScreen(Chip8 *chip8, RenderTexture2D display_render_texture, void *pixels);
 static void UpdateKeys(void);
-static uint16_t GetKeys(void);
+static int InitRomDb(void);
+static void ApplyRomSettings(Chip8 *chip8);
+static void RequestPreloads(RomPicker *picker);
+static void UpdateThumbnails(RomPicker *picker);
+static ThumbnailTexture *FindThumbnail(uint64_t hash);
+static void UploadThumbnail(const Thumbnail *thumbnail);
+static void UnloadThumbnails(void);
+static void UnloadDisplay(void);
 static int InitGameState(void *data);
 static void DeinitGameState(void);
 static void UpdateGameState(void);
@@ -66,20 +86,13 @@ static EmulatorState states[2] = {
     (EmulatorState){STATE_GAME, InitGameState, DeinitGameState, UpdateGameState},
 };
 
-static EmulatorSkin skin = {
-    .colors = {
-        (Color){64, 60, 52, 255},
-        (Color){140, 122, 105, 255},
-        (Color){217, 199, 184, 255},
-        (Color){13, 0, 0, 255}
-    }
-};
-
 static RomSelectionData rom_selection_data;
 static GameStateData game_state_data;
+static Preloader preloader;
+static Thumbnailer thumbnailer;
 
 // key mappings from 0 to 0xF (16 keys)
-static int key_mappings[16] = {
+static const int default_key_mappings[16] = {
     KEY_X,      // 0
     KEY_ONE,    // 1
     KEY_TWO,    // 2
@@ -98,7 +111,12 @@ static int key_mappings[16] = {
     KEY_V       // F
 };
 
-static uint16_t keys = 0;
+// default_key_mappings, unless the ROM database has a key map for the running ROM
+static int key_mappings[16];
+static RomDb rom_db;
+static uint16_t keys = 0;                   // keys last pushed to the emulation
+static uint16_t tapped_keys = 0;            // taps held until tap_release_time
+static double tap_release_time = 0;
 static EmulatorState *current_state = NULL;
 static bool rom_picker_enabled = false;
 
@@ -106,9 +124,22 @@ int main(int argc, char **argv)
 {
     InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Chip-8 Emulator");
 
+    if (InitRomDb() < 0)
+    {
+        goto error;
+    }
+
     if (argc == 1)
     {
-        RomPicker_Init(&rom_selection_data.picker, ROMS_DIR_PATH);
+        if (RomPicker_Init(&rom_selection_data.picker, ROMS_DIR_PATH, ROM_PICKER_ROWS) < 0)
+        {
+            goto error;
+        }
+
+        if (Preloader_Init(&preloader) < 0 || Thumbnailer_Init(&thumbnailer, ROMS_DIR_PATH, &rom_db) < 0)
+        {
+            goto error;
+        }
 
         rom_picker_enabled = true;
 
@@ -130,13 +161,18 @@ int main(int argc, char **argv)
         goto error;
     }
 
+#ifdef __EMSCRIPTEN__
+    // the browser calls back once per animation frame, main never returns and the page owns the resources
+    emscripten_set_main_loop(UpdateFrame, 0, 1);
+#else
     while (!WindowShouldClose())
     {
-        current_state->update();
+        UpdateFrame();
     }
 
-    current_state->deinit();
-    CloseWindow();
+    Shutdown();
+#endif
+
     return 0;
 
 error:
@@ -145,6 +181,32 @@ error:
     return 1; 
 }
 
+static void UpdateFrame(void)
+{
+    current_state->update();
+}
+
+#ifndef __EMSCRIPTEN__
+
+static void Shutdown(void)
+{
+    current_state->deinit();
+
+    if (rom_picker_enabled)
+    {
+        Preloader_Deinit(&preloader);
+        Thumbnailer_Deinit(&thumbnailer);
+        UnloadThumbnails();
+        RomPicker_Deinit(&rom_selection_data.picker);
+    }
+
+    UnloadDisplay();
+    RomDb_Deinit(&rom_db);
+    CloseWindow();
+}
+
+#endif // __EMSCRIPTEN__
+
 static int ChangeState(EmulatorStateType new_state_type, void *data)
 {
     if (current_state) current_state->deinit();
@@ -157,32 +219,55 @@ static int InitGameState(void *data)
 {
     char *rom_path = data;
 
-    memset(&game_state_data, 0, sizeof(GameStateData));
-    game_state_data.last_time = GetTime();
+    // the picker has most likely already loaded the selected ROM in the background
+    if (!rom_picker_enabled || Preloader_Take(&preloader, rom_path, &game_state_data.chip8) < 0)
+    {
+        Chip8_Init(&game_state_data.chip8);
+
+        if (Chip8_LoadFromFile(&game_state_data.chip8, rom_path) < 0)
+        {
+            fprintf(stderr, "ERROR: Failed to load ROM (path: %s)\n", rom_path);
+            return -1;
+        }
+    }
+
+    ApplyRomSettings(&game_state_data.chip8);
 
-    Chip8_Init(&game_state_data.chip8);
-    Chip8_SetGetKeysCallback(&game_state_data.chip8, GetKeys);
+    printf("ROM loaded (program length: %d, hash: %016llx)\n",
+            game_state_data.chip8.program_len, (unsigned long long)game_state_data.chip8.program_hash);
 
-    if (Chip8_LoadFromFile(&game_state_data.chip8, rom_path) < 0)
+    // the display buffers are created once and reused by every game
+    if (!game_state_data.display.pixels && Render_LoadDisplay(&game_state_data.display) < 0)
     {
-        fprintf(stderr, "ERROR: Failed to load ROM (path: %s)\n", rom_path);
         return -1;
     }
 
-    printf("ROM loaded (program length: %d)\n", game_state_data.chip8.program_len);
-
-    game_state_data.pixels = malloc(sizeof(Color) * DISPLAY_WIDTH * DISPLAY_HEIGHT);
-    memset(game_state_data.pixels, 0, sizeof(Color) * DISPLAY_WIDTH * DISPLAY_HEIGHT);
+    if (Emulation_Start(&game_state_data.emulation, &game_state_data.chip8) < 0)
+    {
+        fprintf(stderr, "ERROR: Failed to start the emulation thread\n");
+        return -1;
+    }
 
-    game_state_data.display_render_texture = LoadRenderTexture(DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    game_state_data.running = true;
+    keys = 0;
+    tapped_keys = 0;
+    game_state_data.frame = Emulation_GetFrame(&game_state_data.emulation);
 
     return 0;
 }
 
 static void DeinitGameState(void)
 {
-    UnloadRenderTexture(game_state_data.display_render_texture);
-    free(game_state_data.pixels);
+    if (game_state_data.running)
+    {
+        Emulation_Stop(&game_state_data.emulation);
+        game_state_data.running = false;
+    }
+}
+
+static void UnloadDisplay(void)
+{
+    Render_UnloadDisplay(&game_state_data.display);
 }
 
 static void UpdateGameState(void)
@@ -196,34 +281,24 @@ static void UpdateGameState(void)
     if (IsKeyPressed(KEY_ENTER))
     {
         // reset the ROM
-        Chip8_Reset(&game_state_data.chip8);
+        Emulation_Reset(&game_state_data.emulation);
     }
 
-    double dt_secs = GetTime() - game_state_data.last_time;
-    game_state_data.last_time = GetTime();
-    game_state_data.time_acc += dt_secs;
-
-    while (game_state_data.time_acc >= CPU_TICK_SECS)
-    {
-        if (!Chip8_Tick(&game_state_data.chip8))
-        {
-            break;
-        }
-
-        game_state_data.time_acc -= CPU_TICK_SECS;
-    }
+    // the emulation runs on its own thread, this only passes the key changes and draws its latest frame
+    UpdateKeys();
+    Emulation_Update(&game_state_data.emulation);
+    game_state_data.frame = Emulation_GetFrame(&game_state_data.emulation);
 
-    if (game_state_data.chip8.st)
+    if (game_state_data.frame->st)
     {
         // TODO: play sound
     }
 
-    UpdateScreen(&game_state_data.chip8, game_state_data.display_render_texture, game_state_data.pixels); 
-    UpdateKeys();
+    Render_UpdateDisplay(&game_state_data.display, game_state_data.frame->display);
 
     BeginDrawing();
-    ClearBackground(skin.colors[2]);
-    DrawGameScreen(game_state_data.display_render_texture); 
+    ClearBackground(render_skin.colors[2]);
+    Render_DrawDisplay(&game_state_data.display);
     DrawHUD();
     EndDrawing();
 }
@@ -239,114 +314,363 @@ static void DeinitRomSelectionState(void) {}
 
 static void UpdateRomSelectionState(void)
 {
+    RomPicker *picker = &rom_selection_data.picker;
+
+    // scans the ROMs directory and refreshes the metadata cache a bit every frame
+    RomPicker_Update(picker);
+
     if (IsKeyPressed(KEY_DOWN))
     {
-        RomPicker_Down(&rom_selection_data.picker);
+        RomPicker_Down(picker);
     }
 
     if (IsKeyPressed(KEY_UP))
     {
-        RomPicker_Up(&rom_selection_data.picker);
+        RomPicker_Up(picker);
     }
 
+    if (IsKeyPressed(KEY_PAGE_DOWN))
+    {
+        RomPicker_PageDown(picker);
+    }
+
+    if (IsKeyPressed(KEY_PAGE_UP))
+    {
+        RomPicker_PageUp(picker);
+    }
+
+    if (IsKeyPressed(KEY_BACKSPACE))
+    {
+        RomPicker_FilterErase(picker);
+    }
+
+    // type to filter (space is kept for selecting a ROM)
+    for (int c = GetCharPressed(); c > 0; c = GetCharPressed())
+    {
+        if (c > ' ' && c < 127)
+        {
+            RomPicker_FilterAppend(picker, c);
+        }
+    }
+
+    RequestPreloads(picker);
+    Preloader_Update(&preloader);
+    UpdateThumbnails(picker);
+
     if (IsKeyPressed(KEY_SPACE) || IsKeyPressed(KEY_ENTER))
     {
         char rom_path[ROM_PATH_MAX_LEN];
 
-        RomPicker_GetSelectedPath(&rom_selection_data.picker, rom_path);
-        ChangeState(STATE_GAME, rom_path);
+        if (RomPicker_GetSelectedPath(picker, rom_path) == 0)
+        {
+            RomPicker_MarkPlayed(picker);
+            ChangeState(STATE_GAME, rom_path);
+            return;
+        }
     }
 
     BeginDrawing();
-    ClearBackground(skin.colors[2]);
+    ClearBackground(render_skin.colors[2]);
 
     // draw cursor
 
-    int y = HUD_TOP_HEIGHT + (rom_selection_data.picker.cursor * ROM_PICKER_FONT_SIZE);
+    if (picker->visible_count > 0)
+    {
+        int y = HUD_TOP_HEIGHT + ((picker->cursor - picker->scroll) * ROM_PICKER_FONT_SIZE);
 
-    DrawRectangle(0, y, SCREEN_WIDTH, ROM_PICKER_FONT_SIZE, skin.colors[0]);
+        DrawRectangle(0, y, SCREEN_WIDTH, ROM_PICKER_FONT_SIZE, render_skin.colors[0]);
+    }
 
-    // draw rom list
+    // draw the part of the rom list inside the viewport
 
-    for (unsigned int i = 0; i < rom_selection_data.picker.rom_count; i++)
+    for (unsigned int row = 0; row < ROM_PICKER_ROWS; row++)
     {
-        char *rom = rom_selection_data.picker.roms[i];
-        int rom_text_width = MeasureText(rom, ROM_PICKER_FONT_SIZE);
-        Color color = i == rom_selection_data.picker.cursor ? skin.colors[2] : skin.colors[0];
+        unsigned int i = picker->scroll + row;
+        const RomPicker_Entry *entry = RomPicker_GetVisibleEntry(picker, i);
+
+        if (!entry) break;
+
+        int rom_text_width = MeasureText(entry->name, ROM_PICKER_FONT_SIZE);
+        int y = HUD_TOP_HEIGHT + ROM_PICKER_FONT_SIZE * row;
+        Color color = i == picker->cursor ? render_skin.colors[2] : render_skin.colors[0];
+
+        DrawText(entry->name, SCREEN_WIDTH / 2 - rom_text_width / 2, y, ROM_PICKER_FONT_SIZE, color);
+
+        ThumbnailTexture *thumbnail = FindThumbnail(entry->hash);
+
+        if (thumbnail)
+        {
+            DrawTexturePro(
+                    thumbnail->texture,
+                    (Rectangle){0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT},
+                    (Rectangle){5, y, ROM_PICKER_FONT_SIZE * 2, ROM_PICKER_FONT_SIZE},
+                    (Vector2){0, 0},
+                    0,
+                    WHITE);
+        }
+
+        if (entry->size)
+        {
+            const char *size_text = TextFormat("%u B", entry->size);
 
-        DrawText(rom, SCREEN_WIDTH / 2 - rom_text_width / 2, HUD_TOP_HEIGHT + ROM_PICKER_FONT_SIZE * i, ROM_PICKER_FONT_SIZE, color);
+            DrawText(size_text, SCREEN_WIDTH - (MeasureText(size_text, HUD_FONT_SIZE) + 5), y + 3, HUD_FONT_SIZE, color);
+        }
     }
 
     DrawHUD();
     EndDrawing();
 }
 
-static void DrawGameScreen(RenderTexture2D display_render_texture)
-{
-    DrawTexturePro(
-            display_render_texture.texture,
-            (Rectangle){0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT},
-            (Rectangle){0, HUD_TOP_HEIGHT, GAME_WIDTH, GAME_HEIGHT},
-            (Vector2){0, 0},
-            0,
-            WHITE);
-}
-
 static void DrawHUD(void)
 {
     const char *text;
 
     if (current_state->type == STATE_ROM_SELECTION)
     {
-        text = "Select ROM (Up/Down + ENTER)";
+        RomPicker *picker = &rom_selection_data.picker;
+
+        if (picker->filter[0])
+        {
+            text = TextFormat("Filter: %s (%u/%u)", picker->filter, picker->visible_count, picker->rom_count);
+        }
+        else if (RomPicker_IsScanning(picker))
+        {
+            text = TextFormat("Scanning ROMs... (%u)", picker->rom_count);
+        }
+        else
+        {
+            text = "Select ROM (Up/Down + ENTER, type to filter)";
+        }
     }
     else if (current_state->type == STATE_GAME)
     {
+        const Emulation_Frame *frame = game_state_data.frame;
+
         text = RomPicker_GetSelectedRomName(&rom_selection_data.picker);
+
+        if (frame->faults)
+        {
+            text = TextFormat("%s (%s at 0x%03X)", text, Chip8_GetFaultName(frame->faults), frame->pc);
+        }
     }
 
-    int text_w = MeasureText(text, HUD_FONT_SIZE);
+    double frequency = current_state->type == STATE_GAME ? game_state_data.emulation.frequency : CPU_FREQUENCY;
+    const char *back_text = current_state->type == STATE_GAME ? "Backspace to return to ROM selection" : NULL;
 
-    DrawRectangle(0, 0, SCREEN_WIDTH, HUD_TOP_HEIGHT, skin.colors[1]);
-    DrawRectangle(0, SCREEN_HEIGHT - HUD_BOTTOM_HEIGHT, SCREEN_WIDTH, HUD_BOTTOM_HEIGHT, skin.colors[1]);
-    DrawText(text, SCREEN_WIDTH / 2 - text_w / 2, 5, HUD_FONT_SIZE, skin.colors[2]);
-    DrawText(TextFormat("Frequency: %.1f", CPU_FREQUENCY), 10, SCREEN_HEIGHT - 18, HUD_FONT_SIZE, skin.colors[2]);
+    Render_DrawHUD(text, TextFormat("Frequency: %.1f", frequency), back_text);
+}
+
+static void RequestPreloads(RomPicker *picker)
+{
+    static char paths[PRELOADER_SLOT_COUNT][ROM_PATH_MAX_LEN];
+    const char *requested[PRELOADER_SLOT_COUNT];
+    unsigned int count = 0;
 
-    if (current_state->type == STATE_GAME)
+    // the selected ROM first, then the ones right above and below it
+    int offsets[PRELOADER_SLOT_COUNT] = {0, 1, -1};
+
+    for (int i = 0; i < PRELOADER_SLOT_COUNT; i++)
     {
-        const char *back_text = "Backspace to return to ROM selection";
-        int back_text_w = MeasureText(back_text, HUD_FONT_SIZE);
+        unsigned int index = picker->cursor + offsets[i];
 
-        DrawText(back_text, SCREEN_WIDTH - (back_text_w + 5), SCREEN_HEIGHT - 18, HUD_FONT_SIZE, skin.colors[2]);
+        if (RomPicker_GetVisiblePath(picker, index, paths[count]) == 0)
+        {
+            requested[count] = paths[count];
+            count++;
+        }
     }
+
+    Preloader_Request(&preloader, requested, count);
 }
 
-static void UpdateScreen(Chip8 *chip8, RenderTexture2D display_render_texture, void *pixels)
+static void UpdateThumbnails(RomPicker *picker)
 {
+    Thumbnailer_Job jobs[ROM_PICKER_ROWS];
+    unsigned int count = 0;
+
+    rom_selection_data.frame++;
+
+    // only the ROMs in the viewport (with a known hash) are worth generating a thumbnail for
+    for (unsigned int row = 0; row < ROM_PICKER_ROWS; row++)
+    {
+        const RomPicker_Entry *entry = RomPicker_GetVisibleEntry(picker, picker->scroll + row);
+
+        if (!entry) break;
+
+        if (entry->hash && !FindThumbnail(entry->hash) &&
+                RomPicker_GetVisiblePath(picker, picker->scroll + row, jobs[count].path) == 0)
+        {
+            jobs[count++].hash = entry->hash;
+        }
+    }
+
+    Thumbnailer_Request(&thumbnailer, jobs, count);
+    Thumbnailer_Update(&thumbnailer);
+
+    // a single texture upload per frame
+    Thumbnail thumbnail;
+
+    if (Thumbnailer_Poll(&thumbnailer, &thumbnail) == 0)
+    {
+        UploadThumbnail(&thumbnail);
+    }
+}
+
+static ThumbnailTexture *FindThumbnail(uint64_t hash)
+{
+    for (unsigned int i = 0; i < rom_selection_data.thumbnail_count; i++)
+    {
+        ThumbnailTexture *thumbnail = &rom_selection_data.thumbnails[i];
+
+        if (thumbnail->hash == hash)
+        {
+            thumbnail->last_used = rom_selection_data.frame;
+            return thumbnail;
+        }
+    }
+
+    return NULL;
+}
+
+static void UploadThumbnail(const Thumbnail *thumbnail)
+{
+    static Color pixels[DISPLAY_WIDTH * DISPLAY_HEIGHT];
+    ThumbnailTexture *texture = FindThumbnail(thumbnail->hash);
+
+    if (texture) return;
+
+    if (rom_selection_data.thumbnail_count < THUMBNAIL_TEXTURE_COUNT)
+    {
+        texture = &rom_selection_data.thumbnails[rom_selection_data.thumbnail_count++];
+    }
+    else
+    {
+        // replace the least recently drawn thumbnail
+        texture = &rom_selection_data.thumbnails[0];
+
+        for (unsigned int i = 1; i < THUMBNAIL_TEXTURE_COUNT; i++)
+        {
+            if (rom_selection_data.thumbnails[i].last_used < texture->last_used)
+            {
+                texture = &rom_selection_data.thumbnails[i];
+            }
+        }
+
+        UnloadTexture(texture->texture);
+    }
+
     for (int i = 0; i < DISPLAY_WIDTH * DISPLAY_HEIGHT; i++)
     {
-        Color color = Chip8_GetPixel(chip8, i) ? skin.colors[3] : skin.colors[2];
+        pixels[i] = Thumbnail_GetPixel(thumbnail, i) ? render_skin.colors[3] : render_skin.colors[2];
+    }
+
+    Image image = {
+        .data = pixels,
+        .width = DISPLAY_WIDTH,
+        .height = DISPLAY_HEIGHT,
+        .mipmaps = 1,
+        .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8
+    };
+
+    texture->hash = thumbnail->hash;
+    texture->texture = LoadTextureFromImage(image);
+    texture->last_used = rom_selection_data.frame;
+}
+
+static void UnloadThumbnails(void)
+{
+    for (unsigned int i = 0; i < rom_selection_data.thumbnail_count; i++)
+    {
+        UnloadTexture(rom_selection_data.thumbnails[i].texture);
+    }
+
+    rom_selection_data.thumbnail_count = 0;
+}
+
+static int InitRomDb(void)
+{
+    const char *override_path = getenv(ROM_DB_OVERRIDE_ENV);
+    char error[ROM_DB_ERROR_MAX_LEN];
+
+    if (RomDb_Init(&rom_db) < 0)
+    {
+        return -1;
+    }
+
+    if (override_path && RomDb_LoadFile(&rom_db, override_path, error, sizeof(error)) < 0)
+    {
+        fprintf(stderr, "ERROR: Failed to load ROM database overrides (%s)\n", error);
+        return -1;
+    }
+
+    return 0;
+}
 
-        memcpy(pixels + (i * sizeof(Color)), &color, sizeof(Color));
+static void ApplyRomSettings(Chip8 *chip8)
+{
+    const RomDb_Settings *settings = RomDb_Find(&rom_db, chip8->program_hash);
+
+    memcpy(key_mappings, default_key_mappings, sizeof(key_mappings));
+
+    if (!settings) return;
+
+    RomDb_Apply(settings, chip8);
+
+    if (settings->fields & ROM_DB_KEYMAP)
+    {
+        // raylib key codes of letters and digits are their (uppercase) ASCII codes
+        for (int i = 0; i <= 0xF; i++)
+        {
+            key_mappings[i] = toupper((unsigned char)settings->keymap[i]);
+        }
     }
 
-    UpdateTexture(display_render_texture.texture, pixels);
+    printf("ROM database settings applied\n");
 }
 
+// queues the key changes since the last frame, timestamped so they apply at the matching emulated instruction;
+// events go in time order, so the release of a tap is pushed by the first frame past its time
 static void UpdateKeys(void)
 {
-    keys = 0;
+    Emulation *emulation = &game_state_data.emulation;
+    double now = Emulation_GetTime();
+    uint16_t held = 0;
+    uint16_t tapped = 0;
+    int key;
 
     for (int i = 0; i <= 0xF; i++)
     {
         if (IsKeyDown(key_mappings[i]))
         {
-            keys |= (1 << (0xF - i));
+            held |= (1 << (0xF - i));
         }
     }
-}
 
-static uint16_t GetKeys(void)
-{
-    return keys;
+    // keys pressed and released since the last frame are only seen in the key queue
+    while ((key = GetKeyPressed()) != 0)
+    {
+        for (int i = 0; i <= 0xF; i++)
+        {
+            if (key == key_mappings[i] && !(held & (1 << (0xF - i))))
+            {
+                tapped |= (1 << (0xF - i));
+            }
+        }
+    }
+
+    if (tapped_keys && now >= tap_release_time)
+    {
+        tapped_keys = 0;
+    }
+
+    if (tapped)
+    {
+        tapped_keys |= tapped;
+        tap_release_time = now + EMULATION_TAP_SECS;
+    }
+
+    if ((held | tapped_keys) != keys && Emulation_PushKeys(emulation, now, held | tapped_keys) == 0)
+    {
+        keys = held | tapped_keys;
+    }
 }
@@ -0,0 +1,350 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "explore.h"
+
+#define NO_PARENT UINT32_MAX
+#define NOT_FOUND -1
+
+// a recorded state, only what is needed to rebuild the inputs leading to it
+typedef struct Node
+{
+    uint32_t parent;
+    uint8_t input;
+} Node;
+
+typedef struct FrontierEntry
+{
+    Chip8 state;
+    uint32_t node;
+} FrontierEntry;
+
+typedef struct Explorer
+{
+    const Explore_Options *options;
+    unsigned int frame_len;                 // instructions per step
+    FrontierEntry *frontier;                // states of the current depth
+    unsigned int frontier_count;
+    FrontierEntry *next;                    // states of the next depth
+    _Atomic unsigned int next_count;
+    _Atomic unsigned int cursor;            // next frontier entry to expand
+    _Atomic uint64_t *visited;              // open addressing set of state hashes, 0 is an empty slot
+    unsigned int visited_mask;
+    Node *nodes;                            // indexed by node id, up to max_states entries
+    _Atomic unsigned int node_count;
+    _Atomic unsigned long pruned_count;
+    _Atomic int full;                       // set once max_states are recorded, no entry is expanded after it
+    _Atomic long found_parent;              // node the goal was reached from, NO_PARENT for the initial state
+    uint8_t found_input;                    // key held for the step reaching the goal
+    Chip8 found_state;
+} Explorer;
+
+static void *RunWorker(void *data);
+static void Expand(Explorer *explorer, const FrontierEntry *entry, Chip8 *chip8);
+static int RunStep(Explorer *explorer, Chip8 *chip8, int *stopped);
+static int InsertVisited(Explorer *explorer, uint64_t hash);
+static int RecordState(Explorer *explorer, uint32_t parent, uint8_t input, uint32_t *node);
+static void BuildResult(Explorer *explorer, Explore_Result *result);
+
+int Explore_Run(const Chip8 *initial, const Explore_Options *options, Explore_Result *result)
+{
+    Explorer *explorer = calloc(1, sizeof(Explorer));
+    unsigned int visited_capacity = 1;
+
+    memset(result, 0, sizeof(Explore_Result));
+
+    if (!explorer)
+    {
+        return -1;
+    }
+
+    // at most about half full, so probing stays short and always finds a free slot: workers stop inserting once
+    // max_states are recorded, but each of them may still have one insert in flight past that check
+    while (visited_capacity < options->max_states * 2 + EXPLORE_MAX_WORKERS + 1)
+    {
+        visited_capacity <<= 1;
+    }
+
+    explorer->options = options;
+    explorer->frame_len = initial->frequency / EXPLORE_FRAME_RATE + 0.5;
+    explorer->frontier = malloc(sizeof(FrontierEntry) * options->max_frontier);
+    explorer->next = malloc(sizeof(FrontierEntry) * options->max_frontier);
+    explorer->visited = calloc(visited_capacity, sizeof(uint64_t));
+    explorer->visited_mask = visited_capacity - 1;
+    explorer->nodes = malloc(sizeof(Node) * options->max_states);
+    explorer->found_parent = NOT_FOUND;
+
+    if (explorer->frame_len == 0) explorer->frame_len = 1;
+
+    int ret = -1;
+
+    if (!explorer->frontier || !explorer->next || !explorer->visited || !explorer->nodes ||
+            options->max_frontier == 0 || options->max_states == 0)
+    {
+        goto exit;
+    }
+
+    unsigned int worker_count = options->worker_count;
+
+    if (worker_count == 0) worker_count = 1;
+    if (worker_count > EXPLORE_MAX_WORKERS) worker_count = EXPLORE_MAX_WORKERS;
+
+    FrontierEntry *root = &explorer->frontier[0];
+
+    memcpy(&root->state, initial, sizeof(Chip8));
+    Chip8_SetGetKeysCallback(&root->state, NULL, NULL);
+    InsertVisited(explorer, Chip8_StateHash(&root->state));
+    RecordState(explorer, NO_PARENT, EXPLORE_NO_KEY, &root->node);
+    explorer->frontier_count = 1;
+
+    if (options->goal(&root->state, options->goal_user_data))
+    {
+        explorer->found_parent = NO_PARENT;
+        memcpy(&explorer->found_state, &root->state, sizeof(Chip8));
+    }
+
+    for (unsigned int depth = 0; depth < options->max_depth && explorer->frontier_count > 0; depth++)
+    {
+        pthread_t workers[EXPLORE_MAX_WORKERS];
+        unsigned int started = 0;
+
+        if (explorer->found_parent != NOT_FOUND || explorer->full) break;
+
+        explorer->next_count = 0;
+        explorer->cursor = 0;
+
+        for (unsigned int i = 0; i < worker_count; i++)
+        {
+            if (pthread_create(&workers[started], NULL, RunWorker, explorer) == 0) started++;
+        }
+
+        if (started == 0)
+        {
+            goto exit;
+        }
+
+        for (unsigned int i = 0; i < started; i++)
+        {
+            pthread_join(workers[i], NULL);
+        }
+
+        FrontierEntry *frontier = explorer->frontier;
+        unsigned int next_count = explorer->next_count;
+
+        explorer->frontier = explorer->next;
+        explorer->next = frontier;
+        explorer->frontier_count = next_count < options->max_frontier ? next_count : options->max_frontier;
+
+        if (!explorer->full) result->explored_depth = depth + 1;
+    }
+
+    BuildResult(explorer, result);
+    ret = 0;
+
+exit:
+    free(explorer->frontier);
+    free(explorer->next);
+    free((void *)explorer->visited);
+    free(explorer->nodes);
+    free(explorer);
+
+    return ret;
+}
+
+void Explore_FreeResult(Explore_Result *result)
+{
+    free(result->inputs);
+    result->inputs = NULL;
+}
+
+static void *RunWorker(void *data)
+{
+    Explorer *explorer = data;
+    Chip8 *chip8 = malloc(sizeof(Chip8));
+
+    if (!chip8)
+    {
+        return NULL;
+    }
+
+    for (;;)
+    {
+        unsigned int index = atomic_fetch_add(&explorer->cursor, 1);
+
+        if (index >= explorer->frontier_count || explorer->found_parent != NOT_FOUND || explorer->full) break;
+
+        Expand(explorer, &explorer->frontier[index], chip8);
+    }
+
+    free(chip8);
+
+    return NULL;
+}
+
+static void Expand(Explorer *explorer, const FrontierEntry *entry, Chip8 *chip8)
+{
+    const Explore_Options *options = explorer->options;
+
+    for (uint8_t input = 0; input < EXPLORE_INPUT_COUNT; input++)
+    {
+        uint8_t key = input == 0 ? EXPLORE_NO_KEY : input - 1;
+        uint32_t node;
+
+        // restoring a state is a single copy
+        memcpy(chip8, &entry->state, sizeof(Chip8));
+        Chip8_SetKeys(chip8, key == EXPLORE_NO_KEY ? 0 : 1 << (0xF - key));
+
+        int stopped;
+        int reached = RunStep(explorer, chip8, &stopped);
+
+        // the state reaching the goal needs no node of its own, its parent and the input rebuild the path to it
+        if (reached)
+        {
+            long expected = NOT_FOUND;
+
+            if (atomic_compare_exchange_strong(&explorer->found_parent, &expected, entry->node))
+            {
+                explorer->found_input = key;
+                memcpy(&explorer->found_state, chip8, sizeof(Chip8));
+            }
+
+            return;
+        }
+
+        // a full visited set would never find a free slot, stop recording once max_states is reached: the
+        // children of the entries in flight are still checked against the goal, then the search stops
+        if (explorer->node_count >= options->max_states)
+        {
+            explorer->full = 1;
+            atomic_fetch_add(&explorer->pruned_count, 1);
+            continue;
+        }
+
+        if (!InsertVisited(explorer, Chip8_StateHash(chip8))) continue;
+
+        if (RecordState(explorer, entry->node, key, &node) < 0)
+        {
+            explorer->full = 1;
+            atomic_fetch_add(&explorer->pruned_count, 1);
+            continue;
+        }
+
+        // states of programs that ended or faulted are not expanded
+        if (stopped) continue;
+
+        unsigned int index = atomic_fetch_add(&explorer->next_count, 1);
+
+        if (index < options->max_frontier)
+        {
+            memcpy(&explorer->next[index].state, chip8, sizeof(Chip8));
+            explorer->next[index].node = node;
+        }
+        else
+        {
+            atomic_fetch_add(&explorer->pruned_count, 1);
+        }
+    }
+}
+
+// runs the frame of a step, until the goal is reached with goal_per_instruction; returns 1 if the goal is reached
+static int RunStep(Explorer *explorer, Chip8 *chip8, int *stopped)
+{
+    const Explore_Options *options = explorer->options;
+
+    if (!options->goal_per_instruction)
+    {
+        // a step shorter than a frame means the program ended or faulted
+        *stopped = Chip8_Run(chip8, explorer->frame_len) < explorer->frame_len;
+
+        return options->goal(chip8, options->goal_user_data);
+    }
+
+    *stopped = 0;
+
+    for (unsigned int i = 0; i < explorer->frame_len; i++)
+    {
+        int running = Chip8_Tick(chip8) != 0;
+
+        if (!running) *stopped = 1;
+        if (options->goal(chip8, options->goal_user_data)) return 1;
+        if (!running) break;
+    }
+
+    return 0;
+}
+
+// returns 1 if the hash was not in the set yet
+static int InsertVisited(Explorer *explorer, uint64_t hash)
+{
+    if (hash == 0) hash = 1; // 0 marks empty slots
+
+    for (unsigned int slot = hash & explorer->visited_mask;; slot = (slot + 1) & explorer->visited_mask)
+    {
+        uint64_t expected = 0;
+
+        if (atomic_compare_exchange_strong(&explorer->visited[slot], &expected, hash)) return 1;
+        if (expected == hash) return 0;
+    }
+}
+
+static int RecordState(Explorer *explorer, uint32_t parent, uint8_t input, uint32_t *node)
+{
+    unsigned int index = atomic_fetch_add(&explorer->node_count, 1);
+
+    if (index >= explorer->options->max_states)
+    {
+        return -1;
+    }
+
+    explorer->nodes[index] = (Node){parent, input};
+    *node = index;
+
+    return 0;
+}
+
+static void BuildResult(Explorer *explorer, Explore_Result *result)
+{
+    unsigned int node_count = explorer->node_count;
+
+    result->state_count = node_count < explorer->options->max_states ? node_count : explorer->options->max_states;
+    result->pruned_count = explorer->pruned_count;
+
+    if (explorer->found_parent == NOT_FOUND)
+    {
+        return;
+    }
+
+    uint32_t parent = explorer->found_parent;
+
+    result->found = 1;
+    memcpy(&result->state, &explorer->found_state, sizeof(Chip8));
+
+    // a step from the parent, unless the initial state is the goal
+    if (parent != NO_PARENT)
+    {
+        result->depth = 1;
+
+        for (uint32_t n = parent; explorer->nodes[n].parent != NO_PARENT; n = explorer->nodes[n].parent)
+        {
+            result->depth++;
+        }
+    }
+
+    result->inputs = malloc(result->depth ? result->depth : 1);
+
+    if (parent == NO_PARENT)
+    {
+        return;
+    }
+
+    unsigned int i = result->depth;
+
+    result->inputs[--i] = explorer->found_input;
+
+    for (uint32_t n = parent; explorer->nodes[n].parent != NO_PARENT; n = explorer->nodes[n].parent)
+    {
+        result->inputs[--i] = explorer->nodes[n].input;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef EXPLORE_H
+#define EXPLORE_H
+
+#include <stdint.h>
+
+#include "chip-8.h"
+
+#define EXPLORE_MAX_WORKERS 64
+#define EXPLORE_NO_KEY 0xFF         // input of a frame without any key pressed
+#define EXPLORE_INPUT_COUNT 17      // no key, then each of the 16 keys
+#define EXPLORE_FRAME_RATE 60       // a step runs the instructions of one frame at 60Hz
+
+// returns 1 when a state is what the exploration is looking for
+typedef int (*Explore_GoalFn)(const Chip8 *chip8, void *user_data);
+
+typedef struct Explore_Options
+{
+    unsigned int max_depth;         // frames
+    unsigned int max_frontier;      // states kept per depth, the others are pruned
+    unsigned int max_states;        // distinct states recorded, bounds the visited set
+    unsigned int worker_count;
+    Explore_GoalFn goal;            // checked at the end of each frame...
+    void *goal_user_data;
+    int goal_per_instruction;       // ...or after every instruction, for goals a frame can run past (e.g. a PC)
+} Explore_Options;
+
+typedef struct Explore_Result
+{
+    int found;
+    unsigned int depth;             // frames needed to reach the goal
+    uint8_t *inputs;                // key held during each frame (EXPLORE_NO_KEY for none), depth entries
+    Chip8 state;                    // the state reaching the goal, mid-frame with goal_per_instruction
+    unsigned long state_count;      // distinct states visited
+    unsigned long pruned_count;     // states dropped because the frontier or the visited set was full
+    unsigned int explored_depth;    // deepest depth fully expanded
+} Explore_Result;
+
+/*
+ * Breadth-first search over (state, key held for a frame) transitions, starting from a loaded instance.
+ * Each depth of the frontier is expanded by a pool of workers that restore states with a single copy and
+ * deduplicate them by Chip8_StateHash in a lock-free hash set. Memory stays bounded by max_frontier and
+ * max_states: states beyond them are pruned, and the search stops once max_states are recorded.
+ */
+int Explore_Run(const Chip8 *initial, const Explore_Options *options, Explore_Result *result);
+void Explore_FreeResult(Explore_Result *result);
+
+#endif // EXPLORE_H
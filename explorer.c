@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chip-8.h"
+#include "explore.h"
+
+#define DEFAULT_DEPTH 600           // 10 seconds
+#define DEFAULT_FRONTIER 2048
+#define DEFAULT_STATES (1 << 20)
+
+typedef enum ExplorerGoal
+{
+    GOAL_FAULT,
+    GOAL_PC,
+    GOAL_SCREEN
+} ExplorerGoal;
+
+typedef struct ExplorerOptions
+{
+    const char *rom_path;
+    unsigned int quirks;
+    ExplorerGoal goal;
+    uint16_t pc;
+    uint64_t screen_hash;
+    Explore_Options explore;
+} ExplorerOptions;
+
+static int ParseOptions(int argc, char **argv, ExplorerOptions *options);
+static void PrintUsage(void);
+static void PrintResult(const Explore_Result *result);
+static int IsGoal(const Chip8 *chip8, void *user_data);
+
+int main(int argc, char **argv)
+{
+    ExplorerOptions options;
+
+    if (ParseOptions(argc, argv, &options) < 0)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    Chip8 *chip8 = malloc(sizeof(Chip8));
+
+    Chip8_Init(chip8);
+
+    // a fixed seed so the inputs found replay to the same state
+    Chip8_SetSeed(chip8, 1);
+
+    if (Chip8_LoadFromFile(chip8, options.rom_path) < 0)
+    {
+        printf("Failed to load ROM (path: %s)\n", options.rom_path);
+        free(chip8);
+        return 1;
+    }
+
+    Chip8_SetQuirks(chip8, options.quirks);
+
+    Explore_Result *result = malloc(sizeof(Explore_Result));
+    int ret = Explore_Run(chip8, &options.explore, result);
+
+    free(chip8);
+
+    if (ret < 0)
+    {
+        printf("Failed to run the exploration\n");
+        free(result);
+        return 1;
+    }
+
+    PrintResult(result);
+
+    ret = result->found ? 0 : 2;
+
+    Explore_FreeResult(result);
+    free(result);
+
+    return ret;
+}
+
+static int ParseOptions(int argc, char **argv, ExplorerOptions *options)
+{
+    memset(options, 0, sizeof(ExplorerOptions));
+    options->goal = GOAL_FAULT;
+    options->explore.max_depth = DEFAULT_DEPTH;
+    options->explore.max_frontier = DEFAULT_FRONTIER;
+    options->explore.max_states = DEFAULT_STATES;
+    options->explore.worker_count = sysconf(_SC_NPROCESSORS_ONLN);
+    options->explore.goal = IsGoal;
+    options->explore.goal_user_data = options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+
+        if (strcmp(arg, "--depth") == 0 && i + 1 < argc)
+        {
+            options->explore.max_depth = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(arg, "--frontier") == 0 && i + 1 < argc)
+        {
+            options->explore.max_frontier = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(arg, "--states") == 0 && i + 1 < argc)
+        {
+            options->explore.max_states = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(arg, "--workers") == 0 && i + 1 < argc)
+        {
+            options->explore.worker_count = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(arg, "--quirks") == 0 && i + 1 < argc)
+        {
+            options->quirks = strtoul(argv[++i], NULL, 0) & CHIP8_QUIRK_ALL;
+        }
+        else if (strcmp(arg, "--pc") == 0 && i + 1 < argc)
+        {
+            // the PC goes through most addresses in the middle of a frame
+            options->goal = GOAL_PC;
+            options->pc = strtoul(argv[++i], NULL, 16);
+            options->explore.goal_per_instruction = 1;
+        }
+        else if (strcmp(arg, "--screen") == 0 && i + 1 < argc)
+        {
+            options->goal = GOAL_SCREEN;
+            options->screen_hash = strtoull(argv[++i], NULL, 16);
+        }
+        else if (strcmp(arg, "--fault") == 0)
+        {
+            options->goal = GOAL_FAULT;
+        }
+        else if (arg[0] != '-' && !options->rom_path)
+        {
+            options->rom_path = arg;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    return options->rom_path ? 0 : -1;
+}
+
+static void PrintUsage(void)
+{
+    printf("Usage: explorer [--depth FRAMES] [--frontier N] [--states N] [--workers N] [--quirks MASK] "
+            "[--fault | --pc ADDR | --screen HASH] ROM_PATH\n");
+}
+
+static void PrintResult(const Explore_Result *result)
+{
+    printf("Explored %u frames deep, %lu states (%lu pruned)\n",
+            result->explored_depth, result->state_count, result->pruned_count);
+
+    if (!result->found)
+    {
+        printf("Goal not reached\n");
+        return;
+    }
+
+    const Chip8 *chip8 = &result->state;
+
+    // one character per frame: the key held (0-F) or '.' for none
+    printf("Goal reached after %u frames (pc: 0x%03X", result->depth, chip8->pc);
+
+    if (chip8->faults)
+    {
+        printf(", fault: %s", Chip8_GetFaultName(chip8->faults));
+    }
+
+    printf(")\nInputs: ");
+
+    for (unsigned int i = 0; i < result->depth; i++)
+    {
+        uint8_t input = result->inputs[i];
+
+        putchar(input == EXPLORE_NO_KEY ? '.' : "0123456789ABCDEF"[input]);
+    }
+
+    printf("\nScreen (hash: %016llx):\n", (unsigned long long)Chip8_Hash(chip8->display, DISPLAY_SIZE));
+
+    for (int y = 0; y < DISPLAY_HEIGHT; y++)
+    {
+        for (int x = 0; x < DISPLAY_WIDTH; x++)
+        {
+            putchar(Chip8_GetPixel((Chip8 *)chip8, y * DISPLAY_WIDTH + x) ? '#' : ' ');
+        }
+
+        putchar('\n');
+    }
+}
+
+static int IsGoal(const Chip8 *chip8, void *user_data)
+{
+    const ExplorerOptions *options = user_data;
+
+    switch (options->goal)
+    {
+        case GOAL_FAULT:
+            return chip8->faults != 0;
+
+        case GOAL_PC:
+            return chip8->pc == options->pc;
+
+        case GOAL_SCREEN:
+            // sampled at the end of each frame, a screen drawn and erased within a frame is not seen
+            return Chip8_Hash(chip8->display, DISPLAY_SIZE) == options->screen_hash;
+    }
+
+    return 0;
+}
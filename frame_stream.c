@@ -0,0 +1,454 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "frame_stream.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // SO_NOSIGPIPE is set on the socket instead
+#endif
+
+#define HEADER_LEN sizeof(FrameStream_MessageHeader)
+#define FRAME_PAYLOAD_LEN 6 // subscription and frame, before the delta
+
+_Static_assert(sizeof(FrameStream_MessageHeader) == 4, "message headers are encoded in 4 bytes");
+
+static void AcceptSubscribers(FrameServer *server);
+static int ReadRequests(FrameServer *server, FrameServer_Subscriber *subscriber);
+static int Flush(FrameServer *server, FrameServer_Subscriber *subscriber, double now);
+static void QueueFrame(FrameServer *server, FrameServer_Subscriber *subscriber);
+static void DropSubscriber(FrameServer *server, unsigned int index);
+static int ProcessMessages(FrameClient *client);
+static int ConfigureSocket(int fd);
+static void WriteHeader(uint8_t *out, FrameStream_MessageType type, unsigned int len);
+static void ReadHeader(const uint8_t *data, FrameStream_MessageHeader *header);
+static void PutU16(uint8_t *out, uint16_t value);
+static void PutU32(uint8_t *out, uint32_t value);
+static uint16_t GetU16(const uint8_t *data);
+static uint32_t GetU32(const uint8_t *data);
+static double GetSeconds(void);
+
+int FrameServer_Open(FrameServer *server, const char *path, unsigned int instance_count)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+
+    memset(server, 0, sizeof(FrameServer));
+    server->fd = -1;
+
+    if (strlen(path) >= sizeof(addr.sun_path) || instance_count == 0)
+    {
+        return -1;
+    }
+
+    strcpy(addr.sun_path, path);
+    strcpy(server->path, path);
+    server->instance_count = instance_count;
+    server->displays = calloc(instance_count, DISPLAY_SIZE);
+    server->frames = calloc(instance_count, sizeof(uint32_t));
+    server->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (!server->displays || !server->frames || server->fd < 0)
+    {
+        FrameServer_Close(server);
+        return -1;
+    }
+
+    // a socket left behind by a previous run would make bind fail
+    unlink(path);
+
+    if (bind(server->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+            || listen(server->fd, FRAME_STREAM_MAX_SUBSCRIBERS) < 0
+            || ConfigureSocket(server->fd) < 0)
+    {
+        FrameServer_Close(server);
+        return -1;
+    }
+
+    return 0;
+}
+
+void FrameServer_Publish(FrameServer *server, unsigned int instance, const uint8_t *display)
+{
+    memcpy(server->displays[instance], display, DISPLAY_SIZE);
+    server->frames[instance]++;
+}
+
+// accepts viewers, reads their requests and sends them what their sockets can take
+void FrameServer_Update(FrameServer *server)
+{
+    double now = GetSeconds();
+
+    if (now - server->last_update < 1.0 / FRAME_STREAM_UPDATE_HZ) return;
+
+    server->last_update = now;
+    AcceptSubscribers(server);
+
+    for (unsigned int i = 0; i < server->subscriber_count;)
+    {
+        FrameServer_Subscriber *subscriber = &server->subscribers[i];
+
+        if (ReadRequests(server, subscriber) < 0 || Flush(server, subscriber, now) < 0)
+        {
+            DropSubscriber(server, i);
+            continue;
+        }
+
+        i++;
+    }
+}
+
+void FrameServer_Close(FrameServer *server)
+{
+    while (server->subscriber_count > 0)
+    {
+        DropSubscriber(server, 0);
+    }
+
+    if (server->fd >= 0)
+    {
+        close(server->fd);
+        unlink(server->path);
+    }
+
+    free(server->displays);
+    free(server->frames);
+    memset(server, 0, sizeof(FrameServer));
+    server->fd = -1;
+}
+
+int FrameClient_Connect(FrameClient *client, const char *path)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+
+    memset(client, 0, sizeof(FrameClient));
+    client->instance = -1;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        return -1;
+    }
+
+    strcpy(addr.sun_path, path);
+    client->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (client->fd < 0)
+    {
+        return -1;
+    }
+
+    if (connect(client->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || ConfigureSocket(client->fd) < 0)
+    {
+        FrameClient_Close(client);
+        return -1;
+    }
+
+    return 0;
+}
+
+int FrameClient_Subscribe(FrameClient *client, unsigned int instance)
+{
+    uint8_t message[HEADER_LEN + 4];
+
+    client->instance = instance;
+    client->subscription++;
+    client->frame = 0;
+    memset(client->display, 0, DISPLAY_SIZE);
+
+    WriteHeader(message, FRAME_STREAM_SUBSCRIBE, 4);
+    PutU16(message + HEADER_LEN, instance);
+    PutU16(message + HEADER_LEN + 2, client->subscription);
+
+    return send(client->fd, message, sizeof(message), MSG_NOSIGNAL) == sizeof(message) ? 0 : -1;
+}
+
+// reads what the server sent, returns 1 if the display changed, 0 if not, -1 once disconnected
+int FrameClient_Poll(FrameClient *client)
+{
+    int changed = 0;
+
+    for (;;)
+    {
+        ssize_t len = recv(client->fd, client->in + client->in_len, sizeof(client->in) - client->in_len, 0);
+
+        if (len == 0)
+        {
+            return -1;
+        }
+
+        if (len < 0)
+        {
+            return errno == EAGAIN || errno == EWOULDBLOCK ? changed : -1;
+        }
+
+        client->in_len += len;
+
+        int ret = ProcessMessages(client);
+
+        if (ret < 0)
+        {
+            return -1;
+        }
+
+        changed |= ret;
+    }
+}
+
+void FrameClient_Close(FrameClient *client)
+{
+    if (client->fd >= 0)
+    {
+        close(client->fd);
+        client->fd = -1;
+    }
+}
+
+static void AcceptSubscribers(FrameServer *server)
+{
+    int fd;
+
+    while ((fd = accept(server->fd, NULL, NULL)) >= 0)
+    {
+        int send_buffer = FRAME_STREAM_SEND_BUFFER;
+
+        if (server->subscriber_count == FRAME_STREAM_MAX_SUBSCRIBERS || ConfigureSocket(fd) < 0)
+        {
+            close(fd);
+            continue;
+        }
+
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &send_buffer, sizeof(send_buffer));
+
+        FrameServer_Subscriber *subscriber = &server->subscribers[server->subscriber_count++];
+
+        memset(subscriber, 0, sizeof(FrameServer_Subscriber));
+        subscriber->fd = fd;
+        subscriber->instance = -1;
+
+        WriteHeader(subscriber->out, FRAME_STREAM_HELLO, 2);
+        PutU16(subscriber->out + HEADER_LEN, server->instance_count);
+        subscriber->out_len = HEADER_LEN + 2;
+    }
+}
+
+static int ReadRequests(FrameServer *server, FrameServer_Subscriber *subscriber)
+{
+    ssize_t len = recv(subscriber->fd, subscriber->in + subscriber->in_len, sizeof(subscriber->in) - subscriber->in_len, 0);
+
+    if (len == 0)
+    {
+        return -1;
+    }
+
+    if (len < 0)
+    {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+
+    subscriber->in_len += len;
+
+    while (subscriber->in_len >= HEADER_LEN)
+    {
+        FrameStream_MessageHeader header;
+
+        ReadHeader(subscriber->in, &header);
+
+        if (HEADER_LEN + header.len > sizeof(subscriber->in))
+        {
+            return -1;
+        }
+
+        if (subscriber->in_len < HEADER_LEN + header.len) break;
+
+        const uint8_t *payload = subscriber->in + HEADER_LEN;
+
+        if (header.type == FRAME_STREAM_SUBSCRIBE && header.len == 4 && GetU16(payload) < server->instance_count)
+        {
+            subscriber->instance = GetU16(payload);
+            subscriber->subscription = GetU16(payload + 2);
+            memset(subscriber->sent, 0, DISPLAY_SIZE);
+        }
+
+        subscriber->in_len -= HEADER_LEN + header.len;
+        memmove(subscriber->in, subscriber->in + HEADER_LEN + header.len, subscriber->in_len);
+    }
+
+    return 0;
+}
+
+// sends what the socket takes of the queued message, queuing the latest frame first if there is none
+static int Flush(FrameServer *server, FrameServer_Subscriber *subscriber, double now)
+{
+    if (subscriber->out_len == 0 && subscriber->instance >= 0)
+    {
+        QueueFrame(server, subscriber);
+    }
+
+    if (subscriber->out_len == 0)
+    {
+        subscriber->blocked_since = 0;
+        return 0;
+    }
+
+    ssize_t len = send(subscriber->fd, subscriber->out + subscriber->out_pos,
+            subscriber->out_len - subscriber->out_pos, MSG_NOSIGNAL);
+
+    if (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+        return -1;
+    }
+
+    if (len > 0)
+    {
+        subscriber->out_pos += len;
+        subscriber->blocked_since = 0;
+    }
+    else if (subscriber->blocked_since == 0)
+    {
+        subscriber->blocked_since = now;
+    }
+    else if (now - subscriber->blocked_since > FRAME_STREAM_DROP_SECS)
+    {
+        return -1;
+    }
+
+    if (subscriber->out_pos == subscriber->out_len)
+    {
+        subscriber->out_pos = 0;
+        subscriber->out_len = 0;
+    }
+
+    return 0;
+}
+
+static void QueueFrame(FrameServer *server, FrameServer_Subscriber *subscriber)
+{
+    const uint8_t *display = server->displays[subscriber->instance];
+    uint8_t *payload = subscriber->out + HEADER_LEN;
+    unsigned int delta_len = Capture_EncodeDelta(subscriber->sent, display, payload + FRAME_PAYLOAD_LEN);
+
+    // no span, the viewer already shows that display
+    if (payload[FRAME_PAYLOAD_LEN] == 0) return;
+
+    WriteHeader(subscriber->out, FRAME_STREAM_FRAME, FRAME_PAYLOAD_LEN + delta_len);
+    PutU16(payload, subscriber->subscription);
+    PutU32(payload + 2, server->frames[subscriber->instance]);
+    subscriber->out_len = HEADER_LEN + FRAME_PAYLOAD_LEN + delta_len;
+    subscriber->out_pos = 0;
+    memcpy(subscriber->sent, display, DISPLAY_SIZE);
+}
+
+static void DropSubscriber(FrameServer *server, unsigned int index)
+{
+    close(server->subscribers[index].fd);
+
+    if (index != --server->subscriber_count)
+    {
+        memcpy(&server->subscribers[index], &server->subscribers[server->subscriber_count], sizeof(FrameServer_Subscriber));
+    }
+}
+
+// handles the complete messages received, returns 1 if the display changed, 0 if not, -1 if a message is invalid
+static int ProcessMessages(FrameClient *client)
+{
+    int changed = 0;
+
+    while (client->in_len >= HEADER_LEN)
+    {
+        FrameStream_MessageHeader header;
+
+        ReadHeader(client->in, &header);
+
+        if (HEADER_LEN + header.len > FRAME_STREAM_MAX_MESSAGE_LEN)
+        {
+            return -1;
+        }
+
+        if (client->in_len < HEADER_LEN + header.len) break;
+
+        const uint8_t *payload = client->in + HEADER_LEN;
+
+        if (header.type == FRAME_STREAM_HELLO && header.len >= 2)
+        {
+            client->instance_count = GetU16(payload);
+        }
+        else if (header.type == FRAME_STREAM_FRAME && header.len > FRAME_PAYLOAD_LEN
+                && client->instance >= 0 && GetU16(payload) == client->subscription)
+        {
+            if (Capture_DecodeDelta(payload + FRAME_PAYLOAD_LEN, header.len - FRAME_PAYLOAD_LEN, client->display) < 0)
+            {
+                return -1;
+            }
+
+            client->frame = GetU32(payload + 2);
+            changed = 1;
+        }
+
+        client->in_len -= HEADER_LEN + header.len;
+        memmove(client->in, client->in + HEADER_LEN + header.len, client->in_len);
+    }
+
+    return changed;
+}
+
+static int ConfigureSocket(int fd)
+{
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+    int flags = fcntl(fd, F_GETFL, 0);
+
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static void WriteHeader(uint8_t *out, FrameStream_MessageType type, unsigned int len)
+{
+    out[0] = type;
+    out[1] = 0;
+    PutU16(out + 2, len);
+}
+
+static void ReadHeader(const uint8_t *data, FrameStream_MessageHeader *header)
+{
+    header->type = data[0];
+    header->reserved = data[1];
+    header->len = GetU16(data + 2);
+}
+
+static void PutU16(uint8_t *out, uint16_t value)
+{
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+static void PutU32(uint8_t *out, uint32_t value)
+{
+    PutU16(out, value & 0xFFFF);
+    PutU16(out + 2, value >> 16);
+}
+
+static uint16_t GetU16(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+static uint32_t GetU32(const uint8_t *data)
+{
+    return GetU16(data) | ((uint32_t)GetU16(data + 2) << 16);
+}
+
+static double GetSeconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
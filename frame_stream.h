@@ -0,0 +1,93 @@
+#ifndef FRAME_STREAM_H
+#define FRAME_STREAM_H
+
+#include <stdint.h>
+
+#include "capture.h"
+#include "chip-8.h"
+
+#define FRAME_STREAM_MAX_SUBSCRIBERS 16
+#define FRAME_STREAM_UPDATE_HZ 120          // socket work done per second at most, frames published meanwhile are coalesced
+#define FRAME_STREAM_DROP_SECS 5.0          // subscribers that cannot take anything for that long are dropped
+#define FRAME_STREAM_SEND_BUFFER 8192       // small socket buffers keep slow subscribers close to the latest frame
+#define FRAME_STREAM_MAX_MESSAGE_LEN (sizeof(FrameStream_MessageHeader) + 6 + CAPTURE_MAX_DELTA_LEN)
+
+/*
+ * Messages exchanged over the stream socket, a FrameStream_MessageHeader (4 bytes, little endian) followed by len
+ * bytes, with the payload fields little endian too:
+ *
+ *   FRAME_STREAM_HELLO      server -> viewer   uint16 instance count
+ *   FRAME_STREAM_SUBSCRIBE  viewer -> server   uint16 instance, uint16 subscription
+ *   FRAME_STREAM_FRAME      server -> viewer   uint16 subscription, uint32 frame, display delta (Capture_EncodeDelta)
+ *
+ * After a subscription, the first delta of the instance starts from a blank display. Frames carry the subscription
+ * they were sent for, so the ones still in flight for a previous subscription can be told apart.
+ */
+typedef enum FrameStream_MessageType
+{
+    FRAME_STREAM_HELLO = 1,
+    FRAME_STREAM_SUBSCRIBE,
+    FRAME_STREAM_FRAME
+} FrameStream_MessageType;
+
+typedef struct FrameStream_MessageHeader
+{
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t len;
+} FrameStream_MessageHeader;
+
+typedef struct FrameServer_Subscriber
+{
+    int fd;
+    int instance;                                   // -1 until the viewer subscribes
+    uint16_t subscription;
+    uint8_t sent[DISPLAY_SIZE];                     // display the viewer has once the queued message is sent
+    uint8_t out[FRAME_STREAM_MAX_MESSAGE_LEN];      // message being sent
+    unsigned int out_len;
+    unsigned int out_pos;
+    uint8_t in[FRAME_STREAM_MAX_MESSAGE_LEN];       // requests being received
+    unsigned int in_len;
+    double blocked_since;                           // 0 while the socket takes what is sent
+} FrameServer_Subscriber;
+
+/*
+ * Publishes the display of a set of instances over a Unix domain socket. FrameServer_Publish only copies the
+ * display; FrameServer_Update does the socket work, at most FRAME_STREAM_UPDATE_HZ times per second, and never
+ * blocks: each subscriber has a single message in flight, frames published meanwhile are coalesced into the next
+ * delta and subscribers stuck for FRAME_STREAM_DROP_SECS are disconnected, so the emulation never waits for a viewer.
+ */
+typedef struct FrameServer
+{
+    int fd;
+    char path[108];
+    unsigned int instance_count;
+    uint8_t (*displays)[DISPLAY_SIZE];              // last display published by each instance
+    uint32_t *frames;                               // frames published by each instance
+    FrameServer_Subscriber subscribers[FRAME_STREAM_MAX_SUBSCRIBERS];
+    unsigned int subscriber_count;
+    double last_update;
+} FrameServer;
+
+typedef struct FrameClient
+{
+    int fd;
+    unsigned int instance_count;                    // 0 until the server said hello
+    int instance;                                   // -1 until subscribed
+    uint16_t subscription;
+    uint32_t frame;
+    uint8_t display[DISPLAY_SIZE];
+    uint8_t in[FRAME_STREAM_MAX_MESSAGE_LEN * 4];
+    unsigned int in_len;
+} FrameClient;
+
+int FrameServer_Open(FrameServer *server, const char *path, unsigned int instance_count);
+void FrameServer_Publish(FrameServer *server, unsigned int instance, const uint8_t *display);
+void FrameServer_Update(FrameServer *server);
+void FrameServer_Close(FrameServer *server);
+int FrameClient_Connect(FrameClient *client, const char *path);
+int FrameClient_Subscribe(FrameClient *client, unsigned int instance);
+int FrameClient_Poll(FrameClient *client);
+void FrameClient_Close(FrameClient *client);
+
+#endif // FRAME_STREAM_H
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chip-8.h"
+
+// an input is a header (quirks byte + key schedule) followed by the ROM
+#define FUZZ_CYCLES 20000
+#define FUZZ_KEY_FRAMES 8
+#define FUZZ_KEY_PERIOD (FUZZ_CYCLES / FUZZ_KEY_FRAMES)
+#define FUZZ_HEADER_LEN (1 + FUZZ_KEY_FRAMES * 2)
+
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+#ifndef CHIP8_LIBFUZZER
+static int ReplayFile(const char *path);
+static double GetSeconds(void);
+#endif
+
+// initialized once, every input starts from a copy of it instead of going through Chip8_Init
+static Chip8 pristine;
+static Chip8 chip8;
+
+int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+    (void)argc;
+    (void)argv;
+
+    Chip8_Init(&pristine);
+    // a fixed seed, so a crashing input always reproduces
+    Chip8_SetSeed(&pristine, 1);
+
+    return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (size <= FUZZ_HEADER_LEN)
+    {
+        return 0;
+    }
+
+    memcpy(&chip8, &pristine, sizeof(Chip8));
+
+    if (Chip8_Load(&chip8, (uint8_t *)data + FUZZ_HEADER_LEN, size - FUZZ_HEADER_LEN) < 0)
+    {
+        return 0;
+    }
+
+    Chip8_SetQuirks(&chip8, data[0] & CHIP8_QUIRK_ALL);
+
+    for (int i = 0; i < FUZZ_KEY_FRAMES; i++)
+    {
+        Chip8_SetKeys(&chip8, (data[1 + i * 2] << 8) | data[2 + i * 2]);
+
+        // the ROM ended or faulted
+        if (Chip8_Run(&chip8, FUZZ_KEY_PERIOD) < FUZZ_KEY_PERIOD) break;
+    }
+
+    return 0;
+}
+
+#ifndef CHIP8_LIBFUZZER
+
+// without libFuzzer (gcc builds), runs the inputs given on the command line, e.g. to reproduce a crash
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: fuzz_replay INPUT...\n");
+        return 1;
+    }
+
+    LLVMFuzzerInitialize(&argc, &argv);
+
+    double start = GetSeconds();
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (ReplayFile(argv[i]) < 0)
+        {
+            printf("Failed to read input (path: %s)\n", argv[i]);
+            return 1;
+        }
+    }
+
+    double elapsed = GetSeconds() - start;
+
+    printf("Replayed %d inputs (%.0f execs/s)\n", argc - 1, (argc - 1) / elapsed);
+
+    return 0;
+}
+
+static int ReplayFile(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+
+    if (!f)
+    {
+        return -1;
+    }
+
+    uint8_t data[FUZZ_HEADER_LEN + RAM_SIZE];
+    size_t size = fread(data, 1, sizeof(data), f);
+
+    fclose(f);
+    LLVMFuzzerTestOneInput(data, size);
+
+    return 0;
+}
+
+static double GetSeconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#endif // CHIP8_LIBFUZZER
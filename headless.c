@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "capture.h"
+#include "chip-8.h"
+#include "frame_stream.h"
+#include "rom_db.h"
+#include "rom_pack.h"
+#include "trace.h"
+
+#define DEFAULT_CYCLES 1000000
+#define ROM_DB_OVERRIDE_ENV "CHIP8_ROM_DB"
+
+typedef struct HeadlessOptions
+{
+    const char *rom_path;
+    const char *pack_path;
+    const char *db_path;
+    unsigned long cycles;
+    const char *profile_json_path;
+    const char *profile_collapsed_path;
+    const char *trace_path;
+    const char *capture_path;
+    const char *serve_path;
+    int realtime;
+} HeadlessOptions;
+
+static int ParseOptions(int argc, char **argv, HeadlessOptions *options);
+static void PrintUsage(void);
+static int ApplyRomSettings(Chip8 *chip8, HeadlessOptions *options);
+static unsigned long RunFrames(Chip8 *chip8, HeadlessOptions *options, Capture *capture, FrameServer *server);
+static void WaitFrame(double start, unsigned long frame);
+static double GetSeconds(void);
+#ifdef CHIP8_PROFILER
+static int WriteProfile(Chip8_Profiler *profiler, HeadlessOptions *options);
+#endif
+
+int main(int argc, char **argv)
+{
+    HeadlessOptions options;
+
+    if (ParseOptions(argc, argv, &options) < 0)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    Chip8 chip8;
+
+    Chip8_Init(&chip8);
+
+    if (options.pack_path)
+    {
+        RomPack pack;
+
+        if (RomPack_Open(&pack, options.pack_path) < 0)
+        {
+            printf("Failed to open ROM pack (path: %s)\n", options.pack_path);
+            return 1;
+        }
+
+        int ret = Chip8_LoadFromPack(&chip8, &pack, options.rom_path);
+
+        RomPack_Close(&pack);
+
+        if (ret < 0)
+        {
+            printf("Failed to load ROM from pack (name: %s)\n", options.rom_path);
+            return 1;
+        }
+    }
+    else if (Chip8_LoadFromFile(&chip8, options.rom_path) < 0)
+    {
+        printf("Failed to load ROM (path: %s)\n", options.rom_path);
+        return 1;
+    }
+
+    if (ApplyRomSettings(&chip8, &options) < 0)
+    {
+        return 1;
+    }
+
+    Trace trace;
+
+    if (options.trace_path)
+    {
+        if (Trace_Open(&trace, options.trace_path) < 0)
+        {
+            printf("Failed to open trace (path: %s)\n", options.trace_path);
+            return 1;
+        }
+
+        Trace_Attach(&trace, &chip8);
+    }
+
+    Capture capture;
+
+    if (options.capture_path && Capture_Open(&capture, options.capture_path) < 0)
+    {
+        printf("Failed to open capture (path: %s)\n", options.capture_path);
+        return 1;
+    }
+
+    static FrameServer server;
+
+    if (options.serve_path && FrameServer_Open(&server, options.serve_path, 1) < 0)
+    {
+        printf("Failed to open frame server (path: %s)\n", options.serve_path);
+        return 1;
+    }
+
+#ifdef CHIP8_PROFILER
+    Chip8_Profiler *profiler = malloc(sizeof(Chip8_Profiler));
+
+    Chip8_ResetProfiler(profiler);
+    Chip8_SetProfiler(&chip8, profiler);
+#endif
+
+    unsigned long cycles = options.capture_path || options.serve_path || options.realtime
+            ? RunFrames(&chip8, &options, &capture, &server)
+            : Chip8_Run(&chip8, options.cycles);
+
+    printf("Executed %lu instructions (pc: 0x%X)\n", cycles, chip8.pc);
+
+    if (chip8.faults)
+    {
+        printf("Fault: %s (pc: 0x%X)\n", Chip8_GetFaultName(chip8.faults), chip8.pc);
+    }
+
+    if (options.trace_path && Trace_Close(&trace) < 0)
+    {
+        printf("Failed to write trace (path: %s)\n", options.trace_path);
+        return 1;
+    }
+
+    if (options.capture_path && Capture_Close(&capture) < 0)
+    {
+        printf("Failed to write capture (path: %s)\n", options.capture_path);
+        return 1;
+    }
+
+    if (options.serve_path)
+    {
+        FrameServer_Close(&server);
+    }
+
+#ifdef CHIP8_PROFILER
+    int ret = WriteProfile(profiler, &options);
+
+    free(profiler);
+
+    if (ret < 0)
+    {
+        return 1;
+    }
+#endif
+
+    return 0;
+}
+
+static int ParseOptions(int argc, char **argv, HeadlessOptions *options)
+{
+    memset(options, 0, sizeof(HeadlessOptions));
+    options->cycles = DEFAULT_CYCLES;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+
+        if (strcmp(arg, "--cycles") == 0 && i + 1 < argc)
+        {
+            options->cycles = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(arg, "--pack") == 0 && i + 1 < argc)
+        {
+            options->pack_path = argv[++i];
+        }
+        else if (strcmp(arg, "--db") == 0 && i + 1 < argc)
+        {
+            options->db_path = argv[++i];
+        }
+        else if (strcmp(arg, "--trace") == 0 && i + 1 < argc)
+        {
+            options->trace_path = argv[++i];
+        }
+        else if (strcmp(arg, "--capture") == 0 && i + 1 < argc)
+        {
+            options->capture_path = argv[++i];
+        }
+        else if (strcmp(arg, "--serve") == 0 && i + 1 < argc)
+        {
+            options->serve_path = argv[++i];
+        }
+        else if (strcmp(arg, "--realtime") == 0)
+        {
+            options->realtime = 1;
+        }
+#ifdef CHIP8_PROFILER
+        else if (strcmp(arg, "--profile-json") == 0 && i + 1 < argc)
+        {
+            options->profile_json_path = argv[++i];
+        }
+        else if (strcmp(arg, "--profile-collapsed") == 0 && i + 1 < argc)
+        {
+            options->profile_collapsed_path = argv[++i];
+        }
+#endif
+        else if (arg[0] != '-' && !options->rom_path)
+        {
+            options->rom_path = arg;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    if (!options->db_path)
+    {
+        options->db_path = getenv(ROM_DB_OVERRIDE_ENV);
+    }
+
+    return options->rom_path ? 0 : -1;
+}
+
+static void PrintUsage(void)
+{
+#ifdef CHIP8_PROFILER
+    printf("Usage: profiler [--cycles N] [--pack PATH] [--db PATH] [--trace PATH] [--capture PATH] [--serve PATH] [--realtime] [--profile-json PATH] [--profile-collapsed PATH] ROM_PATH\n");
+#else
+    printf("Usage: headless [--cycles N] [--pack PATH] [--db PATH] [--trace PATH] [--capture PATH] [--serve PATH] [--realtime] ROM_PATH\n");
+#endif
+}
+
+static int ApplyRomSettings(Chip8 *chip8, HeadlessOptions *options)
+{
+    RomDb db;
+    char error[ROM_DB_ERROR_MAX_LEN];
+
+    if (RomDb_Init(&db) < 0)
+    {
+        printf("Failed to load the embedded ROM database\n");
+        return -1;
+    }
+
+    if (options->db_path && RomDb_LoadFile(&db, options->db_path, error, sizeof(error)) < 0)
+    {
+        printf("Failed to load ROM database (path: %s, %s)\n", options->db_path, error);
+        RomDb_Deinit(&db);
+        return -1;
+    }
+
+    const RomDb_Settings *settings = RomDb_Find(&db, chip8->program_hash);
+
+    if (settings)
+    {
+        RomDb_Apply(settings, chip8);
+        printf("Applied ROM database settings (hash: %016llx)\n", (unsigned long long)chip8->program_hash);
+    }
+
+    RomDb_Deinit(&db);
+
+    return 0;
+}
+
+// runs the instructions a frame at a time, recording or publishing the display at the end of each frame
+static unsigned long RunFrames(Chip8 *chip8, HeadlessOptions *options, Capture *capture, FrameServer *server)
+{
+    unsigned long frame_len = chip8->frequency / CAPTURE_FRAME_RATE + 0.5;
+    unsigned long total = 0;
+    double start = GetSeconds();
+
+    if (frame_len == 0) frame_len = 1;
+
+    for (unsigned long frame = 0; total < options->cycles; frame++)
+    {
+        unsigned long len = options->cycles - total < frame_len ? options->cycles - total : frame_len;
+        unsigned long ran = Chip8_Run(chip8, len);
+
+        total += ran;
+
+        if (options->capture_path)
+        {
+            Capture_Frame(capture, chip8->display);
+        }
+
+        if (options->serve_path)
+        {
+            FrameServer_Publish(server, 0, chip8->display);
+            FrameServer_Update(server);
+        }
+
+        if (ran < len) break;
+
+        if (options->realtime)
+        {
+            WaitFrame(start, frame + 1);
+        }
+    }
+
+    return total;
+}
+
+static void WaitFrame(double start, unsigned long frame)
+{
+    double delay = start + (double)frame / CAPTURE_FRAME_RATE - GetSeconds();
+
+    if (delay <= 0) return;
+
+    struct timespec ts = {.tv_sec = delay, .tv_nsec = (delay - (long)delay) * 1e9};
+
+    nanosleep(&ts, NULL);
+}
+
+static double GetSeconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#ifdef CHIP8_PROFILER
+
+static int WriteProfile(Chip8_Profiler *profiler, HeadlessOptions *options)
+{
+    if (!options->profile_json_path && !options->profile_collapsed_path)
+    {
+        Chip8_WriteProfileJSON(profiler, stdout);
+        return 0;
+    }
+
+    if (options->profile_json_path)
+    {
+        FILE *f = fopen(options->profile_json_path, "w");
+
+        if (!f)
+        {
+            printf("Failed to open %s\n", options->profile_json_path);
+            return -1;
+        }
+
+        Chip8_WriteProfileJSON(profiler, f);
+        fclose(f);
+    }
+
+    if (options->profile_collapsed_path)
+    {
+        FILE *f = fopen(options->profile_collapsed_path, "w");
+
+        if (!f)
+        {
+            printf("Failed to open %s\n", options->profile_collapsed_path);
+            return -1;
+        }
+
+        Chip8_WriteProfileCollapsed(profiler, f);
+        fclose(f);
+    }
+
+    return 0;
+}
+
+#endif // CHIP8_PROFILER
@@ -0,0 +1,208 @@
+#include <string.h>
+
+#include "disasm.h"
+#include "lockstep.h"
+
+static unsigned long RunBlock(Chip8 *chip8, Lockstep_StepFn step, unsigned long len);
+static int FindDivergence(Lockstep *lockstep, unsigned long len, Lockstep_Divergence *divergence);
+static uint16_t GetKeysAt(unsigned long cycle);
+static void PrintRegister(FILE *f, const char *name, unsigned int reference, unsigned int candidate);
+
+void Lockstep_Init(Lockstep *lockstep, Lockstep_StepFn candidate_step)
+{
+    memset(lockstep, 0, sizeof(Lockstep));
+
+    Chip8_Init(&lockstep->reference);
+    Chip8_Init(&lockstep->candidate);
+    Chip8_SetSeed(&lockstep->reference, LOCKSTEP_SEED);
+    Chip8_SetSeed(&lockstep->candidate, LOCKSTEP_SEED);
+
+    lockstep->candidate_step = candidate_step;
+}
+
+int Lockstep_Load(Lockstep *lockstep, uint8_t *data, unsigned int len)
+{
+    if (Chip8_Load(&lockstep->reference, data, len) < 0 || Chip8_Load(&lockstep->candidate, data, len) < 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+// returns 1 when the cores diverged (divergence is filled), 0 when they both ran the given number of
+// instructions or stopped at the same point
+int Lockstep_Run(Lockstep *lockstep, unsigned long cycles, unsigned int block_len, Lockstep_Divergence *divergence)
+{
+    unsigned long end = lockstep->cycle + cycles;
+
+    while (lockstep->cycle < end)
+    {
+        // blocks never cross a change of keys, so a block replays with the keys it ran with
+        unsigned long keys_end = (lockstep->cycle / LOCKSTEP_KEYS_PERIOD + 1) * LOCKSTEP_KEYS_PERIOD;
+        unsigned long len = block_len;
+
+        if (lockstep->cycle + len > keys_end) len = keys_end - lockstep->cycle;
+        if (lockstep->cycle + len > end) len = end - lockstep->cycle;
+
+        // both cores read the same keys, part of the snapshots so a replayed block reads them too
+        uint16_t keys = GetKeysAt(lockstep->cycle);
+
+        Chip8_SetKeys(&lockstep->reference, keys);
+        Chip8_SetKeys(&lockstep->candidate, keys);
+
+        memcpy(&lockstep->reference_snapshot, &lockstep->reference, sizeof(Chip8));
+        memcpy(&lockstep->candidate_snapshot, &lockstep->candidate, sizeof(Chip8));
+
+        unsigned long reference_count = RunBlock(&lockstep->reference, Chip8_Tick, len);
+        unsigned long candidate_count = RunBlock(&lockstep->candidate, lockstep->candidate_step, len);
+
+        if (reference_count != candidate_count ||
+                Chip8_StateHash(&lockstep->reference) != Chip8_StateHash(&lockstep->candidate))
+        {
+            memcpy(&lockstep->reference, &lockstep->reference_snapshot, sizeof(Chip8));
+            memcpy(&lockstep->candidate, &lockstep->candidate_snapshot, sizeof(Chip8));
+
+            return FindDivergence(lockstep, len, divergence);
+        }
+
+        lockstep->cycle += reference_count;
+
+        if (reference_count < len)
+        {
+            // both programs ended or faulted on the same instruction
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
+void Lockstep_PrintDivergence(const Lockstep_Divergence *divergence, FILE *f)
+{
+    const Chip8 *before = &divergence->before;
+    const Chip8 *reference = &divergence->reference;
+    const Chip8 *candidate = &divergence->candidate;
+    Chip8_InstructionType instruction_type;
+    uint16_t instruction;
+    uint16_t opcode = (before->mem[before->pc] << 8) | before->mem[before->pc + 1];
+    char mnemonic[DISASM_MNEMONIC_MAX_LEN];
+
+    Chip8_DecodeInstruction(opcode, &instruction_type, &instruction);
+    Disasm_FormatInstruction(instruction_type, instruction, mnemonic, sizeof(mnemonic));
+
+    fprintf(f, "Divergence at instruction %lu (pc: 0x%03X, opcode: %04X, %s)\n",
+            divergence->cycle, before->pc, opcode, mnemonic);
+    fprintf(f, "  %-8s %10s %10s\n", "", "reference", "candidate");
+
+    PrintRegister(f, "returned", divergence->reference_ret, divergence->candidate_ret);
+    PrintRegister(f, "pc", reference->pc, candidate->pc);
+    PrintRegister(f, "i", reference->i, candidate->i);
+    PrintRegister(f, "sp", reference->sp, candidate->sp);
+    PrintRegister(f, "dt", reference->dt, candidate->dt);
+    PrintRegister(f, "st", reference->st, candidate->st);
+    PrintRegister(f, "faults", reference->faults, candidate->faults);
+
+    for (int i = 0; i < REGISTER_COUNT; i++)
+    {
+        char name[4];
+
+        snprintf(name, sizeof(name), "v%X", i);
+        PrintRegister(f, name, reference->v[i], candidate->v[i]);
+    }
+
+    for (int i = 0; i < STACK_SIZE; i++)
+    {
+        if (reference->stack[i] != candidate->stack[i])
+        {
+            char name[16];
+
+            snprintf(name, sizeof(name), "stack[%d]", i);
+            PrintRegister(f, name, reference->stack[i], candidate->stack[i]);
+        }
+    }
+
+    unsigned int mem_diffs = 0;
+
+    for (int addr = 0; addr < RAM_SIZE; addr++)
+    {
+        if (reference->mem[addr] == candidate->mem[addr]) continue;
+
+        if (mem_diffs++ < LOCKSTEP_MAX_MEM_DIFFS)
+        {
+            char name[16];
+
+            snprintf(name, sizeof(name), "[0x%03X]", addr);
+            PrintRegister(f, name, reference->mem[addr], candidate->mem[addr]);
+        }
+    }
+
+    unsigned int display_diffs = 0;
+
+    for (int i = 0; i < DISPLAY_SIZE; i++)
+    {
+        display_diffs += reference->display[i] != candidate->display[i];
+    }
+
+    fprintf(f, "  %u differing memory bytes, %u differing display bytes\n", mem_diffs, display_diffs);
+}
+
+static unsigned long RunBlock(Chip8 *chip8, Lockstep_StepFn step, unsigned long len)
+{
+    unsigned long count = 0;
+
+    while (count < len && step(chip8))
+    {
+        count++;
+    }
+
+    return count;
+}
+
+static int FindDivergence(Lockstep *lockstep, unsigned long len, Lockstep_Divergence *divergence)
+{
+    Chip8 *reference = &lockstep->reference;
+    Chip8 *candidate = &lockstep->candidate;
+
+    for (unsigned long i = 0; i < len; i++)
+    {
+        memcpy(&divergence->before, reference, sizeof(Chip8));
+
+        divergence->reference_ret = Chip8_Tick(reference);
+        divergence->candidate_ret = lockstep->candidate_step(candidate);
+        divergence->cycle = lockstep->cycle + i;
+
+        // compare what Chip8_Tick returns as a boolean, a candidate may return anything non zero
+        if (!divergence->reference_ret != !divergence->candidate_ret ||
+                Chip8_StateHash(reference) != Chip8_StateHash(candidate))
+        {
+            break;
+        }
+
+        if (!divergence->reference_ret) break;
+    }
+
+    // a block that doesn't diverge when replayed means one of the engines isn't deterministic, the last
+    // instruction of the block is reported then
+    memcpy(&divergence->reference, reference, sizeof(Chip8));
+    memcpy(&divergence->candidate, candidate, sizeof(Chip8));
+
+    return 1;
+}
+
+static uint16_t GetKeysAt(unsigned long cycle)
+{
+    // a pseudo random key (or none) per period, derived from the cycle so any block can be replayed
+    uint32_t x = (uint32_t)(cycle / LOCKSTEP_KEYS_PERIOD) * 0x9E3779B9;
+
+    x ^= x >> 16;
+    x *= 0x85EBCA6B;
+    x ^= x >> 13;
+
+    return (x & 0x10) ? 1 << (x & 0xF) : 0;
+}
+
+static void PrintRegister(FILE *f, const char *name, unsigned int reference, unsigned int candidate)
+{
+    fprintf(f, "%c %-8s %10X %10X\n", reference != candidate ? '*' : ' ', name, reference, candidate);
+}
@@ -0,0 +1,48 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip-8.h"
+
+#define LOCKSTEP_BLOCK_LEN 4096     // default number of instructions between two state comparisons
+#define LOCKSTEP_KEYS_PERIOD 2048   // instructions between two changes of the key input stream
+#define LOCKSTEP_SEED 0xC8C8C8C8    // RND seed of both cores
+#define LOCKSTEP_MAX_MEM_DIFFS 8    // differing memory bytes printed for a divergence
+
+// executes a single instruction, with the same contract as Chip8_Tick (0 once the program ended or faulted)
+typedef int (*Lockstep_StepFn)(Chip8 *chip8);
+
+/*
+ * Runs the handler table interpreter (the reference) and a candidate engine on the same ROM and the same
+ * key input stream, comparing Chip8_StateHash after every block of instructions. When a block diverges,
+ * both cores go back to their state at the start of the block and replay it one instruction at a time to
+ * find the first divergent instruction.
+ */
+typedef struct Lockstep
+{
+    Chip8 reference;                // runs Chip8_Tick
+    Chip8 candidate;                // runs candidate_step, may be set up further (quirks, hooks...) once loaded
+    Lockstep_StepFn candidate_step;
+    unsigned long cycle;            // instructions executed by both cores
+    Chip8 reference_snapshot;       // states at the start of the current block
+    Chip8 candidate_snapshot;
+} Lockstep;
+
+typedef struct Lockstep_Divergence
+{
+    unsigned long cycle;            // index of the first divergent instruction
+    Chip8 before;                   // state of both cores before that instruction
+    Chip8 reference;                // states after it
+    Chip8 candidate;
+    int reference_ret;              // values returned by the step functions
+    int candidate_ret;
+} Lockstep_Divergence;
+
+void Lockstep_Init(Lockstep *lockstep, Lockstep_StepFn candidate_step);
+int Lockstep_Load(Lockstep *lockstep, uint8_t *data, unsigned int len);
+int Lockstep_Run(Lockstep *lockstep, unsigned long cycles, unsigned int block_len, Lockstep_Divergence *divergence);
+void Lockstep_PrintDivergence(const Lockstep_Divergence *divergence, FILE *f);
+
+#endif // LOCKSTEP_H
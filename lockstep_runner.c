@@ -0,0 +1,242 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip-8.h"
+#include "lockstep.h"
+
+#define DEFAULT_CYCLES 200000
+#define LOCKSTEP_PATH_MAX_LEN 4096
+
+typedef struct LockstepOptions
+{
+    unsigned long cycles;
+    unsigned int block_len;
+    unsigned int quirks;
+    const char *candidate;
+    char **paths;
+    int path_count;
+} LockstepOptions;
+
+typedef struct LockstepStats
+{
+    unsigned int rom_count;
+    unsigned int divergence_count;
+    unsigned int error_count;
+} LockstepStats;
+
+// an engine checked against the reference, the handler table interpreter run through Chip8_Tick
+typedef struct Candidate
+{
+    const char *name;
+    void (*setup)(Chip8 *chip8);
+    Lockstep_StepFn step;
+} Candidate;
+
+static int ParseOptions(int argc, char **argv, LockstepOptions *options);
+static void PrintUsage(void);
+static void RunPath(const char *path, const Candidate *candidate, LockstepOptions *options, LockstepStats *stats);
+static void CountResult(int ret, LockstepStats *stats);
+static int RunRom(const char *rom_path, const Candidate *candidate, LockstepOptions *options);
+static int CompareNames(const void *a, const void *b);
+static void SetupHooked(Chip8 *chip8);
+
+static const Candidate candidates[] = {
+    {"hooked", SetupHooked, Chip8_Tick},    // hook trampolines dispatch path
+    {"plain", NULL, Chip8_Tick}             // the reference itself, checks the runner
+};
+
+int main(int argc, char **argv)
+{
+    LockstepOptions options;
+    const Candidate *candidate = NULL;
+
+    if (ParseOptions(argc, argv, &options) < 0)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(Candidate); i++)
+    {
+        if (strcmp(candidates[i].name, options.candidate) == 0)
+        {
+            candidate = &candidates[i];
+        }
+    }
+
+    if (!candidate)
+    {
+        printf("Unknown candidate engine: %s\n", options.candidate);
+        return 1;
+    }
+
+    LockstepStats stats = {0};
+
+    for (int i = 0; i < options.path_count; i++)
+    {
+        RunPath(options.paths[i], candidate, &options, &stats);
+    }
+
+    printf("%u ROMs, %u divergences, %u errors (candidate: %s)\n",
+            stats.rom_count, stats.divergence_count, stats.error_count, candidate->name);
+
+    return stats.divergence_count > 0 || stats.error_count > 0;
+}
+
+static int ParseOptions(int argc, char **argv, LockstepOptions *options)
+{
+    memset(options, 0, sizeof(LockstepOptions));
+    options->cycles = DEFAULT_CYCLES;
+    options->block_len = LOCKSTEP_BLOCK_LEN;
+    options->candidate = candidates[0].name;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+
+        if (strcmp(arg, "--cycles") == 0 && i + 1 < argc)
+        {
+            options->cycles = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(arg, "--block") == 0 && i + 1 < argc)
+        {
+            options->block_len = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(arg, "--quirks") == 0 && i + 1 < argc)
+        {
+            options->quirks = strtoul(argv[++i], NULL, 0) & CHIP8_QUIRK_ALL;
+        }
+        else if (strcmp(arg, "--candidate") == 0 && i + 1 < argc)
+        {
+            options->candidate = argv[++i];
+        }
+        else if (arg[0] != '-')
+        {
+            options->paths = argv + i;
+            options->path_count = argc - i;
+            break;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    return options->path_count > 0 && options->block_len > 0 ? 0 : -1;
+}
+
+static void PrintUsage(void)
+{
+    printf("Usage: lockstep_runner [--cycles N] [--block N] [--quirks MASK] [--candidate hooked|plain] ROM_OR_DIR...\n");
+}
+
+static void RunPath(const char *path, const Candidate *candidate, LockstepOptions *options, LockstepStats *stats)
+{
+    DIR *dir = opendir(path);
+
+    if (!dir)
+    {
+        CountResult(RunRom(path, candidate, options), stats);
+        return;
+    }
+
+    struct dirent *ent;
+    char **names = NULL;
+    unsigned int count = 0;
+
+    while ((ent = readdir(dir)) != NULL)
+    {
+        if (ent->d_type == DT_REG)
+        {
+            names = realloc(names, sizeof(char *) * (count + 1));
+            names[count++] = strdup(ent->d_name);
+        }
+    }
+
+    closedir(dir);
+    qsort(names, count, sizeof(char *), CompareNames);
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        char rom_path[LOCKSTEP_PATH_MAX_LEN];
+
+        if (snprintf(rom_path, sizeof(rom_path), "%s/%s", path, names[i]) < (int)sizeof(rom_path))
+        {
+            CountResult(RunRom(rom_path, candidate, options), stats);
+        }
+
+        free(names[i]);
+    }
+
+    free(names);
+}
+
+static void CountResult(int ret, LockstepStats *stats)
+{
+    stats->rom_count++;
+
+    if (ret < 0) stats->error_count++;
+    if (ret > 0) stats->divergence_count++;
+}
+
+// returns 1 if the ROM diverged, 0 if not, -1 on error
+static int RunRom(const char *rom_path, const Candidate *candidate, LockstepOptions *options)
+{
+    FILE *f = fopen(rom_path, "rb");
+
+    if (!f)
+    {
+        printf("Failed to open ROM (path: %s)\n", rom_path);
+        return -1;
+    }
+
+    uint8_t data[RAM_SIZE - PROGRAM_START_ADDR];
+    size_t len = fread(data, 1, sizeof(data), f);
+
+    fclose(f);
+
+    Lockstep *lockstep = malloc(sizeof(Lockstep));
+    Lockstep_Divergence *divergence = malloc(sizeof(Lockstep_Divergence));
+    int ret = 0;
+
+    Lockstep_Init(lockstep, candidate->step);
+
+    if (len == 0 || Lockstep_Load(lockstep, data, len) < 0)
+    {
+        printf("Failed to load ROM (path: %s)\n", rom_path);
+        ret = -1;
+    }
+    else
+    {
+        Chip8_SetQuirks(&lockstep->reference, options->quirks);
+        Chip8_SetQuirks(&lockstep->candidate, options->quirks);
+
+        if (candidate->setup) candidate->setup(&lockstep->candidate);
+
+        if (Lockstep_Run(lockstep, options->cycles, options->block_len, divergence))
+        {
+            printf("%s: ", rom_path);
+            Lockstep_PrintDivergence(divergence, stdout);
+            ret = 1;
+        }
+    }
+
+    free(divergence);
+    free(lockstep);
+
+    return ret;
+}
+
+static int CompareNames(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static void SetupHooked(Chip8 *chip8)
+{
+    Chip8_Hooks hooks = {0};
+
+    Chip8_SetHooks(chip8, &hooks);
+}
@@ -0,0 +1,78 @@
+# profile guided optimisation pipeline, run by the pgo target:
+#
+#   cmake -DSOURCE_DIR=<source dir> -DBINARY_DIR=<work dir> -DC_COMPILER=<compiler> -P pgo.cmake
+#
+# builds an instrumented release core, trains it on the headless workloads (the benchmark ROMs run by headless and
+# bench), rebuilds it with the profile and reports the benchmarks of the optimised build against a release build
+# without PGO
+
+set(PGO_TARGETS headless bench)
+set(PGO_TRAINING_CYCLES 20000000)
+
+set(OPTIMIZED_DIR ${BINARY_DIR}/optimized)
+set(REFERENCE_DIR ${BINARY_DIR}/reference)
+set(PROFILE_DIR ${OPTIMIZED_DIR}/profile)
+
+function(run_step)
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "PGO step failed: ${ARGN}")
+    endif ()
+endfunction()
+
+# both builds go through the same configure and build steps, only the PGO phase differs
+function(build_core dir phase)
+    file(MAKE_DIRECTORY ${dir})
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} ${SOURCE_DIR} -DCMAKE_BUILD_TYPE=Release -DCMAKE_C_COMPILER=${C_COMPILER}
+                -DCHIP8_PGO=${phase} -DCHIP8_PGO_DIR=${PROFILE_DIR}
+        WORKING_DIRECTORY ${dir}
+        OUTPUT_QUIET
+        RESULT_VARIABLE result)
+
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "PGO step failed: configuring ${dir}")
+    endif ()
+
+    foreach(target ${PGO_TARGETS})
+        run_step(${CMAKE_COMMAND} --build ${dir} --target ${target})
+    endforeach()
+endfunction()
+
+# instrumented build, the optimised one later reuses its directory since gcc looks profiles up by object path
+file(REMOVE_RECURSE ${PROFILE_DIR})
+build_core(${OPTIMIZED_DIR} generate)
+
+message(STATUS "Training on the headless workloads")
+file(GLOB BENCH_ROMS ${OPTIMIZED_DIR}/bench_roms/*.ch8)
+
+if (NOT BENCH_ROMS)
+    message(FATAL_ERROR "PGO step failed: no benchmark ROMs in ${OPTIMIZED_DIR}/bench_roms")
+endif ()
+
+foreach(rom ${BENCH_ROMS})
+    run_step(${OPTIMIZED_DIR}/headless --cycles ${PGO_TRAINING_CYCLES} ${rom} OUTPUT_QUIET)
+endforeach()
+
+# gcc profiles each object file on its own, so the benchmark's copy of the core needs its own training run
+run_step(${OPTIMIZED_DIR}/bench OUTPUT_QUIET)
+
+if (C_COMPILER MATCHES "clang")
+    find_program(LLVM_PROFDATA NAMES llvm-profdata)
+
+    if (NOT LLVM_PROFDATA)
+        message(FATAL_ERROR "PGO step failed: llvm-profdata is needed to merge clang profiles")
+    endif ()
+
+    file(GLOB PROFILES ${PROFILE_DIR}/*.profraw)
+    run_step(${LLVM_PROFDATA} merge -output=${PROFILE_DIR}/default.profdata ${PROFILES})
+endif ()
+
+build_core(${OPTIMIZED_DIR} use)
+build_core(${REFERENCE_DIR} "")
+
+message(STATUS "Release build without PGO (${REFERENCE_DIR}):")
+run_step(${REFERENCE_DIR}/bench)
+message(STATUS "Release build with PGO (${OPTIMIZED_DIR}):")
+run_step(${OPTIMIZED_DIR}/bench)
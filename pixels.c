@@ -0,0 +1,54 @@
+#include <string.h>
+
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
+#include "pixels.h"
+
+void Pixels_UnpackScalar(uint8_t *out, const uint8_t *display, const uint8_t on[4], const uint8_t off[4])
+{
+    for (int i = 0; i < DISPLAY_WIDTH * DISPLAY_HEIGHT; i++)
+    {
+        unsigned int lit = (display[i / 8] >> (7 - i % 8)) & 1;
+
+        memcpy(out + i * 4, lit ? on : off, 4);
+    }
+}
+
+#ifdef __wasm_simd128__
+
+// 4 pixels per vector: each 32 bits lane picks the on or off color with the bit of its pixel in the display byte
+void Pixels_Unpack(uint8_t *out, const uint8_t *display, const uint8_t on[4], const uint8_t off[4])
+{
+    uint32_t on_rgba;
+    uint32_t off_rgba;
+
+    memcpy(&on_rgba, on, sizeof(uint32_t));
+    memcpy(&off_rgba, off, sizeof(uint32_t));
+
+    const v128_t on_color = wasm_i32x4_splat(on_rgba);
+    const v128_t off_color = wasm_i32x4_splat(off_rgba);
+    const v128_t high_bits = wasm_i32x4_make(0x80, 0x40, 0x20, 0x10);
+    const v128_t low_bits = wasm_i32x4_make(0x08, 0x04, 0x02, 0x01);
+    const v128_t zero = wasm_i32x4_splat(0);
+
+    for (int i = 0; i < DISPLAY_SIZE; i++)
+    {
+        v128_t byte = wasm_i32x4_splat(display[i]);
+        v128_t high = wasm_i32x4_ne(wasm_v128_and(byte, high_bits), zero);
+        v128_t low = wasm_i32x4_ne(wasm_v128_and(byte, low_bits), zero);
+
+        wasm_v128_store(out + i * 32, wasm_v128_bitselect(on_color, off_color, high));
+        wasm_v128_store(out + i * 32 + 16, wasm_v128_bitselect(on_color, off_color, low));
+    }
+}
+
+#else
+
+void Pixels_Unpack(uint8_t *out, const uint8_t *display, const uint8_t on[4], const uint8_t off[4])
+{
+    Pixels_UnpackScalar(out, display, on, off);
+}
+
+#endif // __wasm_simd128__
@@ -0,0 +1,18 @@
+#ifndef PIXELS_H
+#define PIXELS_H
+
+#include <stdint.h>
+
+#include "chip-8.h"
+
+#define PIXELS_RGBA_SIZE (DISPLAY_WIDTH * DISPLAY_HEIGHT * 4)
+
+/*
+ * Unpacks a 1 bit per pixel display (as Chip8.display) into RGBA pixels, on and off being the 4 bytes of the
+ * colors of lit and unlit pixels. Pixels_Unpack uses wasm SIMD when built with it (-msimd128), 4 pixels at a
+ * time, and Pixels_UnpackScalar otherwise, which stays available to compare both.
+ */
+void Pixels_Unpack(uint8_t *out, const uint8_t *display, const uint8_t on[4], const uint8_t off[4]);
+void Pixels_UnpackScalar(uint8_t *out, const uint8_t *display, const uint8_t on[4], const uint8_t off[4]);
+
+#endif // PIXELS_H
@@ -0,0 +1,239 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "preloader.h"
+
+static int LoadNextSlot(Preloader *preloader);
+static Preloader_Slot *FindSlot(Preloader *preloader, const char *path);
+static int IsRequested(const char *path, const char **paths, unsigned int count);
+static void Lock(Preloader *preloader);
+static void Unlock(Preloader *preloader);
+#ifndef __EMSCRIPTEN__
+static void *RunWorker(void *data);
+#endif
+
+int Preloader_Init(Preloader *preloader)
+{
+    memset(preloader, 0, sizeof(Preloader));
+
+#ifndef __EMSCRIPTEN__
+    pthread_mutex_init(&preloader->mutex, NULL);
+    pthread_cond_init(&preloader->cond, NULL);
+
+    if (pthread_create(&preloader->thread, NULL, RunWorker, preloader) != 0)
+    {
+        pthread_mutex_destroy(&preloader->mutex);
+        pthread_cond_destroy(&preloader->cond);
+        return -1;
+    }
+#endif
+
+    return 0;
+}
+
+void Preloader_Deinit(Preloader *preloader)
+{
+#ifndef __EMSCRIPTEN__
+    Lock(preloader);
+    preloader->quit = 1;
+    pthread_cond_signal(&preloader->cond);
+    Unlock(preloader);
+
+    pthread_join(preloader->thread, NULL);
+    pthread_mutex_destroy(&preloader->mutex);
+    pthread_cond_destroy(&preloader->cond);
+#else
+    (void)preloader;
+#endif
+}
+
+void Preloader_Request(Preloader *preloader, const char **paths, unsigned int count)
+{
+    int changed = 0;
+
+    if (count > PRELOADER_SLOT_COUNT)
+    {
+        count = PRELOADER_SLOT_COUNT;
+    }
+
+    Lock(preloader);
+
+    // free the slots holding ROMs that are no longer wanted
+    for (int i = 0; i < PRELOADER_SLOT_COUNT; i++)
+    {
+        Preloader_Slot *slot = &preloader->slots[i];
+
+        if (slot->state != PRELOADER_SLOT_EMPTY && !IsRequested(slot->path, paths, count))
+        {
+            slot->state = PRELOADER_SLOT_EMPTY;
+            slot->generation++;
+        }
+    }
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (FindSlot(preloader, paths[i]))
+        {
+            continue;
+        }
+
+        Preloader_Slot *slot = FindSlot(preloader, NULL);
+
+        if (!slot) break;
+
+        strncpy(slot->path, paths[i], ROM_PATH_MAX_LEN - 1);
+        slot->path[ROM_PATH_MAX_LEN - 1] = 0;
+        slot->state = PRELOADER_SLOT_PENDING;
+        changed = 1;
+    }
+
+#ifndef __EMSCRIPTEN__
+    if (changed)
+    {
+        pthread_cond_signal(&preloader->cond);
+    }
+#else
+    (void)changed;
+#endif
+
+    Unlock(preloader);
+}
+
+void Preloader_Update(Preloader *preloader)
+{
+#ifdef __EMSCRIPTEN__
+    // no threads, load a single ROM per frame
+    LoadNextSlot(preloader);
+#else
+    (void)preloader;
+#endif
+}
+
+int Preloader_Take(Preloader *preloader, const char *path, Chip8 *chip8)
+{
+    int ret = -1;
+
+    Lock(preloader);
+
+    Preloader_Slot *slot = FindSlot(preloader, path);
+
+    // the slot is kept, so going back to the picker and starting the same ROM again is just as fast
+    if (slot && slot->state == PRELOADER_SLOT_READY)
+    {
+        memcpy(chip8, &slot->chip8, sizeof(Chip8));
+        ret = 0;
+    }
+
+    Unlock(preloader);
+
+    return ret;
+}
+
+// loads a pending slot, returns 0 when there was nothing to load
+static int LoadNextSlot(Preloader *preloader)
+{
+    Preloader_Slot *slot = NULL;
+
+    for (int i = 0; i < PRELOADER_SLOT_COUNT && !slot; i++)
+    {
+        if (preloader->slots[i].state == PRELOADER_SLOT_PENDING)
+        {
+            slot = &preloader->slots[i];
+        }
+    }
+
+    if (!slot)
+    {
+        return 0;
+    }
+
+    char path[ROM_PATH_MAX_LEN];
+    unsigned int generation = slot->generation;
+    Chip8 *chip8 = malloc(sizeof(Chip8));
+
+    strcpy(path, slot->path);
+    slot->state = PRELOADER_SLOT_LOADING;
+
+    // the slot may be reassigned while the ROM is being read, so load it outside of the lock
+    Unlock(preloader);
+
+    Chip8_Init(chip8);
+
+    // loading also hashes the program
+    int ret = Chip8_LoadFromFile(chip8, path);
+
+    Lock(preloader);
+
+    if (slot->generation == generation)
+    {
+        memcpy(&slot->chip8, chip8, sizeof(Chip8));
+        slot->state = ret < 0 ? PRELOADER_SLOT_FAILED : PRELOADER_SLOT_READY;
+    }
+
+    free(chip8);
+
+    return 1;
+}
+
+static Preloader_Slot *FindSlot(Preloader *preloader, const char *path)
+{
+    for (int i = 0; i < PRELOADER_SLOT_COUNT; i++)
+    {
+        Preloader_Slot *slot = &preloader->slots[i];
+
+        if (path ? (slot->state != PRELOADER_SLOT_EMPTY && strcmp(slot->path, path) == 0) : slot->state == PRELOADER_SLOT_EMPTY)
+        {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+static int IsRequested(const char *path, const char **paths, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (strcmp(path, paths[i]) == 0) return 1;
+    }
+
+    return 0;
+}
+
+#ifndef __EMSCRIPTEN__
+
+static void *RunWorker(void *data)
+{
+    Preloader *preloader = data;
+
+    Lock(preloader);
+
+    while (!preloader->quit)
+    {
+        if (!LoadNextSlot(preloader))
+        {
+            pthread_cond_wait(&preloader->cond, &preloader->mutex);
+        }
+    }
+
+    Unlock(preloader);
+
+    return NULL;
+}
+
+static void Lock(Preloader *preloader)
+{
+    pthread_mutex_lock(&preloader->mutex);
+}
+
+static void Unlock(Preloader *preloader)
+{
+    pthread_mutex_unlock(&preloader->mutex);
+}
+
+#else
+
+static void Lock(Preloader *preloader) { (void)preloader; }
+static void Unlock(Preloader *preloader) { (void)preloader; }
+
+#endif // __EMSCRIPTEN__
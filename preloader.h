@@ -0,0 +1,54 @@
+#ifndef PRELOADER_H
+#define PRELOADER_H
+
+#include <stdint.h>
+
+#ifndef __EMSCRIPTEN__
+#include <pthread.h>
+#endif
+
+#include "chip-8.h"
+#include "rom_picker.h"
+
+// the ROM under the cursor and its neighbours
+#define PRELOADER_SLOT_COUNT 3
+
+typedef enum Preloader_SlotState
+{
+    PRELOADER_SLOT_EMPTY,
+    PRELOADER_SLOT_PENDING,
+    PRELOADER_SLOT_LOADING,
+    PRELOADER_SLOT_READY,
+    PRELOADER_SLOT_FAILED
+} Preloader_SlotState;
+
+typedef struct Preloader_Slot
+{
+    char path[ROM_PATH_MAX_LEN];
+    Preloader_SlotState state;
+    unsigned int generation; // bumped when the slot is reassigned while a ROM is being loaded into it
+    Chip8 chip8;
+} Preloader_Slot;
+
+/*
+ * Speculatively loads ROMs into ready to run Chip8 instances, on a background thread
+ * (or a slot per Preloader_Update call when built without threads, e.g. with emscripten).
+ */
+typedef struct Preloader
+{
+    Preloader_Slot slots[PRELOADER_SLOT_COUNT];
+#ifndef __EMSCRIPTEN__
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int quit;
+#endif
+} Preloader;
+
+int Preloader_Init(Preloader *preloader);
+void Preloader_Deinit(Preloader *preloader);
+void Preloader_Request(Preloader *preloader, const char **paths, unsigned int count);
+void Preloader_Update(Preloader *preloader);
+int Preloader_Take(Preloader *preloader, const char *path, Chip8 *chip8);
+
+#endif // PRELOADER_H
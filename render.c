@@ -0,0 +1,75 @@
+#include <stdlib.h>
+
+#include "render.h"
+#include "pixels.h"
+
+const Render_Skin render_skin = {
+    .colors = {
+        (Color){64, 60, 52, 255},
+        (Color){140, 122, 105, 255},
+        (Color){217, 199, 184, 255},
+        (Color){13, 0, 0, 255}
+    }
+};
+
+int Render_LoadDisplay(Render_Display *display)
+{
+    display->pixels = malloc(sizeof(Color) * DISPLAY_WIDTH * DISPLAY_HEIGHT);
+
+    if (!display->pixels)
+    {
+        return -1;
+    }
+
+    display->texture = LoadRenderTexture(DISPLAY_WIDTH, DISPLAY_HEIGHT);
+
+    return 0;
+}
+
+void Render_UnloadDisplay(Render_Display *display)
+{
+    if (display->pixels)
+    {
+        UnloadRenderTexture(display->texture);
+        free(display->pixels);
+        display->pixels = NULL;
+    }
+}
+
+// uploads a 1 bit per pixel display (as Chip8.display) to the texture
+void Render_UpdateDisplay(Render_Display *display, const uint8_t *pixels)
+{
+    // Color is 4 bytes of RGBA
+    Pixels_Unpack((uint8_t *)display->pixels, pixels, (const uint8_t *)&render_skin.colors[3],
+            (const uint8_t *)&render_skin.colors[2]);
+    UpdateTexture(display->texture.texture, display->pixels);
+}
+
+void Render_DrawDisplay(const Render_Display *display)
+{
+    DrawTexturePro(
+            display->texture.texture,
+            (Rectangle){0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT},
+            (Rectangle){0, HUD_TOP_HEIGHT, GAME_WIDTH, GAME_HEIGHT},
+            (Vector2){0, 0},
+            0,
+            WHITE);
+}
+
+// draws the top and bottom bars, bottom_right_text may be NULL
+void Render_DrawHUD(const char *top_text, const char *bottom_left_text, const char *bottom_right_text)
+{
+    int text_w = MeasureText(top_text, HUD_FONT_SIZE);
+
+    DrawRectangle(0, 0, SCREEN_WIDTH, HUD_TOP_HEIGHT, render_skin.colors[1]);
+    DrawRectangle(0, SCREEN_HEIGHT - HUD_BOTTOM_HEIGHT, SCREEN_WIDTH, HUD_BOTTOM_HEIGHT, render_skin.colors[1]);
+    DrawText(top_text, SCREEN_WIDTH / 2 - text_w / 2, 5, HUD_FONT_SIZE, render_skin.colors[2]);
+    DrawText(bottom_left_text, 10, SCREEN_HEIGHT - 18, HUD_FONT_SIZE, render_skin.colors[2]);
+
+    if (bottom_right_text)
+    {
+        int right_text_w = MeasureText(bottom_right_text, HUD_FONT_SIZE);
+
+        DrawText(bottom_right_text, SCREEN_WIDTH - (right_text_w + 5), SCREEN_HEIGHT - 18, HUD_FONT_SIZE, render_skin.colors[2]);
+    }
+}
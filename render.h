@@ -0,0 +1,37 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdint.h>
+
+#include "raylib.h"
+#include "chip-8.h"
+
+#define GAME_WIDTH 640
+#define GAME_HEIGHT 320
+#define HUD_TOP_HEIGHT 25
+#define HUD_BOTTOM_HEIGHT 25
+#define SCREEN_WIDTH GAME_WIDTH
+#define SCREEN_HEIGHT (GAME_HEIGHT + HUD_TOP_HEIGHT + HUD_BOTTOM_HEIGHT)
+#define HUD_FONT_SIZE 15
+
+typedef struct Render_Skin
+{
+    Color colors[4];    // highlight, HUD, background (pixels off), pixels on
+} Render_Skin;
+
+// the Chip-8 display, scaled into the game area of the window
+typedef struct Render_Display
+{
+    Color *pixels;
+    RenderTexture2D texture;
+} Render_Display;
+
+extern const Render_Skin render_skin;
+
+int Render_LoadDisplay(Render_Display *display);
+void Render_UnloadDisplay(Render_Display *display);
+void Render_UpdateDisplay(Render_Display *display, const uint8_t *pixels);
+void Render_DrawDisplay(const Render_Display *display);
+void Render_DrawHUD(const char *top_text, const char *bottom_left_text, const char *bottom_right_text);
+
+#endif // RENDER_H
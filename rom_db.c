@@ -0,0 +1,338 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rom_db.h"
+
+#define ROM_DB_LINE_MAX_LEN 512
+
+typedef struct ParsedSettings
+{
+    RomDb_Settings settings;
+    unsigned int line;
+} ParsedSettings;
+
+typedef struct QuirkName
+{
+    const char *name;
+    unsigned int quirk;
+} QuirkName;
+
+static const QuirkName quirk_names[CHIP8_QUIRK_COUNT] = {
+    {"shift_vy", CHIP8_QUIRK_SHIFT_VY},
+    {"load_store_i", CHIP8_QUIRK_LOAD_STORE_I},
+    {"draw_clip", CHIP8_QUIRK_DRAW_CLIP},
+    {"vf_reset", CHIP8_QUIRK_VF_RESET}
+};
+
+static int ParseLine(char *line, RomDb_Settings *settings, char *error, size_t error_size);
+static int ParseQuirks(char *value, unsigned int *quirks);
+static void MergeSettings(RomDb *db, ParsedSettings *parsed, unsigned int count);
+static void OverrideSettings(RomDb_Settings *settings, const RomDb_Settings *override);
+static void SetError(char *error, size_t error_size, unsigned int line, const char *fmt, ...);
+static int CompareSettings(const void *a, const void *b);
+static int CompareParsedSettings(const void *a, const void *b);
+
+int RomDb_Init(RomDb *db)
+{
+    char error[ROM_DB_ERROR_MAX_LEN];
+
+    memset(db, 0, sizeof(RomDb));
+
+    if (RomDb_Parse(db, rom_db_embedded, error, sizeof(error)) < 0)
+    {
+        fprintf(stderr, "Invalid embedded ROM database (%s)\n", error);
+        return -1;
+    }
+
+    return 0;
+}
+
+void RomDb_Deinit(RomDb *db)
+{
+    free(db->entries);
+    memset(db, 0, sizeof(RomDb));
+}
+
+int RomDb_Parse(RomDb *db, const char *text, char *error, size_t error_size)
+{
+    char line[ROM_DB_LINE_MAX_LEN];
+    unsigned int line_number = 0;
+    ParsedSettings *parsed = NULL;
+    unsigned int count = 0;
+    unsigned int capacity = 0;
+    int ret = 0;
+
+    if (error_size > 0) error[0] = 0;
+
+    while (*text && ret == 0)
+    {
+        size_t len = strcspn(text, "\n");
+
+        line_number++;
+
+        if (len >= sizeof(line))
+        {
+            SetError(error, error_size, line_number, "line too long");
+            ret = -1;
+            break;
+        }
+
+        memcpy(line, text, len);
+        line[len] = 0;
+        text += len + (text[len] == '\n');
+
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            parsed = realloc(parsed, sizeof(ParsedSettings) * capacity);
+        }
+
+        int line_ret = ParseLine(line, &parsed[count].settings, error, error_size);
+
+        if (line_ret < 0)
+        {
+            SetError(error, error_size, line_number, "%s", error);
+            ret = -1;
+        }
+        else if (line_ret > 0)
+        {
+            parsed[count++].line = line_number;
+        }
+    }
+
+    if (ret == 0)
+    {
+        MergeSettings(db, parsed, count);
+    }
+
+    free(parsed);
+
+    return ret;
+}
+
+int RomDb_LoadFile(RomDb *db, const char *path, char *error, size_t error_size)
+{
+    FILE *f = fopen(path, "rb");
+
+    if (!f)
+    {
+        snprintf(error, error_size, "failed to open %s", path);
+        return -1;
+    }
+
+    fseek(f, 0, SEEK_END);
+
+    long size = ftell(f);
+    char *text = malloc(size + 1);
+
+    fseek(f, 0, SEEK_SET);
+    size = fread(text, 1, size, f);
+    text[size] = 0;
+    fclose(f);
+
+    int ret = RomDb_Parse(db, text, error, error_size);
+
+    free(text);
+
+    return ret;
+}
+
+const RomDb_Settings *RomDb_Find(const RomDb *db, uint64_t hash)
+{
+    RomDb_Settings key = {.hash = hash};
+
+    return bsearch(&key, db->entries, db->count, sizeof(RomDb_Settings), CompareSettings);
+}
+
+void RomDb_Apply(const RomDb_Settings *settings, Chip8 *chip8)
+{
+    // the key map is up to the frontend
+    if (settings->fields & ROM_DB_FREQUENCY) Chip8_SetFrequency(chip8, settings->frequency);
+    if (settings->fields & ROM_DB_QUIRKS) Chip8_SetQuirks(chip8, settings->quirks);
+}
+
+// returns 1 when the line holds settings, 0 for blank and comment lines, -1 on error
+static int ParseLine(char *line, RomDb_Settings *settings, char *error, size_t error_size)
+{
+    char *comment = strchr(line, '#');
+    char *save;
+    char *end;
+
+    if (comment) *comment = 0;
+
+    char *token = strtok_r(line, " \t\r", &save);
+
+    memset(settings, 0, sizeof(RomDb_Settings));
+
+    if (!token)
+    {
+        return 0;
+    }
+
+    settings->hash = strtoull(token, &end, 16);
+
+    if (*end || end - token != 16)
+    {
+        snprintf(error, error_size, "invalid hash: %s", token);
+        return -1;
+    }
+
+    while ((token = strtok_r(NULL, " \t\r", &save)) != NULL)
+    {
+        char *value = strchr(token, '=');
+
+        if (!value)
+        {
+            snprintf(error, error_size, "expected name=value: %s", token);
+            return -1;
+        }
+
+        *value++ = 0;
+
+        if (strcmp(token, "frequency") == 0)
+        {
+            settings->frequency = strtod(value, &end);
+
+            if (*end || settings->frequency <= 0)
+            {
+                snprintf(error, error_size, "invalid frequency: %s", value);
+                return -1;
+            }
+
+            settings->fields |= ROM_DB_FREQUENCY;
+        }
+        else if (strcmp(token, "quirks") == 0)
+        {
+            if (ParseQuirks(value, &settings->quirks) < 0)
+            {
+                snprintf(error, error_size, "invalid quirks: %s", value);
+                return -1;
+            }
+
+            settings->fields |= ROM_DB_QUIRKS;
+        }
+        else if (strcmp(token, "keymap") == 0)
+        {
+            if (strlen(value) != ROM_DB_KEYMAP_LEN)
+            {
+                snprintf(error, error_size, "a keymap needs %d keys: %s", ROM_DB_KEYMAP_LEN, value);
+                return -1;
+            }
+
+            strcpy(settings->keymap, value);
+            settings->fields |= ROM_DB_KEYMAP;
+        }
+        else
+        {
+            snprintf(error, error_size, "unknown setting: %s", token);
+            return -1;
+        }
+    }
+
+    return 1;
+}
+
+static int ParseQuirks(char *value, unsigned int *quirks)
+{
+    char *save;
+
+    *quirks = 0;
+
+    if (strcmp(value, "none") == 0)
+    {
+        return 0;
+    }
+
+    for (char *name = strtok_r(value, ",", &save); name; name = strtok_r(NULL, ",", &save))
+    {
+        int found = 0;
+
+        for (int i = 0; i < CHIP8_QUIRK_COUNT && !found; i++)
+        {
+            if (strcmp(name, quirk_names[i].name) == 0)
+            {
+                *quirks |= quirk_names[i].quirk;
+                found = 1;
+            }
+        }
+
+        if (!found) return -1;
+    }
+
+    return 0;
+}
+
+static void MergeSettings(RomDb *db, ParsedSettings *parsed, unsigned int count)
+{
+    unsigned int known_count = db->count;
+
+    // sorted by hash then line, so the last line of a ROM wins
+    qsort(parsed, count, sizeof(ParsedSettings), CompareParsedSettings);
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        RomDb_Settings *settings = &parsed[i].settings;
+        RomDb_Settings *known = bsearch(settings, db->entries, known_count, sizeof(RomDb_Settings), CompareSettings);
+
+        if (known)
+        {
+            OverrideSettings(known, settings);
+        }
+        else if (db->count > known_count && db->entries[db->count - 1].hash == settings->hash)
+        {
+            OverrideSettings(&db->entries[db->count - 1], settings);
+        }
+        else
+        {
+            if (db->count == db->capacity)
+            {
+                db->capacity = db->capacity ? db->capacity * 2 : 64;
+                db->entries = realloc(db->entries, sizeof(RomDb_Settings) * db->capacity);
+            }
+
+            db->entries[db->count++] = *settings;
+        }
+    }
+
+    qsort(db->entries, db->count, sizeof(RomDb_Settings), CompareSettings);
+}
+
+static void OverrideSettings(RomDb_Settings *settings, const RomDb_Settings *override)
+{
+    if (override->fields & ROM_DB_FREQUENCY) settings->frequency = override->frequency;
+    if (override->fields & ROM_DB_QUIRKS) settings->quirks = override->quirks;
+    if (override->fields & ROM_DB_KEYMAP) strcpy(settings->keymap, override->keymap);
+
+    settings->fields |= override->fields;
+}
+
+static void SetError(char *error, size_t error_size, unsigned int line, const char *fmt, ...)
+{
+    char message[ROM_DB_ERROR_MAX_LEN];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(message, sizeof(message), fmt, args);
+    va_end(args);
+
+    snprintf(error, error_size, "line %u: %s", line, message);
+}
+
+static int CompareSettings(const void *a, const void *b)
+{
+    uint64_t hash_a = ((const RomDb_Settings *)a)->hash;
+    uint64_t hash_b = ((const RomDb_Settings *)b)->hash;
+
+    return (hash_a > hash_b) - (hash_a < hash_b);
+}
+
+static int CompareParsedSettings(const void *a, const void *b)
+{
+    const ParsedSettings *parsed_a = a;
+    const ParsedSettings *parsed_b = b;
+    int ret = CompareSettings(&parsed_a->settings, &parsed_b->settings);
+
+    return ret ? ret : (int)parsed_a->line - (int)parsed_b->line;
+}
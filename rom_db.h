@@ -0,0 +1,54 @@
+#ifndef ROM_DB_H
+#define ROM_DB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip-8.h"
+
+#define ROM_DB_KEYMAP_LEN 16
+#define ROM_DB_ERROR_MAX_LEN 256
+
+// which settings of an entry are set, the others keep the emulator defaults
+#define ROM_DB_FREQUENCY (1 << 0)
+#define ROM_DB_QUIRKS (1 << 1)
+#define ROM_DB_KEYMAP (1 << 2)
+
+typedef struct RomDb_Settings
+{
+    uint64_t hash;                          // Chip8_Hash of the ROM
+    unsigned int fields;                    // ROM_DB_FREQUENCY | ROM_DB_QUIRKS | ROM_DB_KEYMAP
+    double frequency;
+    unsigned int quirks;                    // Chip8_Quirk flags
+    char keymap[ROM_DB_KEYMAP_LEN + 1];     // keyboard character for each chip-8 key, from 0 to F
+} RomDb_Settings;
+
+typedef struct RomDb
+{
+    RomDb_Settings *entries;                // sorted by hash
+    unsigned int count;
+    unsigned int capacity;
+} RomDb;
+
+/*
+ * The embedded database and the user override files share the same text format, one ROM per line:
+ *
+ *   # comment
+ *   <hash> [frequency=<hz>] [quirks=none|<quirk>,...] [keymap=<16 characters>]
+ *
+ * - hash is the 64 bits hexadecimal Chip8_Hash of the ROM (as printed by the emulator when loading it)
+ * - quirks are shift_vy, load_store_i, draw_clip and vf_reset (see Chip8_Quirk)
+ * - keymap gives the keyboard key of each chip-8 key, from 0 to F (e.g. x123qweasdzc4rfv)
+ *
+ * Settings of a ROM loaded later override the ones already known for it, field by field.
+ */
+extern const char rom_db_embedded[];
+
+int RomDb_Init(RomDb *db);
+void RomDb_Deinit(RomDb *db);
+int RomDb_Parse(RomDb *db, const char *text, char *error, size_t error_size);
+int RomDb_LoadFile(RomDb *db, const char *path, char *error, size_t error_size);
+const RomDb_Settings *RomDb_Find(const RomDb *db, uint64_t hash);
+void RomDb_Apply(const RomDb_Settings *settings, Chip8 *chip8);
+
+#endif // ROM_DB_H
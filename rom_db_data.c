@@ -0,0 +1,9 @@
+#include "rom_db.h"
+
+/*
+ * Settings known to be required by specific ROMs, see rom_db.h for the format.
+ *
+ * Entries are keyed by the hash of the exact ROM file, only add ROMs that were hashed and tested.
+ */
+const char rom_db_embedded[] =
+    "# hash            settings\n";
@@ -0,0 +1,296 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rom_pack.h"
+
+#define ROM_PACK_PATH_MAX_LEN 4096
+
+static int ValidatePack(RomPack *pack);
+static int CompareEntries(const void *a, const void *b);
+static int ReadRom(const char *roms_dir, RomPack_IndexEntry *entry, uint8_t *data);
+static void SwapHeader(RomPack_Header *header);
+static void SwapEntries(RomPack_IndexEntry *entries, uint32_t count);
+
+_Static_assert(sizeof(RomPack_Header) == 16, "the pack header must stay 16 bytes");
+_Static_assert(sizeof(RomPack_IndexEntry) == ROM_PACK_NAME_MAX_LEN + 16, "index entries must not get padding");
+
+int RomPack_Open(RomPack *pack, const char *path)
+{
+    memset(pack, 0, sizeof(RomPack));
+
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(RomPack_Header))
+    {
+        close(fd);
+        return -1;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping stays valid once the file is closed
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    pack->data = data;
+    pack->size = st.st_size;
+
+    if (ValidatePack(pack) < 0)
+    {
+        RomPack_Close(pack);
+        return -1;
+    }
+
+    return 0;
+}
+
+void RomPack_Close(RomPack *pack)
+{
+    if (pack->data)
+    {
+        munmap((void *)pack->data, pack->size);
+    }
+
+    free(pack->converted);
+
+    memset(pack, 0, sizeof(RomPack));
+}
+
+const RomPack_IndexEntry *RomPack_Find(const RomPack *pack, const char *name)
+{
+    RomPack_IndexEntry key;
+
+    // no entry can have a longer name, truncating it could match another one
+    if (strlen(name) >= ROM_PACK_NAME_MAX_LEN)
+    {
+        return NULL;
+    }
+
+    strcpy(key.name, name);
+
+    return bsearch(&key, pack->index, pack->rom_count, sizeof(RomPack_IndexEntry), CompareEntries);
+}
+
+int Chip8_LoadFromPack(Chip8 *chip8, const RomPack *pack, const char *name)
+{
+    const RomPack_IndexEntry *entry = RomPack_Find(pack, name);
+
+    if (!entry)
+    {
+        return -1;
+    }
+
+    return Chip8_Load(chip8, (uint8_t *)pack->data + entry->offset, entry->length);
+}
+
+int RomPack_Build(const char *roms_dir, const char *pack_path)
+{
+    DIR *dir = opendir(roms_dir);
+    struct dirent *ent;
+    RomPack_IndexEntry *entries = NULL;
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+
+    if (!dir)
+    {
+        return -1;
+    }
+
+    while ((ent = readdir(dir)) != NULL)
+    {
+        if (ent->d_type != DT_REG)
+        {
+            continue;
+        }
+
+        if (strlen(ent->d_name) >= ROM_PACK_NAME_MAX_LEN)
+        {
+            fprintf(stderr, "Skipping %s (name too long)\n", ent->d_name);
+            continue;
+        }
+
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            entries = realloc(entries, sizeof(RomPack_IndexEntry) * capacity);
+        }
+
+        memset(&entries[count], 0, sizeof(RomPack_IndexEntry));
+        strcpy(entries[count].name, ent->d_name);
+        count++;
+    }
+
+    closedir(dir);
+    qsort(entries, count, sizeof(RomPack_IndexEntry), CompareEntries);
+
+    FILE *f = fopen(pack_path, "wb");
+
+    if (!f)
+    {
+        free(entries);
+        return -1;
+    }
+
+    RomPack_Header header = {.version = ROM_PACK_VERSION, .rom_count = count, .index_offset = sizeof(RomPack_Header)};
+    uint32_t offset = header.index_offset + sizeof(RomPack_IndexEntry) * count;
+    uint8_t data[RAM_SIZE - PROGRAM_START_ADDR];
+    int ret = 0;
+
+    memcpy(header.magic, ROM_PACK_MAGIC, sizeof(header.magic));
+
+    // payloads first (the index is only complete once every ROM has been read), then header and index
+    fseek(f, offset, SEEK_SET);
+
+    for (uint32_t i = 0; i < count && ret == 0; i++)
+    {
+        if (ReadRom(roms_dir, &entries[i], data) < 0)
+        {
+            fprintf(stderr, "Failed to read ROM (name: %s)\n", entries[i].name);
+            ret = -1;
+            break;
+        }
+
+        entries[i].offset = offset;
+        entries[i].hash = Chip8_Hash(data, entries[i].length);
+        offset += entries[i].length;
+
+        if (fwrite(data, 1, entries[i].length, f) != entries[i].length) ret = -1;
+    }
+
+    fseek(f, 0, SEEK_SET);
+    SwapHeader(&header);
+    SwapEntries(entries, count);
+
+    if (ret == 0 && (fwrite(&header, sizeof(RomPack_Header), 1, f) != 1 ||
+            fwrite(entries, sizeof(RomPack_IndexEntry), count, f) != count))
+    {
+        ret = -1;
+    }
+
+    if (fclose(f) != 0) ret = -1;
+
+    free(entries);
+
+    return ret;
+}
+
+static int ValidatePack(RomPack *pack)
+{
+    RomPack_Header header;
+
+    memcpy(&header, pack->data, sizeof(RomPack_Header));
+    SwapHeader(&header);
+
+    if (memcmp(header.magic, ROM_PACK_MAGIC, sizeof(header.magic)) != 0 || header.version != ROM_PACK_VERSION)
+    {
+        return -1;
+    }
+
+    // the index is read in place, so it must be aligned for its entries
+    if (header.index_offset > pack->size ||
+            header.index_offset % _Alignof(RomPack_IndexEntry) != 0 ||
+            (pack->size - header.index_offset) / sizeof(RomPack_IndexEntry) < header.rom_count)
+    {
+        return -1;
+    }
+
+    pack->index = (const RomPack_IndexEntry *)(pack->data + header.index_offset);
+    pack->rom_count = header.rom_count;
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    pack->converted = malloc(sizeof(RomPack_IndexEntry) * (pack->rom_count ? pack->rom_count : 1));
+
+    if (!pack->converted)
+    {
+        return -1;
+    }
+
+    memcpy(pack->converted, pack->index, sizeof(RomPack_IndexEntry) * pack->rom_count);
+    SwapEntries(pack->converted, pack->rom_count);
+    pack->index = pack->converted;
+#endif
+
+    // check every entry once here so loads can trust the index
+    for (uint32_t i = 0; i < pack->rom_count; i++)
+    {
+        const RomPack_IndexEntry *entry = &pack->index[i];
+
+        if (entry->name[ROM_PACK_NAME_MAX_LEN - 1] != 0 ||
+                entry->offset > pack->size ||
+                entry->length > pack->size - entry->offset ||
+                entry->length > RAM_SIZE - PROGRAM_START_ADDR)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int CompareEntries(const void *a, const void *b)
+{
+    return strcmp(((const RomPack_IndexEntry *)a)->name, ((const RomPack_IndexEntry *)b)->name);
+}
+
+static int ReadRom(const char *roms_dir, RomPack_IndexEntry *entry, uint8_t *data)
+{
+    char path[ROM_PACK_PATH_MAX_LEN];
+
+    snprintf(path, sizeof(path), "%s/%s", roms_dir, entry->name);
+
+    FILE *f = fopen(path, "rb");
+
+    if (!f)
+    {
+        return -1;
+    }
+
+    entry->length = fread(data, 1, RAM_SIZE - PROGRAM_START_ADDR, f);
+    fclose(f);
+
+    return 0;
+}
+
+// converts between the host and the file byte order, both ways, nothing to do on little endian hosts
+static void SwapHeader(RomPack_Header *header)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    header->version = __builtin_bswap32(header->version);
+    header->rom_count = __builtin_bswap32(header->rom_count);
+    header->index_offset = __builtin_bswap32(header->index_offset);
+#else
+    (void)header;
+#endif
+}
+
+static void SwapEntries(RomPack_IndexEntry *entries, uint32_t count)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (uint32_t i = 0; i < count; i++)
+    {
+        entries[i].hash = __builtin_bswap64(entries[i].hash);
+        entries[i].offset = __builtin_bswap32(entries[i].offset);
+        entries[i].length = __builtin_bswap32(entries[i].length);
+    }
+#else
+    (void)entries;
+    (void)count;
+#endif
+}
@@ -0,0 +1,55 @@
+#ifndef ROM_PACK_H
+#define ROM_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip-8.h"
+
+#define ROM_PACK_MAGIC "C8PK"
+#define ROM_PACK_VERSION 1
+#define ROM_PACK_NAME_MAX_LEN 48
+
+/*
+ * A ROM pack is a single file made of:
+ *
+ * - a RomPack_Header
+ * - rom_count RomPack_IndexEntry, sorted by name
+ * - the ROMs contents, one after the other
+ *
+ * Header and index fields are stored little endian, without padding beyond what the structs below have. The pack
+ * is mapped in memory as a whole so loading a ROM from it is a lookup and a copy; big endian hosts read the index
+ * from a converted copy instead of in place.
+ */
+typedef struct RomPack_Header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t rom_count;
+    uint32_t index_offset;
+} RomPack_Header;
+
+typedef struct RomPack_IndexEntry
+{
+    char name[ROM_PACK_NAME_MAX_LEN];   // NUL terminated
+    uint64_t hash;                      // Chip8_Hash of the ROM
+    uint32_t offset;                    // from the start of the file
+    uint32_t length;
+} RomPack_IndexEntry;
+
+typedef struct RomPack
+{
+    const uint8_t *data;
+    size_t size;
+    const RomPack_IndexEntry *index;
+    uint32_t rom_count;
+    RomPack_IndexEntry *converted;      // index in the host byte order on big endian hosts, NULL otherwise
+} RomPack;
+
+int RomPack_Open(RomPack *pack, const char *path);
+void RomPack_Close(RomPack *pack);
+const RomPack_IndexEntry *RomPack_Find(const RomPack *pack, const char *name);
+int RomPack_Build(const char *roms_dir, const char *pack_path);
+int Chip8_LoadFromPack(Chip8 *chip8, const RomPack *pack, const char *name);
+
+#endif // ROM_PACK_H
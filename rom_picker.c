@@ -1,56 +1,535 @@
-#include <dirent.h>
+#include <ctype.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
 
+#include "chip-8.h"
 #include "rom_picker.h"
 
-void RomPicker_Init(RomPicker *picker, const char *roms_path)
+#define ROM_PICKER_CACHE_HEADER "C8PC 1"
+
+static void ScanStep(RomPicker *picker);
+static void FinishScan(RomPicker *picker);
+static void MetadataStep(RomPicker *picker);
+static int UpdateMetadata(RomPicker *picker, RomPicker_Entry *entry);
+static int LoadCache(RomPicker *picker);
+static int SaveCache(RomPicker *picker);
+static RomPicker_Entry *FindEntry(RomPicker *picker, const char *name);
+static void ReserveEntries(RomPicker *picker, unsigned int count);
+static void MergePending(RomPicker *picker, RomPicker_Entry *pending, unsigned int count);
+static void RefreshVisible(RomPicker *picker);
+static void UpdateSelection(RomPicker *picker);
+static int MatchesFilter(const char *name, const char *filter);
+static int CompareEntries(const void *a, const void *b);
+
+int RomPicker_Init(RomPicker *picker, const char *roms_path, unsigned int viewport_rows)
 {
-    picker->rom_count = 0;
-    picker->cursor = 0;
+    memset(picker, 0, sizeof(RomPicker));
 
     strncpy(picker->roms_path, roms_path, ROM_PATH_MAX_LEN - 1);
+    snprintf(picker->cache_path, ROM_PATH_MAX_LEN, "%s/%s", roms_path, ROM_PICKER_CACHE_FILE);
+    picker->viewport_rows = viewport_rows;
+
+    // the cached entries are listed right away, the scan then adds new ROMs and drops deleted ones
+    LoadCache(picker);
 
-    DIR *dir = opendir(roms_path);
-    struct dirent *ent;
+    picker->dir = opendir(roms_path);
 
-    if (!dir)
+    if (!picker->dir)
     {
         fprintf(stderr, "Failed to read ROMs directory\n");
-        abort();
+        RomPicker_Deinit(picker);
+        return -1;
+    }
+
+    RefreshVisible(picker);
+
+    return 0;
+}
+
+void RomPicker_Deinit(RomPicker *picker)
+{
+    if (picker->dir)
+    {
+        closedir(picker->dir);
+        picker->dir = NULL;
+    }
+
+    // entries are only dropped once a scan completes, so saving during a scan loses nothing
+    if (picker->cache_dirty)
+    {
+        SaveCache(picker);
+    }
+
+    for (unsigned int i = 0; i < picker->rom_count; i++)
+    {
+        free(picker->entries[i].name);
     }
 
-    while ((ent = readdir(dir)) != NULL && picker->rom_count < MAX_ROMS)
+    free(picker->entries);
+    free(picker->visible);
+    memset(picker, 0, sizeof(RomPicker));
+}
+
+void RomPicker_Update(RomPicker *picker)
+{
+    if (picker->dir)
+    {
+        ScanStep(picker);
+    }
+    else if (picker->metadata_cursor < picker->rom_count)
     {
-        if (ent->d_type == DT_REG)
+        MetadataStep(picker);
+    }
+    else if (picker->cache_dirty)
+    {
+        if (SaveCache(picker) < 0)
         {
-            strncpy(picker->roms[picker->rom_count], ent->d_name, ROM_NAME_MAX_LEN - 1);
-            picker->rom_count++;
+            fprintf(stderr, "Failed to save ROM picker cache (path: %s)\n", picker->cache_path);
         }
+
+        picker->cache_dirty = 0;
     }
+}
 
-    closedir(dir);
+int RomPicker_IsScanning(RomPicker *picker)
+{
+    return picker->dir != NULL;
 }
 
 void RomPicker_Up(RomPicker *picker)
 {
-    picker->cursor = (picker->cursor - 1 + MAX_ROMS) % MAX_ROMS;
+    if (picker->visible_count == 0) return;
+
+    picker->cursor = (picker->cursor - 1 + picker->visible_count) % picker->visible_count;
+    UpdateSelection(picker);
 }
 
 void RomPicker_Down(RomPicker *picker)
 {
-    picker->cursor = (picker->cursor + 1) % MAX_ROMS;
+    if (picker->visible_count == 0) return;
+
+    picker->cursor = (picker->cursor + 1) % picker->visible_count;
+    UpdateSelection(picker);
+}
+
+void RomPicker_PageUp(RomPicker *picker)
+{
+    if (picker->visible_count == 0) return;
+
+    picker->cursor = picker->cursor > picker->viewport_rows ? picker->cursor - picker->viewport_rows : 0;
+    UpdateSelection(picker);
+}
+
+void RomPicker_PageDown(RomPicker *picker)
+{
+    if (picker->visible_count == 0) return;
+
+    picker->cursor += picker->viewport_rows;
+
+    if (picker->cursor >= picker->visible_count)
+    {
+        picker->cursor = picker->visible_count - 1;
+    }
+
+    UpdateSelection(picker);
+}
+
+void RomPicker_SetFilter(RomPicker *picker, const char *filter)
+{
+    strncpy(picker->filter, filter, ROM_PICKER_FILTER_MAX_LEN - 1);
+    picker->filter[ROM_PICKER_FILTER_MAX_LEN - 1] = 0;
+    RefreshVisible(picker);
+}
+
+void RomPicker_FilterAppend(RomPicker *picker, char c)
+{
+    size_t len = strlen(picker->filter);
+
+    if (len < ROM_PICKER_FILTER_MAX_LEN - 1)
+    {
+        picker->filter[len] = c;
+        picker->filter[len + 1] = 0;
+        RefreshVisible(picker);
+    }
+}
+
+void RomPicker_FilterErase(RomPicker *picker)
+{
+    size_t len = strlen(picker->filter);
+
+    if (len > 0)
+    {
+        picker->filter[len - 1] = 0;
+        RefreshVisible(picker);
+    }
+}
+
+const RomPicker_Entry *RomPicker_GetVisibleEntry(RomPicker *picker, unsigned int index)
+{
+    return index < picker->visible_count ? &picker->entries[picker->visible[index]] : NULL;
 }
 
-void RomPicker_GetSelectedPath(RomPicker *picker, char rom_path[ROM_PATH_MAX_LEN])
+const RomPicker_Entry *RomPicker_GetSelectedEntry(RomPicker *picker)
 {
-    const char *selected_rom = picker->roms[picker->cursor];
+    return RomPicker_GetVisibleEntry(picker, picker->cursor);
+}
+
+int RomPicker_GetVisiblePath(RomPicker *picker, unsigned int index, char rom_path[ROM_PATH_MAX_LEN])
+{
+    const RomPicker_Entry *entry = RomPicker_GetVisibleEntry(picker, index);
+
+    if (!entry)
+    {
+        return -1;
+    }
 
-    snprintf(rom_path, ROM_PATH_MAX_LEN, "%s/%s", picker->roms_path, selected_rom);
+    if (snprintf(rom_path, ROM_PATH_MAX_LEN, "%s/%s", picker->roms_path, entry->name) >= ROM_PATH_MAX_LEN)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int RomPicker_GetSelectedPath(RomPicker *picker, char rom_path[ROM_PATH_MAX_LEN])
+{
+    return RomPicker_GetVisiblePath(picker, picker->cursor, rom_path);
 }
 
 const char *RomPicker_GetSelectedRomName(RomPicker *picker)
 {
-    return picker->roms[picker->cursor];
+    const RomPicker_Entry *entry = RomPicker_GetSelectedEntry(picker);
+
+    return entry ? entry->name : "";
+}
+
+void RomPicker_MarkPlayed(RomPicker *picker)
+{
+    if (picker->cursor < picker->visible_count)
+    {
+        picker->entries[picker->visible[picker->cursor]].last_played = time(NULL);
+        picker->cache_dirty = 1;
+    }
+}
+
+static void ScanStep(RomPicker *picker)
+{
+    RomPicker_Entry pending[ROM_PICKER_SCAN_BATCH];
+    unsigned int count = 0;
+    int done = 0;
+
+    for (int i = 0; i < ROM_PICKER_SCAN_BATCH; i++)
+    {
+        struct dirent *ent = readdir(picker->dir);
+
+        if (!ent)
+        {
+            done = 1;
+            break;
+        }
+
+        // skip hidden files (including the cache) and names the cache cannot store
+        if (ent->d_type != DT_REG || ent->d_name[0] == '.' || strchr(ent->d_name, '\n'))
+        {
+            continue;
+        }
+
+        RomPicker_Entry *entry = FindEntry(picker, ent->d_name);
+
+        if (entry)
+        {
+            entry->seen = 1;
+            continue;
+        }
+
+        memset(&pending[count], 0, sizeof(RomPicker_Entry));
+        pending[count].name = strdup(ent->d_name);
+        pending[count].seen = 1;
+        count++;
+    }
+
+    qsort(pending, count, sizeof(RomPicker_Entry), CompareEntries);
+    MergePending(picker, pending, count);
+
+    if (done)
+    {
+        FinishScan(picker);
+    }
+}
+
+static void FinishScan(RomPicker *picker)
+{
+    unsigned int count = 0;
+
+    closedir(picker->dir);
+    picker->dir = NULL;
+
+    // drop the cached entries of deleted ROMs
+    for (unsigned int i = 0; i < picker->rom_count; i++)
+    {
+        if (picker->entries[i].seen)
+        {
+            picker->entries[count++] = picker->entries[i];
+        }
+        else
+        {
+            free(picker->entries[i].name);
+            picker->cache_dirty = 1;
+        }
+    }
+
+    picker->rom_count = count;
+    picker->metadata_cursor = 0;
+    RefreshVisible(picker);
+}
+
+static void MetadataStep(RomPicker *picker)
+{
+    unsigned int reads = 0;
+
+    for (int i = 0; i < ROM_PICKER_SCAN_BATCH && reads < ROM_PICKER_METADATA_BATCH; i++)
+    {
+        if (picker->metadata_cursor >= picker->rom_count) break;
+
+        RomPicker_Entry *entry = &picker->entries[picker->metadata_cursor++];
+
+        if (!entry->checked)
+        {
+            reads += UpdateMetadata(picker, entry);
+        }
+    }
+}
+
+// returns 1 when the ROM had to be read (its cached metadata was missing or stale)
+static int UpdateMetadata(RomPicker *picker, RomPicker_Entry *entry)
+{
+    char path[ROM_PATH_MAX_LEN];
+    struct stat st;
+
+    entry->checked = 1;
+    if (snprintf(path, ROM_PATH_MAX_LEN, "%s/%s", picker->roms_path, entry->name) >= ROM_PATH_MAX_LEN ||
+            stat(path, &st) < 0)
+    {
+        return 0;
+    }
+
+    if ((uint32_t)st.st_size == entry->size && (int64_t)st.st_mtime == entry->mtime)
+    {
+        return 0;
+    }
+
+    FILE *f = fopen(path, "rb");
+
+    if (!f)
+    {
+        return 0;
+    }
+
+    uint8_t data[RAM_SIZE - PROGRAM_START_ADDR];
+    unsigned int len = fread(data, 1, sizeof(data), f);
+
+    fclose(f);
+
+    entry->size = st.st_size;
+    entry->mtime = st.st_mtime;
+    entry->hash = Chip8_Hash(data, len);
+    picker->cache_dirty = 1;
+
+    return 1;
+}
+
+static int LoadCache(RomPicker *picker)
+{
+    FILE *f = fopen(picker->cache_path, "r");
+    char line[ROM_NAME_MAX_LEN + 128];
+
+    if (!f)
+    {
+        return -1;
+    }
+
+    if (!fgets(line, sizeof(line), f) || strncmp(line, ROM_PICKER_CACHE_HEADER, strlen(ROM_PICKER_CACHE_HEADER)) != 0)
+    {
+        fclose(f);
+        return -1;
+    }
+
+    // one line per ROM: hash size mtime last_played name
+    while (fgets(line, sizeof(line), f))
+    {
+        RomPicker_Entry entry = {0};
+        int name_offset = 0;
+
+        line[strcspn(line, "\n")] = 0;
+
+        if (sscanf(line, "%" SCNx64 " %" SCNu32 " %" SCNd64 " %" SCNd64 " %n",
+                    &entry.hash, &entry.size, &entry.mtime, &entry.last_played, &name_offset) != 4 ||
+                name_offset == 0 || line[name_offset] == 0)
+        {
+            continue;
+        }
+
+        ReserveEntries(picker, picker->rom_count + 1);
+        entry.name = strdup(line + name_offset);
+        picker->entries[picker->rom_count++] = entry;
+    }
+
+    fclose(f);
+    qsort(picker->entries, picker->rom_count, sizeof(RomPicker_Entry), CompareEntries);
+
+    return 0;
+}
+
+static int SaveCache(RomPicker *picker)
+{
+    char tmp_path[ROM_PATH_MAX_LEN + 4];
+
+    // write the whole cache then swap it in, so an interrupted save never leaves a truncated cache
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", picker->cache_path);
+
+    FILE *f = fopen(tmp_path, "w");
+
+    if (!f)
+    {
+        return -1;
+    }
+
+    fprintf(f, "%s\n", ROM_PICKER_CACHE_HEADER);
+
+    for (unsigned int i = 0; i < picker->rom_count; i++)
+    {
+        RomPicker_Entry *entry = &picker->entries[i];
+
+        fprintf(f, "%016" PRIx64 " %" PRIu32 " %" PRId64 " %" PRId64 " %s\n",
+                entry->hash, entry->size, entry->mtime, entry->last_played, entry->name);
+    }
+
+    if (fclose(f) != 0 || rename(tmp_path, picker->cache_path) < 0)
+    {
+        remove(tmp_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+static RomPicker_Entry *FindEntry(RomPicker *picker, const char *name)
+{
+    RomPicker_Entry key = {.name = (char *)name};
+
+    return bsearch(&key, picker->entries, picker->rom_count, sizeof(RomPicker_Entry), CompareEntries);
+}
+
+static void ReserveEntries(RomPicker *picker, unsigned int count)
+{
+    if (count <= picker->capacity) return;
+
+    while (picker->capacity < count)
+    {
+        picker->capacity = picker->capacity ? picker->capacity * 2 : 256;
+    }
+
+    picker->entries = realloc(picker->entries, sizeof(RomPicker_Entry) * picker->capacity);
+    picker->visible = realloc(picker->visible, sizeof(unsigned int) * picker->capacity);
+}
+
+static void MergePending(RomPicker *picker, RomPicker_Entry *pending, unsigned int count)
+{
+    if (count == 0) return;
+
+    ReserveEntries(picker, picker->rom_count + count);
+
+    // both lists are sorted, merge from the back so it can be done in place
+    int i = picker->rom_count - 1;
+    int j = count - 1;
+
+    for (int k = picker->rom_count + count - 1; j >= 0; k--)
+    {
+        if (i >= 0 && CompareEntries(&picker->entries[i], &pending[j]) > 0)
+        {
+            picker->entries[k] = picker->entries[i--];
+        }
+        else
+        {
+            picker->entries[k] = pending[j--];
+        }
+    }
+
+    picker->rom_count += count;
+    picker->cache_dirty = 1;
+    RefreshVisible(picker);
+}
+
+static void RefreshVisible(RomPicker *picker)
+{
+    picker->visible_count = 0;
+    picker->cursor = 0;
+
+    for (unsigned int i = 0; i < picker->rom_count; i++)
+    {
+        if (MatchesFilter(picker->entries[i].name, picker->filter))
+        {
+            // keep the cursor on the selected ROM when entries are added or the filter changes
+            if (strcmp(picker->entries[i].name, picker->selected_name) == 0)
+            {
+                picker->cursor = picker->visible_count;
+            }
+
+            picker->visible[picker->visible_count++] = i;
+        }
+    }
+
+    UpdateSelection(picker);
+}
+
+static void UpdateSelection(RomPicker *picker)
+{
+    const RomPicker_Entry *entry = RomPicker_GetSelectedEntry(picker);
+
+    if (entry)
+    {
+        strncpy(picker->selected_name, entry->name, ROM_NAME_MAX_LEN - 1);
+    }
+
+    // scroll the viewport so the cursor stays visible
+    if (picker->cursor < picker->scroll)
+    {
+        picker->scroll = picker->cursor;
+    }
+    else if (picker->cursor >= picker->scroll + picker->viewport_rows)
+    {
+        picker->scroll = picker->cursor - picker->viewport_rows + 1;
+    }
+
+    if (picker->scroll + picker->viewport_rows > picker->visible_count)
+    {
+        picker->scroll = picker->visible_count > picker->viewport_rows ? picker->visible_count - picker->viewport_rows : 0;
+    }
+}
+
+static int MatchesFilter(const char *name, const char *filter)
+{
+    // case insensitive substring search
+    for (; *name; name++)
+    {
+        int i = 0;
+
+        while (filter[i] && name[i] && tolower((unsigned char)name[i]) == tolower((unsigned char)filter[i]))
+        {
+            i++;
+        }
+
+        if (!filter[i]) return 1;
+    }
+
+    return filter[0] == 0;
+}
+
+static int CompareEntries(const void *a, const void *b)
+{
+    return strcmp(((const RomPicker_Entry *)a)->name, ((const RomPicker_Entry *)b)->name);
 }
@@ -1,22 +1,64 @@
 #ifndef ROM_PICKER_H
 #define ROM_PICKER_H
 
-#define MAX_ROMS 16
-#define ROM_PATH_MAX_LEN 255
-#define ROM_NAME_MAX_LEN 25
+#include <dirent.h>
+#include <stdint.h>
+
+#define ROM_PATH_MAX_LEN 4096
+#define ROM_NAME_MAX_LEN 256
+#define ROM_PICKER_FILTER_MAX_LEN 64
+#define ROM_PICKER_CACHE_FILE ".rom_picker_cache"
+
+// work done by a single call to RomPicker_Update, so scanning a large directory never blocks a frame
+#define ROM_PICKER_SCAN_BATCH 256
+#define ROM_PICKER_METADATA_BATCH 16
+
+typedef struct RomPicker_Entry
+{
+    char *name;
+    uint32_t size;
+    int64_t mtime;
+    uint64_t hash;
+    int64_t last_played; // unix time, 0 if never played
+    int seen;            // found by the current directory scan
+    int checked;         // size and hash are up to date with the file
+} RomPicker_Entry;
 
 typedef struct RomPicker
 {
-    char roms[MAX_ROMS][ROM_NAME_MAX_LEN];
     char roms_path[ROM_PATH_MAX_LEN];
+    char cache_path[ROM_PATH_MAX_LEN];
+    RomPicker_Entry *entries; // sorted by name
     unsigned int rom_count;
-    unsigned int cursor;
+    unsigned int capacity;
+    unsigned int *visible; // indexes of the entries matching the filter
+    unsigned int visible_count;
+    unsigned int cursor;   // index in visible
+    unsigned int scroll;   // first visible row of the viewport
+    unsigned int viewport_rows;
+    char selected_name[ROM_NAME_MAX_LEN];
+    char filter[ROM_PICKER_FILTER_MAX_LEN];
+    DIR *dir;              // non NULL while the directory is being scanned
+    unsigned int metadata_cursor;
+    int cache_dirty;
 } RomPicker;
 
-void RomPicker_Init(RomPicker *picker, const char *roms_path);
+int RomPicker_Init(RomPicker *picker, const char *roms_path, unsigned int viewport_rows);
+void RomPicker_Deinit(RomPicker *picker);
+void RomPicker_Update(RomPicker *picker);
+int RomPicker_IsScanning(RomPicker *picker);
 void RomPicker_Up(RomPicker *picker);
 void RomPicker_Down(RomPicker *picker);
-void RomPicker_GetSelectedPath(RomPicker *picker, char rom_path[ROM_PATH_MAX_LEN]);
+void RomPicker_PageUp(RomPicker *picker);
+void RomPicker_PageDown(RomPicker *picker);
+void RomPicker_SetFilter(RomPicker *picker, const char *filter);
+void RomPicker_FilterAppend(RomPicker *picker, char c);
+void RomPicker_FilterErase(RomPicker *picker);
+const RomPicker_Entry *RomPicker_GetVisibleEntry(RomPicker *picker, unsigned int index);
+const RomPicker_Entry *RomPicker_GetSelectedEntry(RomPicker *picker);
+int RomPicker_GetVisiblePath(RomPicker *picker, unsigned int index, char rom_path[ROM_PATH_MAX_LEN]);
+int RomPicker_GetSelectedPath(RomPicker *picker, char rom_path[ROM_PATH_MAX_LEN]);
 const char *RomPicker_GetSelectedRomName(RomPicker *picker);
+void RomPicker_MarkPlayed(RomPicker *picker);
 
 #endif // ROM_PICKER_H
@@ -0,0 +1,35 @@
+#include <stdio.h>
+
+#include "rom_pack.h"
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        printf("Usage: rompack ROMS_DIR PACK_PATH\n");
+        return 1;
+    }
+
+    const char *roms_dir = argv[1];
+    const char *pack_path = argv[2];
+
+    if (RomPack_Build(roms_dir, pack_path) < 0)
+    {
+        printf("Failed to build ROM pack (path: %s)\n", pack_path);
+        return 1;
+    }
+
+    RomPack pack;
+
+    if (RomPack_Open(&pack, pack_path) < 0)
+    {
+        printf("Failed to open the built ROM pack (path: %s)\n", pack_path);
+        return 1;
+    }
+
+    printf("ROM pack built (ROMs: %u, size: %zu bytes)\n", pack.rom_count, pack.size);
+
+    RomPack_Close(&pack);
+
+    return 0;
+}
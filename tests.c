@@ -2,8 +2,25 @@
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "chip-8.h"
+#include "asm.h"
+#include "disasm.h"
+#include "disasm_batch.h"
+#include "lockstep.h"
+#include "explore.h"
+#include "vec_env.h"
+#include "emulation.h"
+#include "pixels.h"
+#include "trace.h"
+#include "capture.h"
+#include "frame_stream.h"
+#include "rom_pack.h"
+#include "rom_picker.h"
+#include "preloader.h"
+#include "thumbnailer.h"
+#include "rom_db.h"
 
 static void TestGetInstruction(void);
 static void WriteInstructionInMemory(Chip8 *chip8, uint16_t instruction);
@@ -27,6 +44,7 @@ static void TestShl(void);
 static void TestSneVxVy(void);
 static void TestLdIAddr(void);
 static void TestJpV0Addr(void);
+static void TestRnd(void);
 static void TestDrw(void);
 static void TestSkp(void);
 static void TestSknp(void);
@@ -38,6 +56,30 @@ static void TestLdFVx(void);
 static void TestLdBVx(void);
 static void TestLdIVx(void);
 static void TestLdVxI(void);
+static void TestQuirks(void);
+static void TestFaults(void);
+static void TestHooks(void);
+static void TestBlockMap(void);
+static void TestDisasmBatch(void);
+static void TestAssembler(void);
+static void TestLockstep(void);
+static void TestStateHash(void);
+static void TestExplore(void);
+static float FaultReward(const Chip8 *before, const Chip8 *after, void *user_data);
+static void TestVecEnv(void);
+static void TestEmulation(void);
+static void TestPixels(void);
+static void TestTrace(void);
+static void TestCapture(void);
+static void TestFrameStream(void);
+static void TestRomPack(void);
+static void TestRomPicker(void);
+static void TestPreloader(void);
+static void TestThumbnailer(void);
+static void TestRomDb(void);
+#ifdef CHIP8_PROFILER
+static void TestProfiler(void);
+#endif
 
 int main(void)
 {
@@ -62,6 +104,7 @@ int main(void)
     TestSneVxVy();
     TestLdIAddr();
     TestJpV0Addr();
+    TestRnd();
     TestDrw();
     TestSkp();
     TestSknp();
@@ -73,6 +116,29 @@ int main(void)
     TestLdBVx();
     TestLdIVx();
     TestLdVxI();
+    TestQuirks();
+    TestFaults();
+    TestHooks();
+    TestBlockMap();
+    TestDisasmBatch();
+    TestAssembler();
+    TestLockstep();
+    TestStateHash();
+    TestExplore();
+    TestVecEnv();
+    TestEmulation();
+    TestPixels();
+    TestTrace();
+    TestCapture();
+    TestFrameStream();
+    TestRomPack();
+    TestRomPicker();
+    TestPreloader();
+    TestThumbnailer();
+    TestRomDb();
+#ifdef CHIP8_PROFILER
+    TestProfiler();
+#endif
 
     return 0;
 }
@@ -603,6 +669,27 @@ static void TestJpV0Addr(void)
     assert(chip8.pc == 0xABC + 0xF0);
 }
 
+static void TestRnd(void)
+{
+    Chip8 a, b;
+
+    Chip8_Init(&a);
+    Chip8_Init(&b);
+    Chip8_SetSeed(&a, 42);
+    Chip8_SetSeed(&b, 42);
+
+    // instances with the same seed get the same numbers
+    for (int i = 0; i < 16; i++)
+    {
+        assert(Chip8_ExecuteInstruction(&a, RND, 0x0FF) == 2);
+        assert(Chip8_ExecuteInstruction(&b, RND, 0x0FF) == 2);
+        assert(a.v[0x0] == b.v[0x0]);
+    }
+
+    Chip8_ExecuteInstruction(&a, RND, 0x00F);
+    assert(a.v[0x0] <= 0x0F);
+}
+
 static void TestDrw(void)
 {
     Chip8 chip8;
@@ -698,10 +785,9 @@ static void TestDrw(void)
     assert(chip8.display[pos] == (0xF0 ^ 0x70));
 }
 
-static uint8_t keys[0xF] = {0};
-
-static uint16_t TestGetKeys(void)
+static uint16_t TestGetKeys(void *user_data)
 {
+    const uint8_t *keys = user_data;
     uint16_t keys_bits = 0;
 
     for (int i = 0; i < 0xF; i++)
@@ -718,11 +804,10 @@ static void TestSkp(void)
 
     Chip8_Init(&chip8);
 
-    chip8.get_keys = TestGetKeys;
     chip8.v[0x3] = 0xA;
     chip8.v[0x4] = 0xB;
 
-    keys[0xB] = 1;
+    Chip8_SetKeys(&chip8, 1 << (0xF - 0xB));
 
     uint16_t ret = Chip8_ExecuteInstruction(&chip8, SKP, 0x300);
 
@@ -739,11 +824,10 @@ static void TestSknp(void)
 
     Chip8_Init(&chip8);
 
-    chip8.get_keys = TestGetKeys;
     chip8.v[0x3] = 0xA;
     chip8.v[0x4] = 0xB;
 
-    keys[0xB] = 1;
+    Chip8_SetKeys(&chip8, 1 << (0xF - 0xB));
 
     uint16_t ret = Chip8_ExecuteInstruction(&chip8, SKNP, 0x300);
 
@@ -756,19 +840,25 @@ static void TestSknp(void)
 
 static void TestLdVxK(void)
 {
-    memset(keys, 0, sizeof(keys));
-
+    uint8_t keys[0xF] = {0};
     Chip8 chip8;
+    Chip8 other;
 
     Chip8_Init(&chip8);
+    Chip8_Init(&other);
 
-    chip8.get_keys = TestGetKeys;
+    // the callback refreshes the keys of its own instance only
+    Chip8_SetGetKeysCallback(&chip8, TestGetKeys, keys);
+    Chip8_SetKeys(&other, 1 << (0xF - 0x7));
 
     assert(Chip8_ExecuteInstruction(&chip8, LD_VX_K, 0xE00) == 0);
 
     keys[0x2] = 1;
 
     assert(Chip8_ExecuteInstruction(&chip8, LD_VX_K, 0xE00) == 2);
+    assert(chip8.v[0xE] == 0x2 && chip8.keys == 1 << (0xF - 0x2));
+    assert(Chip8_ExecuteInstruction(&other, LD_VX_K, 0xE00) == 2);
+    assert(other.v[0xE] == 0x7);
 }
 
 static void TestLdDtVx(void)
@@ -939,3 +1029,1311 @@ static void TestLdVxI(void)
     assert(chip8.v[0x4] == 0x0);
     assert(chip8.v[0x5] == 0x0);
 }
+
+static void TestQuirks(void)
+{
+    Chip8 chip8;
+    Chip8_Hooks hooks = {0};
+
+    Chip8_Init(&chip8);
+    assert(chip8.quirks == 0);
+    Chip8_SetQuirks(&chip8, CHIP8_QUIRK_ALL);
+
+    // SHIFT_VY
+    chip8.v[0x1] = 0x4;
+    chip8.v[0x2] = 0x81;
+    Chip8_ExecuteInstruction(&chip8, SHR, 0x120);
+    assert(chip8.v[0x1] == 0x40 && chip8.v[0xF] == 1);
+    Chip8_ExecuteInstruction(&chip8, SHL, 0x120);
+    assert(chip8.v[0x1] == 0x02 && chip8.v[0xF] == 1);
+
+    // LOAD_STORE_I
+    chip8.i = 0x300;
+    Chip8_ExecuteInstruction(&chip8, LD_I_VX, 0x200);
+    assert(chip8.i == 0x303 && chip8.mem[0x302] == 0x81);
+    chip8.i = 0x300;
+    Chip8_ExecuteInstruction(&chip8, LD_VX_I, 0x100);
+    assert(chip8.i == 0x302);
+
+    // VF_RESET
+    chip8.v[0xF] = 1;
+    Chip8_ExecuteInstruction(&chip8, OR, 0x120);
+    assert(chip8.v[0xF] == 0);
+
+    // DRAW_CLIP: a sprite drawn at the right edge is not wrapped to the left one
+    chip8.mem[0x300] = 0xFF;
+    chip8.i = 0x300;
+    chip8.v[0x0] = DISPLAY_WIDTH - 4 + DISPLAY_WIDTH; // the position itself still wraps
+    chip8.v[0x1] = 0;
+    Chip8_ExecuteInstruction(&chip8, DRW, 0x011);
+    assert(chip8.display[DISPLAY_WIDTH / 8 - 1] == 0x0F && chip8.display[0] == 0);
+
+    // quirks set on a hooked instance survive removing the hooks
+    Chip8_Init(&chip8);
+    Chip8_SetHooks(&chip8, &hooks);
+    Chip8_SetQuirks(&chip8, CHIP8_QUIRK_LOAD_STORE_I);
+    Chip8_ExecuteInstruction(&chip8, LD_I_VX, 0x000);
+    assert(chip8.i == 1);
+    Chip8_SetHooks(&chip8, NULL);
+    Chip8_ExecuteInstruction(&chip8, LD_I_VX, 0x000);
+    assert(chip8.i == 2);
+    Chip8_SetQuirks(&chip8, 0);
+    Chip8_ExecuteInstruction(&chip8, LD_I_VX, 0x000);
+    assert(chip8.i == 2);
+}
+
+static void TestFaults(void)
+{
+    Chip8 chip8;
+
+    // stack overflow: the PC stays on the faulting CALL
+    Chip8_Init(&chip8);
+
+    for (int i = 0; i < STACK_SIZE; i++)
+    {
+        assert(Chip8_ExecuteInstruction(&chip8, CALL_ADDR, 0x300) == 0);
+    }
+
+    assert(chip8.faults == 0);
+    chip8.pc = 0x300;
+    assert(Chip8_ExecuteInstruction(&chip8, CALL_ADDR, 0x400) == 0);
+    assert(chip8.faults == CHIP8_FAULT_STACK_OVERFLOW);
+    assert(chip8.pc == 0x300 && chip8.sp == STACK_SIZE);
+
+    // stack underflow
+    Chip8_Reset(&chip8);
+    assert(chip8.faults == 0);
+    assert(Chip8_ExecuteInstruction(&chip8, RET, 0x0) == 0);
+    assert(chip8.faults == CHIP8_FAULT_STACK_UNDERFLOW);
+    assert(chip8.pc == PROGRAM_START_ADDR);
+
+    // out of range accesses land in the memory padding
+    Chip8_Reset(&chip8);
+    chip8.i = RAM_SIZE - 2;
+    assert(Chip8_ExecuteInstruction(&chip8, LD_B_VX, 0x000) == 0);
+    assert(chip8.faults == CHIP8_FAULT_OUT_OF_RANGE);
+    Chip8_Reset(&chip8);
+    chip8.i = RAM_SIZE - 1;
+    assert(Chip8_ExecuteInstruction(&chip8, LD_VX_I, 0xF00) == 0);
+    assert(chip8.faults == CHIP8_FAULT_OUT_OF_RANGE);
+    Chip8_Reset(&chip8);
+    chip8.i = RAM_SIZE - 15;
+    assert(Chip8_ExecuteInstruction(&chip8, DRW, 0x00F) == 2);
+    assert(Chip8_ExecuteInstruction(&chip8, LD_I_VX, 0xE00) == 2);
+    assert(chip8.faults == 0);
+
+    // only the 12 lowest bits of I address memory
+    chip8.i = 0x1200;
+    chip8.v[0x0] = 42;
+    assert(Chip8_ExecuteInstruction(&chip8, LD_I_VX, 0x000) == 2);
+    assert(chip8.mem[0x200] == 42 && chip8.faults == 0);
+
+    // a faulted instance stops running
+    uint8_t rom[] = {
+        0x60, 0x01, // 0x200: LD V0, 0x1
+        0x00, 0x00, // 0x202: unknown
+        0x60, 0x02  // 0x204: LD V0, 0x2
+    };
+
+    Chip8_Init(&chip8);
+    Chip8_Load(&chip8, rom, sizeof(rom));
+    assert(Chip8_Run(&chip8, 100) == 1);
+    assert(chip8.faults == CHIP8_FAULT_UNKNOWN_INSTRUCTION);
+    assert(chip8.pc == 0x202 && chip8.v[0x0] == 1);
+    assert(!Chip8_Tick(&chip8));
+    assert(strcmp(Chip8_GetFaultName(chip8.faults), "unknown instruction") == 0);
+
+    Chip8_Reset(&chip8);
+    assert(Chip8_Run(&chip8, 1) == 1);
+}
+
+typedef struct HookCounters
+{
+    unsigned int pre_count;
+    unsigned int post_count;
+    uint16_t last_write_addr;
+    unsigned int last_write_len;
+} HookCounters;
+
+static void TestPreInstructionHook(Chip8 *chip8, Chip8_InstructionType instruction_type, uint16_t instruction, void *user_data)
+{
+    (void)chip8;
+    (void)instruction_type;
+    (void)instruction;
+
+    ((HookCounters *)user_data)->pre_count++;
+}
+
+static void TestPostInstructionHook(Chip8 *chip8, Chip8_InstructionType instruction_type, uint16_t instruction, void *user_data)
+{
+    (void)chip8;
+    (void)instruction_type;
+    (void)instruction;
+
+    ((HookCounters *)user_data)->post_count++;
+}
+
+static void TestMemWriteHook(Chip8 *chip8, uint16_t addr, unsigned int len, void *user_data)
+{
+    (void)chip8;
+
+    ((HookCounters *)user_data)->last_write_addr = addr;
+    ((HookCounters *)user_data)->last_write_len = len;
+}
+
+static void TestHooks(void)
+{
+    Chip8 chip8;
+    HookCounters counters = {0};
+    Chip8_Hooks hooks = {
+        .pre_instruction = TestPreInstructionHook,
+        .post_instruction = TestPostInstructionHook,
+        .mem_write = TestMemWriteHook,
+        .user_data = &counters
+    };
+
+    Chip8_Init(&chip8);
+
+    Chip8_InstructionHandler ld_vx_byte_handler = chip8.instruction_handlers[LD_VX_BYTE];
+
+    Chip8_SetHooks(&chip8, &hooks);
+
+    assert(chip8.instruction_handlers[LD_VX_BYTE] != ld_vx_byte_handler);
+    assert(Chip8_ExecuteInstruction(&chip8, LD_VX_BYTE, 0x312) == 2);
+    assert(chip8.v[0x3] == 0x12);
+    assert(counters.pre_count == 1);
+    assert(counters.post_count == 1);
+
+    chip8.i = 0x300;
+
+    assert(Chip8_ExecuteInstruction(&chip8, LD_I_VX, 0x300) == 2);
+    assert(counters.last_write_addr == 0x300);
+    assert(counters.last_write_len == 4);
+    assert(Chip8_ExecuteInstruction(&chip8, LD_B_VX, 0x300) == 2);
+    assert(counters.last_write_len == 3);
+
+    // a write running past the RAM faults and is not reported
+    chip8.i = RAM_SIZE - 2;
+    counters.last_write_len = 0;
+    assert(Chip8_ExecuteInstruction(&chip8, LD_I_VX, 0xF00) == 0);
+    assert(chip8.faults == CHIP8_FAULT_OUT_OF_RANGE && counters.last_write_len == 0);
+    chip8.faults = 0;
+
+    // unknown instructions are reported too
+    assert(Chip8_ExecuteInstruction(&chip8, UNKNOWN_INSTRUCTION, 0x0) == 0);
+    assert(counters.pre_count == 5);
+    assert(counters.post_count == 5);
+
+    Chip8_SetHooks(&chip8, NULL);
+
+    assert(chip8.instruction_handlers[LD_VX_BYTE] == ld_vx_byte_handler);
+    assert(Chip8_ExecuteInstruction(&chip8, LD_VX_BYTE, 0x313) == 2);
+    assert(counters.pre_count == 5);
+}
+
+static void TestBlockMap(void)
+{
+    uint8_t program[] = {
+        0x22, 0x08, // 0x200: CALL 0x208
+        0x3A, 0x01, // 0x202: SE VA, 0x1
+        0x12, 0x00, // 0x204: JP 0x200
+        0x12, 0x06, // 0x206: JP 0x206
+        0x60, 0x01, // 0x208: LD V0, 0x1
+        0x00, 0xEE, // 0x20A: RET
+        0xF0, 0x90  // 0x20C: sprite data
+    };
+    Chip8 chip8;
+    static Disasm_BlockMap map;
+
+    Chip8_Init(&chip8);
+    Chip8_Load(&chip8, program, sizeof(program));
+    Disasm_BuildBlockMap(&chip8, &map);
+
+    assert(map.block_count == 5);
+    assert(map.blocks[0].start == 0x200 && map.blocks[0].exit == DISASM_EXIT_CALL);
+    assert(map.blocks[0].successors[0] == 0x208 && map.blocks[0].successors[1] == 0x202);
+    assert(map.blocks[1].exit == DISASM_EXIT_SKIP);
+    assert(map.blocks[1].successors[0] == 0x204 && map.blocks[1].successors[1] == 0x206);
+    assert(map.blocks[2].exit == DISASM_EXIT_JUMP && map.blocks[2].successors[0] == 0x200);
+    assert(map.blocks[4].start == 0x208 && map.blocks[4].end == 0x20C);
+    assert(map.blocks[4].exit == DISASM_EXIT_RETURN);
+    assert(map.flags[0x208] & DISASM_SUBROUTINE);
+    assert(!(map.flags[0x20C] & DISASM_CODE));
+    assert(Disasm_FindBlock(&map, 0x20A) == &map.blocks[4]);
+    assert(Disasm_FindBlock(&map, 0x20C) == NULL);
+
+    // control leaving the program has no block to go to, so it gives no successor
+    uint8_t leaving[] = {
+        0x30, 0x01, // 0x200: SE V0, 0x1
+        0x13, 0x00  // 0x202: JP 0x300
+    };
+
+    Chip8_Init(&chip8);
+    Chip8_Load(&chip8, leaving, sizeof(leaving));
+    Disasm_BuildBlockMap(&chip8, &map);
+
+    assert(map.block_count == 2);
+    assert(map.blocks[0].exit == DISASM_EXIT_SKIP && map.blocks[0].successor_count == 1);
+    assert(map.blocks[0].successors[0] == 0x202);
+    assert(map.blocks[1].exit == DISASM_EXIT_JUMP && map.blocks[1].successor_count == 0);
+
+    // a CALL to an odd address makes every byte the start of a skip, hence of a block
+    static uint8_t overlapping[RAM_SIZE - PROGRAM_START_ADDR];
+
+    memset(overlapping, 0x33, sizeof(overlapping));
+    overlapping[0] = 0x22;
+    overlapping[1] = 0x05;
+
+    Chip8_Init(&chip8);
+    Chip8_Load(&chip8, overlapping, sizeof(overlapping));
+    Disasm_BuildBlockMap(&chip8, &map);
+
+    assert(map.block_count > RAM_SIZE / 2 && map.block_count <= DISASM_MAX_BLOCKS);
+    assert(Disasm_FindBlock(&map, 0x205)->exit == DISASM_EXIT_SKIP);
+    assert(Disasm_FindBlock(&map, 0x206)->exit == DISASM_EXIT_SKIP);
+}
+
+static void TestDisasmBatch(void)
+{
+    char dir[] = "/tmp/chip8_tests_XXXXXX";
+    char path[1024];
+    char out_dirs[2][64];
+    unsigned int jobs[2] = {1, 4};
+    int rom_count = 8;
+    static uint8_t rom[RAM_SIZE - PROGRAM_START_ADDR];
+    static char listings[2][256 * 1024];
+    size_t listing_lens[2];
+
+    // overlapping instructions, so every ROM builds a large block map
+    memset(rom, 0x33, sizeof(rom));
+    rom[0] = 0x22;
+    rom[1] = 0x05;
+
+    assert(mkdtemp(dir));
+
+    for (int i = 0; i < rom_count; i++)
+    {
+        snprintf(path, sizeof(path), "%s/rom%d.ch8", dir, i);
+
+        FILE *f = fopen(path, "wb");
+
+        assert(f);
+        fwrite(rom, 1, sizeof(rom) - i * 64, f);
+        fclose(f);
+    }
+
+    // workers building block maps concurrently must give the listings of a single worker
+    for (int run = 0; run < 2; run++)
+    {
+        Disasm_BatchOptions options = {0};
+
+        snprintf(out_dirs[run], sizeof(out_dirs[run]), "%s/out%u", dir, jobs[run]);
+        options.roms_dir = dir;
+        options.out_dir = out_dirs[run];
+        options.jobs = jobs[run];
+        options.recursive = 1;
+
+        assert(Disasm_RunBatch(&options) == 0);
+    }
+
+    for (int i = 0; i < rom_count; i++)
+    {
+        for (int run = 0; run < 2; run++)
+        {
+            snprintf(path, sizeof(path), "%s/rom%d.ch8.asm", out_dirs[run], i);
+
+            FILE *f = fopen(path, "rb");
+
+            assert(f);
+            listing_lens[run] = fread(listings[run], 1, sizeof(listings[run]), f);
+            fclose(f);
+            remove(path);
+        }
+
+        assert(listing_lens[0] > 0 && listing_lens[0] < sizeof(listings[0]));
+        assert(listing_lens[0] == listing_lens[1] && memcmp(listings[0], listings[1], listing_lens[0]) == 0);
+
+        snprintf(path, sizeof(path), "%s/rom%d.ch8", dir, i);
+        remove(path);
+    }
+
+    rmdir(out_dirs[0]);
+    rmdir(out_dirs[1]);
+
+    // "unknown" counts the unknown opcodes listed in both modes, the recursive mode counts the blocks running into
+    // one on their own
+    uint8_t unknown_rom[] = {0x60, 0x01, 0xFF, 0xFF};
+    const char *expected[2] = {"\"unknown\": 1}", "\"unknown\": 0, \"blocks_into_unknown\": 1}"};
+    char line[256];
+
+    snprintf(path, sizeof(path), "%s/unknown.ch8", dir);
+
+    FILE *f = fopen(path, "wb");
+
+    assert(f);
+    fwrite(unknown_rom, 1, sizeof(unknown_rom), f);
+    fclose(f);
+
+    for (int recursive = 0; recursive < 2; recursive++)
+    {
+        Disasm_BatchOptions options = {0};
+
+        snprintf(out_dirs[0], sizeof(out_dirs[0]), "%s.jsonl", dir);
+        options.roms_dir = dir;
+        options.jsonl_path = out_dirs[0];
+        options.jobs = 1;
+        options.recursive = recursive;
+
+        assert(Disasm_RunBatch(&options) == 0);
+        f = fopen(out_dirs[0], "rb");
+        assert(f && fgets(line, sizeof(line), f));
+        fclose(f);
+        assert(strstr(line, expected[recursive]));
+        remove(out_dirs[0]);
+    }
+
+    remove(path);
+    rmdir(dir);
+}
+
+static void TestAssembler(void)
+{
+    uint8_t program[ASM_PROGRAM_MAX_LEN];
+    unsigned int len;
+    char error[ASM_ERROR_MAX_LEN];
+    const char *source =
+        "; comment\n"
+        "start:\n"
+        "    LD I, sprite\n"
+        ".rep 2\n"
+        "    DRW V0, V1, 0x2 ; draw\n"
+        ".endr\n"
+        "0x206\tJP start\n"
+        "sprite: DB 0x18, 0x3C\n"
+        "    DW $\n";
+
+    assert(Asm_Assemble(source, program, &len, error, sizeof(error)) == 0);
+    assert(len == 12);
+    assert(program[0] == 0xA2 && program[1] == 0x08);
+    assert(program[2] == 0xD0 && program[3] == 0x12);
+    assert(program[4] == 0xD0 && program[5] == 0x12);
+    assert(program[6] == 0x12 && program[7] == 0x00);
+    assert(program[8] == 0x18 && program[9] == 0x3C);
+    assert(program[10] == 0x02 && program[11] == 0x0A);
+
+    assert(Asm_Assemble("LD V1, 0x100", program, &len, error, sizeof(error)) < 0);
+    assert(Asm_Assemble("JP nowhere", program, &len, error, sizeof(error)) < 0);
+    assert(Asm_Assemble(".rep 2\nloop: CLS\n.endr", program, &len, error, sizeof(error)) < 0);
+
+    // every known instruction reassembles from its disassembly (to the canonical opcode, e.g. 5xy0 for 5xy1)
+    for (unsigned int opcode = 0; opcode <= 0xFFFF; opcode++)
+    {
+        Chip8_InstructionType instruction_type;
+        uint16_t instruction;
+        char mnemonic[DISASM_MNEMONIC_MAX_LEN];
+        char reassembled_mnemonic[DISASM_MNEMONIC_MAX_LEN];
+
+        Chip8_DecodeInstruction(opcode, &instruction_type, &instruction);
+
+        if (instruction_type == UNKNOWN_INSTRUCTION) continue;
+
+        Disasm_FormatInstruction(instruction_type, instruction, mnemonic, sizeof(mnemonic));
+
+        assert(Asm_Assemble(mnemonic, program, &len, error, sizeof(error)) == 0);
+        assert(len == 2);
+
+        Chip8_DecodeInstruction((program[0] << 8) | program[1], &instruction_type, &instruction);
+        Disasm_FormatInstruction(instruction_type, instruction, reassembled_mnemonic, sizeof(reassembled_mnemonic));
+
+        assert(strcmp(mnemonic, reassembled_mnemonic) == 0);
+    }
+}
+
+// behaves like Chip8_Tick, except that ADD V3, byte adds one more
+static int BrokenStep(Chip8 *chip8)
+{
+    uint16_t opcode = (chip8->mem[chip8->pc] << 8) | chip8->mem[chip8->pc + 1];
+    int ret = Chip8_Tick(chip8);
+
+    if ((opcode & 0xFF00) == 0x7300) chip8->v[0x3]++;
+
+    return ret;
+}
+
+static void TestLockstep(void)
+{
+    uint8_t rom[] = {
+        0x70, 0x01, // 0x200: ADD V0, 0x1
+        0x30, 0x40, // 0x202: SE V0, 0x40
+        0x12, 0x00, // 0x204: JP 0x200
+        0x73, 0x01, // 0x206: ADD V3, 0x1
+        0x12, 0x06  // 0x208: JP 0x206
+    };
+    static Lockstep lockstep;
+    static Lockstep_Divergence divergence;
+
+    Lockstep_Init(&lockstep, Chip8_Tick);
+    assert(Lockstep_Load(&lockstep, rom, sizeof(rom)) == 0);
+    assert(Lockstep_Run(&lockstep, 10000, 100, &divergence) == 0);
+    assert(lockstep.cycle == 10000);
+
+    // the first ADD V3 is instruction 0x40 * 3 - 1 (0x3F loops of 3 instructions, then ADD and SE)
+    Lockstep_Init(&lockstep, BrokenStep);
+    assert(Lockstep_Load(&lockstep, rom, sizeof(rom)) == 0);
+    assert(Lockstep_Run(&lockstep, 10000, 100, &divergence) == 1);
+    assert(divergence.cycle == 0x40 * 3 - 1);
+    assert(divergence.before.pc == 0x206);
+    assert(divergence.reference.v[0x3] == 1 && divergence.candidate.v[0x3] == 2);
+}
+
+static void TestStateHash(void)
+{
+    uint8_t rom[] = {
+        0x60, 0x7B, // 0x200: LD V0, 0x7B
+        0xA3, 0x00, // 0x202: LD I, 0x300
+        0xF0, 0x33, // 0x204: LD B, V0
+        0xF2, 0x55, // 0x206: LD [I], V2
+        0xD0, 0x15, // 0x208: DRW V0, V1, 0x5
+        0xD0, 0x13, // 0x20A: DRW V0, V1, 0x3
+        0x00, 0xE0, // 0x20C: CLS
+        0xAF, 0xFE, // 0x20E: LD I, 0xFFE
+        0xF3, 0x55  // 0x210: LD [I], V3 (faults, half of it lands in the padding)
+    };
+    Chip8 chip8, copy;
+
+    Chip8_Init(&chip8);
+    Chip8_Load(&chip8, rom, sizeof(rom));
+
+    uint64_t initial_hash = Chip8_StateHash(&chip8);
+
+    // the hash kept up to date by the handlers (CHIP8_STATE_HASH) matches the one computed from scratch
+    while (Chip8_Tick(&chip8))
+    {
+        memcpy(&copy, &chip8, sizeof(Chip8));
+        Chip8_RehashState(&copy);
+        assert(Chip8_StateHash(&chip8) == Chip8_StateHash(&copy));
+        assert(Chip8_StateHash(&chip8) != initial_hash);
+    }
+
+    assert(chip8.faults == CHIP8_FAULT_OUT_OF_RANGE);
+    memcpy(&copy, &chip8, sizeof(Chip8));
+    Chip8_RehashState(&copy);
+    assert(Chip8_StateHash(&chip8) == Chip8_StateHash(&copy));
+
+    // direct writes need a rehash
+    copy.mem[0x400] ^= 1;
+    Chip8_RehashState(&copy);
+    assert(Chip8_StateHash(&chip8) != Chip8_StateHash(&copy));
+}
+
+static int IsFaulted(const Chip8 *chip8, void *user_data)
+{
+    (void)user_data;
+
+    return chip8->faults != 0;
+}
+
+static int IsAtPc(const Chip8 *chip8, void *user_data)
+{
+    return chip8->pc == *(uint16_t *)user_data;
+}
+
+static void TestExplore(void)
+{
+    uint8_t rom[] = {
+        0x60, 0x05, // 0x200: LD V0, 0x5
+        0xE0, 0xA1, // 0x202: SKNP V0
+        0x12, 0x08, // 0x204: JP 0x208
+        0x12, 0x02, // 0x206: JP 0x202
+        0x00, 0xEE  // 0x208: RET (stack underflow)
+    };
+    Explore_Options options = {
+        .max_depth = 10,
+        .max_frontier = 64,
+        .max_states = 4096,
+        .worker_count = 2,
+        .goal = IsFaulted
+    };
+    static Chip8 chip8;
+    static Explore_Result result;
+
+    Chip8_Init(&chip8);
+    Chip8_Load(&chip8, rom, sizeof(rom));
+
+    // only holding key 5 crashes the ROM
+    assert(Explore_Run(&chip8, &options, &result) == 0);
+    assert(result.found && result.depth == 1);
+    assert(result.inputs[0] == 5);
+    assert(result.state.faults == CHIP8_FAULT_STACK_UNDERFLOW);
+    Explore_FreeResult(&result);
+
+    // the states of a ROM waiting for a key repeat, so they are deduplicated
+    rom[8] = 0x12;
+    rom[9] = 0x08; // 0x208: JP 0x208
+    Chip8_Init(&chip8);
+    Chip8_Load(&chip8, rom, sizeof(rom));
+    assert(Explore_Run(&chip8, &options, &result) == 0);
+    assert(!result.found && result.explored_depth == options.max_depth);
+    assert(result.state_count < 4096 && result.pruned_count == 0);
+    Explore_FreeResult(&result);
+
+    // 0x208 only runs in the middle of a frame, once key 5 is held
+    uint8_t pass_rom[] = {
+        0x60, 0x05, // 0x200: LD V0, 0x5
+        0xE0, 0xA1, // 0x202: SKNP V0
+        0x12, 0x08, // 0x204: JP 0x208
+        0x12, 0x02, // 0x206: JP 0x202
+        0x61, 0x01, // 0x208: LD V1, 0x1
+        0x12, 0x0A  // 0x20A: JP 0x20A
+    };
+    uint16_t pc = 0x208;
+
+    Chip8_Init(&chip8);
+    Chip8_Load(&chip8, pass_rom, sizeof(pass_rom));
+    options.goal = IsAtPc;
+    options.goal_user_data = &pc;
+    assert(Explore_Run(&chip8, &options, &result) == 0);
+    assert(!result.found);
+    Explore_FreeResult(&result);
+
+    options.goal_per_instruction = 1;
+    assert(Explore_Run(&chip8, &options, &result) == 0);
+    assert(result.found && result.depth == 1 && result.inputs[0] == 5);
+    assert(result.state.pc == 0x208);
+    Explore_FreeResult(&result);
+
+    // the goal is still found by the step filling the visited set, then the search stops
+    options.max_states = 2;
+    assert(Explore_Run(&chip8, &options, &result) == 0);
+    assert(result.found && result.depth == 1 && result.inputs[0] == 5);
+    assert(result.state_count == 2 && result.pruned_count > 0 && result.explored_depth == 0);
+    Explore_FreeResult(&result);
+
+    // more workers than recorded states, the ones racing past max_states must still find free slots
+    options.max_states = 1;
+    options.worker_count = 8;
+    options.goal = IsFaulted;
+    assert(Explore_Run(&chip8, &options, &result) == 0);
+    assert(!result.found && result.state_count == 1 && result.pruned_count > 0);
+    Explore_FreeResult(&result);
+}
+
+static float FaultReward(const Chip8 *before, const Chip8 *after, void *user_data)
+{
+    (void)before;
+    (void)user_data;
+
+    return after->faults ? -1 : 1;
+}
+
+static void TestVecEnv(void)
+{
+    uint8_t rom[] = {
+        0xA2, 0x10, // 0x200: LD I, 0x210
+        0xD0, 0x11, // 0x202: DRW V0, V1, 1
+        0x60, 0x05, // 0x204: LD V0, 0x5
+        0xE0, 0xA1, // 0x206: SKNP V0
+        0x12, 0x0C, // 0x208: JP 0x20C
+        0x12, 0x06, // 0x20A: JP 0x206
+        0x00, 0xEE, // 0x20C: RET (stack underflow)
+        0x12, 0x0E, // 0x20E: JP 0x20E
+        0x80        // 0x210: sprite
+    };
+    static Chip8 chip8;
+    static uint8_t observations[2 * DISPLAY_WIDTH * DISPLAY_HEIGHT];
+    float rewards[2];
+    uint8_t dones[2];
+    uint16_t actions[2] = {0, 1 << (0xF - 5)};
+    VecEnv env;
+
+    Chip8_Init(&chip8);
+    Chip8_Load(&chip8, rom, sizeof(rom));
+
+    assert(VecEnv_Init(&env, &chip8, 2, 1, VEC_ENV_OBS_UNPACKED, observations, rewards, dones) == 0);
+    VecEnv_SetReward(&env, FaultReward, NULL);
+    assert(observations[0] == 0);
+
+    // holding key 5 crashes the second instance, which starts over with a blank screen
+    VecEnv_Step(&env, actions);
+    assert(observations[0] == 1 && observations[1] == 0);
+    assert(observations[DISPLAY_WIDTH * DISPLAY_HEIGHT] == 0);
+    assert(!dones[0] && rewards[0] == 1);
+    assert(dones[1] && rewards[1] == -1);
+    assert(env.instances[1].pc == PROGRAM_START_ADDR && env.episodes[1] == 2);
+
+    // episodes are cut after max_episode_frames
+    actions[1] = 0;
+    env.max_episode_frames = 3;
+    VecEnv_Step(&env, actions);
+    assert(!dones[0] && !dones[1]);
+    VecEnv_Step(&env, actions);
+    assert(dones[0] && !dones[1]);
+    assert(env.episode_frames[0] == 0 && env.episode_frames[1] == 2);
+    VecEnv_Deinit(&env);
+
+    assert(VecEnv_Init(&env, &chip8, 2, 1, VEC_ENV_OBS_PACKED, observations, rewards, dones) == 0);
+    VecEnv_Step(&env, actions);
+    assert(observations[0] == 0x80 && observations[DISPLAY_SIZE] == 0x80);
+    assert(VecEnv_ObservationSize(VEC_ENV_OBS_PACKED) == DISPLAY_SIZE);
+    VecEnv_Deinit(&env);
+}
+
+static void TestEmulation(void)
+{
+    uint8_t rom[] = {
+        0xA2, 0x0C, // 0x200: LD I, 0x20C
+        0xD0, 0x11, // 0x202: DRW V0, V1, 1
+        0x60, 0x05, // 0x204: LD V0, 0x5
+        0xE0, 0xA1, // 0x206: SKNP V0
+        0x00, 0xEE, // 0x208: RET (stack underflow)
+        0x12, 0x06, // 0x20A: JP 0x206
+        0x80        // 0x20C: sprite
+    };
+    static Chip8 chip8;
+    static Emulation emulation;
+    const Emulation_Frame *frame;
+
+    Chip8_Init(&chip8);
+    Chip8_Load(&chip8, rom, sizeof(rom));
+
+    assert(Emulation_Start(&emulation, &chip8) == 0);
+    assert(emulation.frequency == chip8.frequency);
+
+    // the first frame is published right away, the sprite shows up once the thread ran a slice
+    frame = Emulation_GetFrame(&emulation);
+    assert(frame->pc == PROGRAM_START_ADDR);
+
+    for (int i = 0; i < 1000 && frame->display[0] != 0x80; i++)
+    {
+        usleep(1000);
+        Emulation_Update(&emulation);
+        frame = Emulation_GetFrame(&emulation);
+    }
+
+    assert(frame->display[0] == 0x80 && !frame->faults);
+
+    // holding key 5 crashes the instance, which then stays where it is
+    assert(Emulation_PushKeys(&emulation, Emulation_GetTime(), 1 << (0xF - 5)) == 0);
+
+    for (int i = 0; i < 1000 && !frame->faults; i++)
+    {
+        usleep(1000);
+        Emulation_Update(&emulation);
+        frame = Emulation_GetFrame(&emulation);
+    }
+
+    assert(frame->faults == CHIP8_FAULT_STACK_UNDERFLOW && frame->pc == 0x208);
+    assert(frame->cycles >= 4); // up to the SKNP letting the RET run
+
+    // events ahead of the emulated time wait in the queue
+    for (int i = 0; i < EMULATION_INPUT_QUEUE_LEN; i++)
+    {
+        assert(Emulation_PushKeys(&emulation, Emulation_GetTime() + 60, 0) == 0);
+    }
+
+    assert(Emulation_PushKeys(&emulation, Emulation_GetTime() + 60, 0) < 0);
+    Emulation_Stop(&emulation);
+
+    // an event applies at the instruction its time maps to, whatever slice it falls in
+    uint8_t poll_rom[] = {
+        0x60, 0x05, // 0x200: LD V0, 0x5
+        0xE0, 0x9E, // 0x202: SKP V0
+        0x12, 0x02, // 0x204: JP 0x202
+        0x00, 0xEE  // 0x206: RET (stack underflow)
+    };
+
+    Chip8_Init(&chip8);
+    Chip8_Load(&chip8, poll_rom, sizeof(poll_rom));
+    Chip8_SetFrequency(&chip8, 100);
+
+    // instruction 21 is a SKP, the event lands in its middle so the start of the emulated timeline may come a bit
+    // after the time taken here
+    double start = Emulation_GetTime();
+
+    assert(Emulation_Start(&emulation, &chip8) == 0);
+    assert(Emulation_PushKeys(&emulation, start + 21.5 * chip8.tick_secs, 1 << (0xF - 5)) == 0);
+    frame = Emulation_GetFrame(&emulation);
+
+    for (int i = 0; i < 1000 && !frame->faults; i++)
+    {
+        usleep(1000);
+        Emulation_Update(&emulation);
+        frame = Emulation_GetFrame(&emulation);
+    }
+
+    assert(frame->faults == CHIP8_FAULT_STACK_UNDERFLOW && frame->cycles == 22);
+    Emulation_Stop(&emulation);
+}
+
+static void TestPixels(void)
+{
+    static uint8_t display[DISPLAY_SIZE];
+    static uint8_t out[PIXELS_RGBA_SIZE];
+    static uint8_t scalar_out[PIXELS_RGBA_SIZE];
+    const uint8_t on[4] = {1, 2, 3, 4};
+    const uint8_t off[4] = {5, 6, 7, 8};
+
+    display[0] = 0x81;
+    display[DISPLAY_SIZE - 1] = 0x01;
+
+    Pixels_Unpack(out, display, on, off);
+    Pixels_UnpackScalar(scalar_out, display, on, off);
+
+    assert(memcmp(out, on, 4) == 0 && memcmp(out + 4, off, 4) == 0);
+    assert(memcmp(out + 7 * 4, on, 4) == 0 && memcmp(out + 8 * 4, off, 4) == 0);
+    assert(memcmp(out + PIXELS_RGBA_SIZE - 4, on, 4) == 0);
+    assert(memcmp(out, scalar_out, PIXELS_RGBA_SIZE) == 0);
+}
+
+static void TestTrace(void)
+{
+    uint8_t rom[] = {
+        0x63, 0x42, // 0x200: LD V3, 0x42
+        0xA3, 0x00, // 0x202: LD I, 0x300
+        0xF3, 0x1E, // 0x204: ADD I, V3
+        0x12, 0x06  // 0x206: JP 0x206
+    };
+    char path[] = "/tmp/chip8_tests_XXXXXX";
+    static Chip8 chip8;
+    static Trace trace;
+    Trace_Record records[8];
+    uint8_t bytes[sizeof(Trace_Header) + sizeof(Trace_Record)];
+    int fd = mkstemp(path);
+
+    assert(fd >= 0);
+    close(fd);
+
+    Chip8_Init(&chip8);
+    Chip8_Load(&chip8, rom, sizeof(rom));
+    assert(Trace_Open(&trace, path) == 0);
+    Trace_Attach(&trace, &chip8);
+    assert(Chip8_Run(&chip8, 5) == 5);
+    assert(Trace_Close(&trace) == 0);
+
+    // the file is little endian whatever the host
+    FILE *f = fopen(path, "rb");
+
+    assert(fread(bytes, 1, sizeof(bytes), f) == sizeof(bytes));
+    assert(memcmp(bytes, TRACE_MAGIC, 4) == 0 && bytes[4] == TRACE_VERSION && bytes[5] == 0);
+    assert(bytes[6] == sizeof(Trace_Record) && bytes[7] == 0);
+    assert(bytes[sizeof(Trace_Header) + 8] == 0x00 && bytes[sizeof(Trace_Header) + 9] == 0x02);
+    assert(bytes[sizeof(Trace_Header) + 10] == 0x42 && bytes[sizeof(Trace_Header) + 11] == 0x63);
+
+    rewind(f);
+    assert(Trace_ReadHeader(f) == 0);
+    assert(Trace_ReadRecords(f, records, 8) == 5);
+    fclose(f);
+
+    assert(records[0].cycle == 0 && records[0].pc == 0x200 && records[0].opcode == 0x6342);
+    assert(records[0].reg == 3 && records[0].reg_value == 0x42);
+    assert(records[1].pc == 0x202 && records[1].i == 0x300 && records[1].reg == TRACE_NO_REGISTER);
+    assert(records[2].opcode == 0xF31E && records[2].i == 0x342);
+    assert(records[4].cycle == 4 && records[4].pc == 0x206 && records[4].opcode == 0x1206);
+    remove(path);
+
+    // a ring buffer lost on the way to disk is reported on close
+    Chip8_Init(&chip8);
+    Chip8_Load(&chip8, rom, sizeof(rom));
+    assert(Trace_Open(&trace, "/dev/full") == 0);
+    Trace_Attach(&trace, &chip8);
+    assert(Chip8_Run(&chip8, TRACE_RING_SIZE + 1) == TRACE_RING_SIZE + 1);
+    assert(trace.error && trace.record_count == 1);
+    assert(Trace_Close(&trace) < 0);
+}
+
+static void TestCapture(void)
+{
+    char path[] = "/tmp/chip8_tests_XXXXXX";
+    uint8_t frames[3][DISPLAY_SIZE] = {{0}};
+    static Capture capture;
+    static Capture_Reader reader;
+    int fd = mkstemp(path);
+
+    assert(fd >= 0);
+    close(fd);
+
+    frames[1][0] = 0x80;
+    frames[1][2] = 0x01;
+    frames[1][DISPLAY_SIZE - 1] = 0xFF;
+    frames[2][0] = 0x80;
+
+    // a blank frame, a frame with 2 spans, then 300 identical frames
+    assert(Capture_Open(&capture, path) == 0);
+    Capture_Frame(&capture, frames[0]);
+    Capture_Frame(&capture, frames[1]);
+
+    for (int i = 0; i < 300; i++)
+    {
+        Capture_Frame(&capture, frames[2]);
+    }
+
+    assert(Capture_Close(&capture) == 0);
+
+    FILE *f = fopen(path, "rb");
+    uint8_t header[sizeof(Capture_Header)];
+
+    // the header is little endian whatever the host
+    assert(fread(header, 1, sizeof(header), f) == sizeof(header));
+    assert(memcmp(header, CAPTURE_MAGIC, 4) == 0 && header[4] == CAPTURE_VERSION && header[5] == 0);
+    assert(header[6] == DISPLAY_WIDTH && header[7] == DISPLAY_HEIGHT);
+    assert(header[8] == CAPTURE_FRAME_RATE && header[9] == 0);
+
+    // repeat, delta (2 spans), delta (2 spans), repeat of 255 frames, repeat of the last 44
+    fseek(f, 0, SEEK_END);
+    assert(ftell(f) == sizeof(Capture_Header) + 2 + (1 + 2 + 3 + 2 + 1) + (1 + 2 + 1 + 2 + 1) + 2 + 2);
+    fclose(f);
+
+    assert(Capture_OpenReader(&reader, path) == 0);
+    assert(Capture_ReadFrame(&reader) == 1 && memcmp(reader.display, frames[0], DISPLAY_SIZE) == 0);
+    assert(Capture_ReadFrame(&reader) == 1 && memcmp(reader.display, frames[1], DISPLAY_SIZE) == 0);
+
+    for (int i = 0; i < 300; i++)
+    {
+        assert(Capture_ReadFrame(&reader) == 1 && memcmp(reader.display, frames[2], DISPLAY_SIZE) == 0);
+    }
+
+    assert(Capture_ReadFrame(&reader) == 0);
+    Capture_CloseReader(&reader);
+    remove(path);
+
+    // once a flush fails, nothing more is encoded and closing reports the error
+    memset(frames[1], 0xFF, DISPLAY_SIZE);
+    assert(Capture_Open(&capture, "/dev/full") == 0);
+
+    for (int i = 0; i < 300; i++)
+    {
+        Capture_Frame(&capture, frames[i % 2]);
+    }
+
+    assert(capture.error && capture.buffer_len == 0);
+    assert(Capture_Close(&capture) < 0);
+}
+
+static void TestFrameStream(void)
+{
+    char path[64];
+    uint8_t display[DISPLAY_SIZE] = {0};
+    static FrameServer server;
+    static FrameClient client;
+
+    snprintf(path, sizeof(path), "/tmp/chip8_tests_%d.sock", (int)getpid());
+
+    unsigned int update_period = 1000000 / FRAME_STREAM_UPDATE_HZ + 1000;
+
+    assert(FrameServer_Open(&server, path, 2) == 0);
+    assert(FrameClient_Connect(&client, path) == 0);
+
+    FrameServer_Update(&server);
+    assert(FrameClient_Poll(&client) == 0 && client.instance_count == 2);
+
+    // the first frame of a subscription is the last display published
+    display[0] = 0x80;
+    FrameServer_Publish(&server, 1, display);
+    assert(FrameClient_Subscribe(&client, 1) == 0);
+    usleep(update_period);
+    FrameServer_Update(&server);
+    assert(FrameClient_Poll(&client) == 1);
+    assert(memcmp(client.display, display, DISPLAY_SIZE) == 0 && client.frame == 1);
+
+    // frames published between two updates are coalesced
+    display[1] = 0x01;
+    FrameServer_Publish(&server, 1, display);
+    FrameServer_Update(&server);
+    display[DISPLAY_SIZE - 1] = 0xFF;
+    FrameServer_Publish(&server, 1, display);
+    FrameServer_Publish(&server, 0, display);
+    assert(FrameClient_Poll(&client) == 0);
+    usleep(update_period);
+    FrameServer_Update(&server);
+    assert(FrameClient_Poll(&client) == 1);
+    assert(memcmp(client.display, display, DISPLAY_SIZE) == 0 && client.frame == 3);
+
+    // messages are little endian whatever the host: type, reserved, len then the payload
+    static FrameClient raw;
+    uint8_t hello[8];
+
+    assert(FrameClient_Connect(&raw, path) == 0);
+    usleep(update_period);
+    FrameServer_Update(&server);
+    assert(read(raw.fd, hello, sizeof(hello)) == 6);
+    assert(hello[0] == FRAME_STREAM_HELLO && hello[1] == 0 && hello[2] == 2 && hello[3] == 0);
+    assert(hello[4] == 2 && hello[5] == 0);
+    FrameClient_Close(&raw);
+
+    FrameServer_Close(&server);
+    assert(FrameClient_Poll(&client) < 0);
+    FrameClient_Close(&client);
+}
+
+static void TestRomPack(void)
+{
+    char dir[] = "/tmp/chip8_tests_XXXXXX";
+    char path[256];
+    uint8_t roms[][4] = {{0x12, 0x00, 0x00, 0x00}, {0x60, 0x2A, 0x12, 0x02}, {0x12, 0x00, 0x00, 0x00}};
+    const char *names[] = {"b.ch8", "a.ch8", "c_name_taking_all_of_the_index_entry_spaces.ch8"};
+    char long_name[64];
+
+    assert(strlen(names[2]) == ROM_PACK_NAME_MAX_LEN - 1);
+    assert(mkdtemp(dir));
+
+    for (int i = 0; i < 3; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+
+        FILE *f = fopen(path, "wb");
+
+        assert(f);
+        fwrite(roms[i], 1, i == 1 ? 4 : 2, f);
+        fclose(f);
+    }
+
+    char pack_path[256];
+    RomPack pack;
+    Chip8 chip8;
+
+    snprintf(pack_path, sizeof(pack_path), "%s.pack", dir);
+
+    assert(RomPack_Build(dir, pack_path) == 0);
+    assert(RomPack_Open(&pack, pack_path) == 0);
+    assert(pack.rom_count == 3);
+    assert(strcmp(pack.index[0].name, "a.ch8") == 0);
+    assert(pack.index[0].length == 4);
+    assert(pack.index[0].hash == Chip8_Hash(roms[1], 4));
+    assert(RomPack_Find(&pack, "c.ch8") == NULL);
+
+    // a name too long for the index is not truncated into one that is there
+    snprintf(long_name, sizeof(long_name), "%s8", names[2]);
+    assert(RomPack_Find(&pack, names[2]) != NULL);
+    assert(RomPack_Find(&pack, long_name) == NULL);
+
+    Chip8_Init(&chip8);
+    assert(Chip8_LoadFromPack(&chip8, &pack, "a.ch8") == 0);
+    assert(memcmp(chip8.mem + PROGRAM_START_ADDR, roms[1], 4) == 0);
+    assert(Chip8_LoadFromPack(&chip8, &pack, "missing.ch8") < 0);
+
+    RomPack_Close(&pack);
+
+    // the header is little endian whatever the host
+    static uint8_t pack_data[4096];
+    FILE *f = fopen(pack_path, "rb");
+    size_t pack_size = fread(pack_data, 1, sizeof(pack_data), f);
+
+    fclose(f);
+    assert(memcmp(pack_data, ROM_PACK_MAGIC, 4) == 0);
+    assert(pack_data[4] == ROM_PACK_VERSION && pack_data[5] == 0 && pack_data[6] == 0 && pack_data[7] == 0);
+    assert(pack_data[8] == 3 && pack_data[12] == sizeof(RomPack_Header));
+
+    // an index not aligned for its entries is rejected
+    pack_data[12]++;
+    f = fopen(pack_path, "wb");
+    assert(fwrite(pack_data, 1, pack_size, f) == pack_size);
+    fclose(f);
+    assert(RomPack_Open(&pack, pack_path) < 0);
+
+    for (int i = 0; i < 3; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+        remove(path);
+    }
+
+    remove(pack_path);
+    rmdir(dir);
+}
+
+static void TestRomPicker(void)
+{
+    char dir[] = "/tmp/chip8_tests_XXXXXX";
+    char path[ROM_PATH_MAX_LEN];
+    const char *names[] = {"pong.ch8", "brix.ch8", "tetris.ch8"};
+    uint8_t rom[] = {0x12, 0x00};
+    static RomPicker picker;
+
+    assert(mkdtemp(dir));
+
+    for (int i = 0; i < 3; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+
+        FILE *f = fopen(path, "wb");
+
+        assert(f);
+        fwrite(rom, 1, sizeof(rom), f);
+        fclose(f);
+    }
+
+    assert(RomPicker_Init(&picker, dir, 2) == 0);
+    assert(picker.rom_count == 0);
+
+    while (RomPicker_IsScanning(&picker) || picker.metadata_cursor < picker.rom_count)
+    {
+        RomPicker_Update(&picker);
+    }
+
+    assert(picker.rom_count == 3);
+    assert(strcmp(RomPicker_GetSelectedRomName(&picker), "brix.ch8") == 0);
+    assert(RomPicker_GetSelectedEntry(&picker)->hash == Chip8_Hash(rom, sizeof(rom)));
+
+    RomPicker_Down(&picker);
+    RomPicker_Down(&picker);
+    assert(picker.cursor == 2 && picker.scroll == 1);
+    RomPicker_Down(&picker);
+    assert(picker.cursor == 0 && picker.scroll == 0);
+
+    RomPicker_SetFilter(&picker, "ON");
+    assert(picker.visible_count == 1);
+    assert(strcmp(RomPicker_GetSelectedRomName(&picker), "pong.ch8") == 0);
+    RomPicker_MarkPlayed(&picker);
+    RomPicker_FilterErase(&picker);
+    assert(picker.visible_count == 1);
+    RomPicker_SetFilter(&picker, "");
+    assert(picker.visible_count == 3 && picker.cursor == 1);
+
+    // reopening lists the cached entries before any scanning
+    RomPicker_Deinit(&picker);
+    assert(RomPicker_Init(&picker, dir, 2) == 0);
+    assert(picker.rom_count == 3);
+    assert(picker.entries[1].last_played != 0 && picker.entries[1].hash == Chip8_Hash(rom, sizeof(rom)));
+    RomPicker_Deinit(&picker);
+
+    for (int i = 0; i < 3; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+        remove(path);
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", dir, ROM_PICKER_CACHE_FILE);
+    remove(path);
+    rmdir(dir);
+}
+
+static void TestPreloader(void)
+{
+    char path[] = "/tmp/chip8_tests_XXXXXX";
+    uint8_t rom[] = {0x60, 0x2A, 0x12, 0x02};
+    static Preloader preloader;
+    static Chip8 chip8;
+    int fd = mkstemp(path);
+
+    assert(fd >= 0);
+    assert(write(fd, rom, sizeof(rom)) == sizeof(rom));
+    close(fd);
+
+    const char *paths[] = {path, "/tmp/chip8_tests_missing"};
+
+    assert(Preloader_Init(&preloader) == 0);
+    Preloader_Request(&preloader, paths, 2);
+
+    // wait for the background thread (up to ~5 seconds)
+    for (int i = 0; i < 5000 && Preloader_Take(&preloader, path, &chip8) < 0; i++)
+    {
+        Preloader_Update(&preloader);
+        usleep(1000);
+    }
+
+    assert(memcmp(chip8.mem + PROGRAM_START_ADDR, rom, sizeof(rom)) == 0);
+    assert(chip8.pc == PROGRAM_START_ADDR && chip8.program_hash == Chip8_Hash(rom, sizeof(rom)));
+    assert(Preloader_Take(&preloader, paths[1], &chip8) < 0);
+
+    // slots of ROMs that are no longer requested are released
+    Preloader_Request(&preloader, paths + 1, 1);
+    assert(Preloader_Take(&preloader, path, &chip8) < 0);
+
+    Preloader_Deinit(&preloader);
+    remove(path);
+}
+
+static int WaitThumbnail(Thumbnailer *thumbnailer, Thumbnail *thumbnail)
+{
+    // wait for the worker threads (up to ~5 seconds)
+    for (int i = 0; i < 5000; i++)
+    {
+        Thumbnailer_Update(thumbnailer);
+
+        if (Thumbnailer_Poll(thumbnailer, thumbnail) == 0) return 0;
+
+        usleep(1000);
+    }
+
+    return -1;
+}
+
+static void TestThumbnailer(void)
+{
+    char dir[] = "/tmp/chip8_tests_XXXXXX";
+    uint8_t rom[] = {
+        0xA2, 0x06, // 0x200: LD I, 0x206
+        0xD0, 0x01, // 0x202: DRW V0, V0, 0x1
+        0x12, 0x04, // 0x204: JP 0x204
+        0xFF        // 0x206: sprite data
+    };
+    static Thumbnailer thumbnailer;
+    Thumbnailer_Job job = {.hash = Chip8_Hash(rom, sizeof(rom))};
+    Thumbnail thumbnail;
+    char cache_path[ROM_PATH_MAX_LEN + 32];
+
+    assert(mkdtemp(dir));
+    snprintf(job.path, sizeof(job.path), "%s/rom.ch8", dir);
+
+    FILE *f = fopen(job.path, "wb");
+
+    assert(f);
+    fwrite(rom, 1, sizeof(rom), f);
+    fclose(f);
+
+    assert(Thumbnailer_Init(&thumbnailer, dir, NULL) == 0);
+    Thumbnailer_Request(&thumbnailer, &job, 1);
+    assert(WaitThumbnail(&thumbnailer, &thumbnail) == 0);
+    assert(thumbnail.hash == job.hash);
+    assert(thumbnail.pixels[0] == 0xFF && thumbnail.pixels[1] == 0);
+    assert(Thumbnail_GetPixel(&thumbnail, 7) && !Thumbnail_GetPixel(&thumbnail, 8));
+
+    // the second time it comes from the disk cache, even without the ROM
+    remove(job.path);
+    Thumbnailer_Request(&thumbnailer, &job, 1);
+    assert(WaitThumbnail(&thumbnailer, &thumbnail) == 0);
+    assert(thumbnail.pixels[0] == 0xFF);
+
+    // a thumbnail waiting to be polled is not requested again
+    Thumbnailer_Request(&thumbnailer, &job, 1);
+
+    int waiting = 1;
+
+    for (int i = 0; i < 5000 && waiting; i++)
+    {
+        usleep(1000);
+        pthread_mutex_lock(&thumbnailer.mutex);
+        waiting = thumbnailer.result_count == 0;
+        pthread_mutex_unlock(&thumbnailer.mutex);
+    }
+
+    Thumbnailer_Request(&thumbnailer, &job, 1);
+    pthread_mutex_lock(&thumbnailer.mutex);
+    assert(thumbnailer.job_count == 0 && thumbnailer.result_count == 1);
+    assert(thumbnailer.in_progress[0] == 0 && thumbnailer.in_progress[1] == 0);
+    pthread_mutex_unlock(&thumbnailer.mutex);
+    assert(WaitThumbnail(&thumbnailer, &thumbnail) == 0);
+
+    // instances have their own workers
+    static Thumbnailer other;
+
+    assert(Thumbnailer_Init(&other, dir, NULL) == 0);
+    Thumbnailer_Request(&thumbnailer, &job, 1);
+    assert(WaitThumbnail(&thumbnailer, &thumbnail) == 0 && thumbnail.hash == job.hash);
+    Thumbnailer_Deinit(&other);
+    Thumbnailer_Deinit(&thumbnailer);
+
+    snprintf(cache_path, sizeof(cache_path), "%s/%016llx.pbm", thumbnailer.cache_dir, (unsigned long long)job.hash);
+    assert(remove(cache_path) == 0);
+    rmdir(thumbnailer.cache_dir);
+    rmdir(dir);
+}
+
+static void TestRomDb(void)
+{
+    RomDb db;
+    Chip8 chip8;
+    char error[ROM_DB_ERROR_MAX_LEN];
+    uint8_t rom[] = {0x12, 0x00};
+    const RomDb_Settings *settings;
+
+    assert(RomDb_Init(&db) == 0);
+
+    Chip8_Init(&chip8);
+    Chip8_Load(&chip8, rom, sizeof(rom));
+    assert(chip8.program_hash == Chip8_Hash(rom, sizeof(rom)));
+    assert(RomDb_Find(&db, chip8.program_hash) == NULL);
+
+    char text[256];
+
+    snprintf(text, sizeof(text),
+            "# comment\n"
+            "%016llx frequency=1000 quirks=shift_vy,vf_reset\n"
+            "\n"
+            "00000000000000ff keymap=x123qweasdzc4rfv\n"
+            "%016llx quirks=none # later lines override the fields they set\n",
+            (unsigned long long)chip8.program_hash, (unsigned long long)chip8.program_hash);
+
+    assert(RomDb_Parse(&db, text, error, sizeof(error)) == 0);
+    assert(db.count == 2);
+    assert(db.entries[0].hash == 0xFF);
+    assert(db.entries[0].fields == ROM_DB_KEYMAP);
+    assert(strcmp(db.entries[0].keymap, "x123qweasdzc4rfv") == 0);
+
+    settings = RomDb_Find(&db, chip8.program_hash);
+    assert(settings);
+    assert(settings->fields == (ROM_DB_FREQUENCY | ROM_DB_QUIRKS));
+    assert(settings->frequency == 1000 && settings->quirks == 0);
+
+    // a later file overrides the settings field by field
+    assert(RomDb_Parse(&db, "00000000000000ff frequency=700 quirks=draw_clip", error, sizeof(error)) == 0);
+    assert(db.count == 2);
+    assert(db.entries[0].fields == (ROM_DB_FREQUENCY | ROM_DB_QUIRKS | ROM_DB_KEYMAP));
+    assert(db.entries[0].quirks == CHIP8_QUIRK_DRAW_CLIP);
+
+    Chip8_SetQuirks(&chip8, CHIP8_QUIRK_ALL);
+    RomDb_Apply(settings, &chip8);
+    assert(chip8.frequency == 1000);
+    assert(chip8.tick_secs == 1.0 / 1000);
+    assert(chip8.quirks == 0);
+
+    // errors leave the database untouched
+    assert(RomDb_Parse(&db, "00000000000000aa frequency=700\n12 quirks=none", error, sizeof(error)) < 0);
+    assert(strncmp(error, "line 2:", 7) == 0);
+    assert(RomDb_Parse(&db, "00000000000000aa quirks=unknown", error, sizeof(error)) < 0);
+    assert(RomDb_Parse(&db, "00000000000000aa keymap=abc", error, sizeof(error)) < 0);
+    assert(RomDb_Parse(&db, "00000000000000aa speed=2", error, sizeof(error)) < 0);
+    assert(RomDb_Find(&db, 0xAA) == NULL);
+    assert(RomDb_LoadFile(&db, "/tmp/chip8_tests_missing.db", error, sizeof(error)) < 0);
+
+    RomDb_Deinit(&db);
+}
+
+#ifdef CHIP8_PROFILER
+
+static void TestProfiler(void)
+{
+    uint8_t program[] = {
+        0x22, 0x06, // 0x200: CALL 0x206
+        0x00, 0xE0, // 0x202: CLS
+        0x12, 0x04, // 0x204: JP 0x204
+        0x60, 0x01, // 0x206: LD V0, 0x1
+        0x00, 0xEE  // 0x208: RET
+    };
+    Chip8 chip8;
+    Chip8_Profiler profiler;
+
+    Chip8_Init(&chip8);
+    Chip8_Load(&chip8, program, sizeof(program));
+    Chip8_ResetProfiler(&profiler);
+    Chip8_SetProfiler(&chip8, &profiler);
+
+    for (int i = 0; i < 6; i++)
+    {
+        Chip8_Tick(&chip8);
+    }
+
+    assert(profiler.instruction_counts[CALL_ADDR] == 1);
+    assert(profiler.instruction_counts[LD_VX_BYTE] == 1);
+    assert(profiler.instruction_counts[RET] == 1);
+    assert(profiler.instruction_counts[CLS] == 1);
+    assert(profiler.instruction_counts[JP_ADDR] == 2);
+    assert(profiler.pc_counts[0x204] == 2);
+    assert(profiler.pc_counts[0x206] == 1);
+    assert(profiler.call_node_count == 2);
+    assert(profiler.current_call_node == 0);
+    assert(profiler.call_nodes[0].instruction_count == 4);
+    assert(profiler.call_nodes[1].addr == 0x206);
+    assert(profiler.call_nodes[1].instruction_count == 2);
+
+    FILE *f = tmpfile();
+    char collapsed[64] = {0};
+
+    Chip8_WriteProfileCollapsed(&profiler, f);
+    rewind(f);
+    fread(collapsed, 1, sizeof(collapsed) - 1, f);
+    fclose(f);
+
+    assert(strcmp(collapsed, "0x200 4\n0x200;0x206 2\n") == 0);
+}
+
+#endif // CHIP8_PROFILER
@@ -0,0 +1,354 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "thumbnailer.h"
+
+#define THUMBNAIL_KEYS_PERIOD 64 // instructions between two random key changes
+
+static int TakeJob(Thumbnailer *thumbnailer, Thumbnailer_Job *job, unsigned int worker);
+static void FinishJob(Thumbnailer *thumbnailer, const Thumbnail *thumbnail, unsigned int worker);
+static void GenerateThumbnail(Thumbnailer *thumbnailer, const Thumbnailer_Job *job, Thumbnail *thumbnail);
+static int RunRom(Thumbnailer *thumbnailer, const char *path, uint64_t seed, Thumbnail *thumbnail);
+static int ReadCachedThumbnail(const char *path, Thumbnail *thumbnail);
+static void WriteCachedThumbnail(const char *path, const Thumbnail *thumbnail);
+static int IsQueued(Thumbnailer *thumbnailer, uint64_t hash);
+static uint16_t NextRandomKeys(void);
+static void Lock(Thumbnailer *thumbnailer);
+static void Unlock(Thumbnailer *thumbnailer);
+#ifndef __EMSCRIPTEN__
+static void *RunWorker(void *data);
+#endif
+
+// each worker draws its own random keys
+static _Thread_local uint32_t rng_state;
+
+int Thumbnailer_Init(Thumbnailer *thumbnailer, const char *roms_path, const RomDb *db)
+{
+    memset(thumbnailer, 0, sizeof(Thumbnailer));
+    thumbnailer->db = db;
+
+    snprintf(thumbnailer->cache_dir, ROM_PATH_MAX_LEN, "%s/%s", roms_path, THUMBNAIL_CACHE_DIR);
+
+    // without a cache directory thumbnails are still generated, just not kept
+    mkdir(thumbnailer->cache_dir, 0755);
+
+#ifndef __EMSCRIPTEN__
+    pthread_mutex_init(&thumbnailer->mutex, NULL);
+    pthread_cond_init(&thumbnailer->cond, NULL);
+
+    for (unsigned int i = 0; i < THUMBNAILER_WORKER_COUNT; i++)
+    {
+        thumbnailer->worker_args[i] = (Thumbnailer_WorkerArgs){thumbnailer, i};
+
+        if (pthread_create(&thumbnailer->workers[i], NULL, RunWorker, &thumbnailer->worker_args[i]) != 0)
+        {
+            return -1;
+        }
+    }
+#endif
+
+    return 0;
+}
+
+void Thumbnailer_Deinit(Thumbnailer *thumbnailer)
+{
+#ifndef __EMSCRIPTEN__
+    Lock(thumbnailer);
+    thumbnailer->quit = 1;
+    pthread_cond_broadcast(&thumbnailer->cond);
+    Unlock(thumbnailer);
+
+    for (unsigned int i = 0; i < THUMBNAILER_WORKER_COUNT; i++)
+    {
+        pthread_join(thumbnailer->workers[i], NULL);
+    }
+
+    pthread_mutex_destroy(&thumbnailer->mutex);
+    pthread_cond_destroy(&thumbnailer->cond);
+#else
+    (void)thumbnailer;
+#endif
+}
+
+void Thumbnailer_Request(Thumbnailer *thumbnailer, const Thumbnailer_Job *jobs, unsigned int count)
+{
+    Lock(thumbnailer);
+
+    // the pending jobs are replaced, so scrolling quickly never builds up a backlog
+    thumbnailer->job_count = 0;
+
+    for (unsigned int i = 0; i < count && thumbnailer->job_count < THUMBNAILER_QUEUE_SIZE; i++)
+    {
+        if (!IsQueued(thumbnailer, jobs[i].hash))
+        {
+            thumbnailer->jobs[thumbnailer->job_count++] = jobs[i];
+        }
+    }
+
+#ifndef __EMSCRIPTEN__
+    if (thumbnailer->job_count > 0)
+    {
+        pthread_cond_broadcast(&thumbnailer->cond);
+    }
+#endif
+
+    Unlock(thumbnailer);
+}
+
+void Thumbnailer_Update(Thumbnailer *thumbnailer)
+{
+#ifdef __EMSCRIPTEN__
+    // no threads, generate a single thumbnail per frame
+    Thumbnailer_Job job;
+    Thumbnail thumbnail;
+
+    if (TakeJob(thumbnailer, &job, 0))
+    {
+        GenerateThumbnail(thumbnailer, &job, &thumbnail);
+        FinishJob(thumbnailer, &thumbnail, 0);
+    }
+#else
+    (void)thumbnailer;
+#endif
+}
+
+int Thumbnailer_Poll(Thumbnailer *thumbnailer, Thumbnail *thumbnail)
+{
+    int ret = -1;
+
+    Lock(thumbnailer);
+
+    if (thumbnailer->result_count > 0)
+    {
+        *thumbnail = thumbnailer->results[thumbnailer->result_head];
+        thumbnailer->result_head = (thumbnailer->result_head + 1) % THUMBNAILER_QUEUE_SIZE;
+        thumbnailer->result_count--;
+        ret = 0;
+    }
+
+    Unlock(thumbnailer);
+
+    return ret;
+}
+
+int Thumbnail_GetPixel(const Thumbnail *thumbnail, unsigned int index)
+{
+    return (thumbnail->pixels[index / 8] >> (7 - index % 8)) & 1;
+}
+
+// must be called with the lock held
+static int TakeJob(Thumbnailer *thumbnailer, Thumbnailer_Job *job, unsigned int worker)
+{
+    if (thumbnailer->job_count == 0)
+    {
+        return 0;
+    }
+
+    // the first requested jobs are the most wanted ones
+    *job = thumbnailer->jobs[0];
+    memmove(thumbnailer->jobs, thumbnailer->jobs + 1, sizeof(Thumbnailer_Job) * --thumbnailer->job_count);
+    thumbnailer->in_progress[worker] = job->hash;
+
+    return 1;
+}
+
+// must be called with the lock held
+static void FinishJob(Thumbnailer *thumbnailer, const Thumbnail *thumbnail, unsigned int worker)
+{
+    unsigned int tail = (thumbnailer->result_head + thumbnailer->result_count) % THUMBNAILER_QUEUE_SIZE;
+
+    if (thumbnailer->result_count == THUMBNAILER_QUEUE_SIZE)
+    {
+        // drop the oldest result, it will be requested again if still needed
+        thumbnailer->result_head = (thumbnailer->result_head + 1) % THUMBNAILER_QUEUE_SIZE;
+        thumbnailer->result_count--;
+    }
+
+    thumbnailer->results[tail] = *thumbnail;
+    thumbnailer->result_count++;
+    thumbnailer->in_progress[worker] = 0;
+}
+
+static void GenerateThumbnail(Thumbnailer *thumbnailer, const Thumbnailer_Job *job, Thumbnail *thumbnail)
+{
+    char cache_path[ROM_PATH_MAX_LEN];
+    int cached = snprintf(cache_path, sizeof(cache_path), "%s/%016" PRIx64 ".pbm", thumbnailer->cache_dir, job->hash) < ROM_PATH_MAX_LEN;
+
+    memset(thumbnail, 0, sizeof(Thumbnail));
+
+    if (cached && ReadCachedThumbnail(cache_path, thumbnail) == 0)
+    {
+        thumbnail->hash = job->hash;
+        return;
+    }
+
+    if (RunRom(thumbnailer, job->path, job->hash, thumbnail) == 0 && cached)
+    {
+        WriteCachedThumbnail(cache_path, thumbnail);
+    }
+
+    thumbnail->hash = job->hash;
+}
+
+static int RunRom(Thumbnailer *thumbnailer, const char *path, uint64_t seed, Thumbnail *thumbnail)
+{
+    Chip8 *chip8 = malloc(sizeof(Chip8));
+    int ret = -1;
+
+    Chip8_Init(chip8);
+
+    if (Chip8_LoadFromFile(chip8, path) == 0)
+    {
+        // the database is only read once initialized, it can be shared by the workers
+        const RomDb_Settings *settings = thumbnailer->db ? RomDb_Find(thumbnailer->db, chip8->program_hash) : NULL;
+
+        if (settings) RomDb_Apply(settings, chip8);
+
+        // seeded with the ROM hash so a ROM always gets the same thumbnail
+        rng_state = (uint32_t)(seed ^ (seed >> 32)) | 1;
+        Chip8_SetSeed(chip8, rng_state);
+
+        // random key presses usually get the ROM past its title screen
+        for (unsigned int i = 0; i < THUMBNAIL_EMULATED_SECS * chip8->frequency; i++)
+        {
+            if (i % THUMBNAIL_KEYS_PERIOD == 0)
+            {
+                Chip8_SetKeys(chip8, NextRandomKeys());
+            }
+
+            if (!Chip8_Tick(chip8)) break;
+        }
+
+        memcpy(thumbnail->pixels, chip8->display, DISPLAY_SIZE);
+        ret = 0;
+    }
+
+    free(chip8);
+
+    return ret;
+}
+
+static int ReadCachedThumbnail(const char *path, Thumbnail *thumbnail)
+{
+    FILE *f = fopen(path, "rb");
+    int width, height;
+
+    if (!f)
+    {
+        return -1;
+    }
+
+    // binary PBM, rows of 1 bit pixels like the chip-8 display
+    int ret = fscanf(f, "P4 %d %d", &width, &height) == 2 && width == DISPLAY_WIDTH && height == DISPLAY_HEIGHT &&
+        fgetc(f) != EOF && fread(thumbnail->pixels, 1, DISPLAY_SIZE, f) == DISPLAY_SIZE ? 0 : -1;
+
+    fclose(f);
+
+    return ret;
+}
+
+static void WriteCachedThumbnail(const char *path, const Thumbnail *thumbnail)
+{
+    char tmp_path[ROM_PATH_MAX_LEN + 16];
+
+    // workers may generate the same thumbnail concurrently, never expose a partially written file
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%p", path, (void *)thumbnail);
+
+    FILE *f = fopen(tmp_path, "wb");
+
+    if (!f)
+    {
+        return;
+    }
+
+    fprintf(f, "P4\n%d %d\n", DISPLAY_WIDTH, DISPLAY_HEIGHT);
+
+    int ok = fwrite(thumbnail->pixels, 1, DISPLAY_SIZE, f) == DISPLAY_SIZE;
+
+    if (fclose(f) != 0 || !ok || rename(tmp_path, path) < 0)
+    {
+        remove(tmp_path);
+    }
+}
+
+// true for a job pending, in progress or finished but not polled yet
+static int IsQueued(Thumbnailer *thumbnailer, uint64_t hash)
+{
+    for (unsigned int i = 0; i < thumbnailer->job_count; i++)
+    {
+        if (thumbnailer->jobs[i].hash == hash) return 1;
+    }
+
+    for (unsigned int i = 0; i < THUMBNAILER_WORKER_COUNT; i++)
+    {
+        if (thumbnailer->in_progress[i] == hash) return 1;
+    }
+
+    for (unsigned int i = 0; i < thumbnailer->result_count; i++)
+    {
+        if (thumbnailer->results[(thumbnailer->result_head + i) % THUMBNAILER_QUEUE_SIZE].hash == hash) return 1;
+    }
+
+    return 0;
+}
+
+static uint16_t NextRandomKeys(void)
+{
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+
+    return rng_state & 0xFFFF;
+}
+
+#ifndef __EMSCRIPTEN__
+
+static void *RunWorker(void *data)
+{
+    Thumbnailer_WorkerArgs *args = data;
+    Thumbnailer *thumbnailer = args->thumbnailer;
+    Thumbnailer_Job job;
+    Thumbnail thumbnail;
+
+    Lock(thumbnailer);
+
+    while (!thumbnailer->quit)
+    {
+        if (!TakeJob(thumbnailer, &job, args->index))
+        {
+            pthread_cond_wait(&thumbnailer->cond, &thumbnailer->mutex);
+            continue;
+        }
+
+        Unlock(thumbnailer);
+        GenerateThumbnail(thumbnailer, &job, &thumbnail);
+        Lock(thumbnailer);
+
+        FinishJob(thumbnailer, &thumbnail, args->index);
+    }
+
+    Unlock(thumbnailer);
+
+    return NULL;
+}
+
+static void Lock(Thumbnailer *thumbnailer)
+{
+    pthread_mutex_lock(&thumbnailer->mutex);
+}
+
+static void Unlock(Thumbnailer *thumbnailer)
+{
+    pthread_mutex_unlock(&thumbnailer->mutex);
+}
+
+#else
+
+static void Lock(Thumbnailer *thumbnailer) { (void)thumbnailer; }
+static void Unlock(Thumbnailer *thumbnailer) { (void)thumbnailer; }
+
+#endif // __EMSCRIPTEN__
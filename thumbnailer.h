@@ -0,0 +1,68 @@
+#ifndef THUMBNAILER_H
+#define THUMBNAILER_H
+
+#include <stdint.h>
+
+#ifndef __EMSCRIPTEN__
+#include <pthread.h>
+#endif
+
+#include "chip-8.h"
+#include "rom_db.h"
+#include "rom_picker.h"
+
+#define THUMBNAILER_WORKER_COUNT 2
+#define THUMBNAILER_QUEUE_SIZE 32
+#define THUMBNAIL_EMULATED_SECS 5.0
+#define THUMBNAIL_CACHE_DIR ".thumbnails"
+
+// the display at the end of a short headless run of the ROM, one bit per pixel
+typedef struct Thumbnail
+{
+    uint64_t hash;
+    uint8_t pixels[DISPLAY_SIZE]; // same layout as Chip8.display
+} Thumbnail;
+
+typedef struct Thumbnailer_Job
+{
+    char path[ROM_PATH_MAX_LEN];
+    uint64_t hash;
+} Thumbnailer_Job;
+
+typedef struct Thumbnailer_WorkerArgs
+{
+    struct Thumbnailer *thumbnailer;
+    unsigned int index;
+} Thumbnailer_WorkerArgs;
+
+/*
+ * Generates ROMs thumbnails on worker threads (or a thumbnail per Thumbnailer_Update call when built
+ * without threads, e.g. with emscripten) and caches them on disk, keyed by ROM hash.
+ */
+typedef struct Thumbnailer
+{
+    char cache_dir[ROM_PATH_MAX_LEN];
+    const RomDb *db;                            // per-ROM settings applied before running ROMs, may be NULL
+    Thumbnailer_Job jobs[THUMBNAILER_QUEUE_SIZE];
+    unsigned int job_count;
+    Thumbnail results[THUMBNAILER_QUEUE_SIZE]; // ring buffer of finished thumbnails
+    unsigned int result_head;
+    unsigned int result_count;
+    uint64_t in_progress[THUMBNAILER_WORKER_COUNT];
+#ifndef __EMSCRIPTEN__
+    pthread_t workers[THUMBNAILER_WORKER_COUNT];
+    Thumbnailer_WorkerArgs worker_args[THUMBNAILER_WORKER_COUNT];
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int quit;
+#endif
+} Thumbnailer;
+
+int Thumbnailer_Init(Thumbnailer *thumbnailer, const char *roms_path, const RomDb *db);
+void Thumbnailer_Deinit(Thumbnailer *thumbnailer);
+void Thumbnailer_Request(Thumbnailer *thumbnailer, const Thumbnailer_Job *jobs, unsigned int count);
+void Thumbnailer_Update(Thumbnailer *thumbnailer);
+int Thumbnailer_Poll(Thumbnailer *thumbnailer, Thumbnail *thumbnail);
+int Thumbnail_GetPixel(const Thumbnail *thumbnail, unsigned int index);
+
+#endif // THUMBNAILER_H
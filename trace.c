@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+static void PreInstructionHook(Chip8 *chip8, Chip8_InstructionType instruction_type, uint16_t instruction, void *user_data);
+static void PostInstructionHook(Chip8 *chip8, Chip8_InstructionType instruction_type, uint16_t instruction, void *user_data);
+static unsigned int FindChangedRegister(const uint8_t *before, const uint8_t *after);
+static void SwapHeader(Trace_Header *header);
+static void SwapRecords(Trace_Record *records, size_t count);
+
+_Static_assert(sizeof(Trace_Record) == 16, "trace records must stay 16 bytes");
+
+int Trace_Open(Trace *trace, const char *path)
+{
+    memset(trace, 0, sizeof(Trace));
+
+    trace->f = fopen(path, "wb");
+
+    if (!trace->f)
+    {
+        return -1;
+    }
+
+    trace->records = malloc(sizeof(Trace_Record) * TRACE_RING_SIZE);
+
+    if (!trace->records)
+    {
+        fclose(trace->f);
+        return -1;
+    }
+
+    Trace_Header header = {.version = TRACE_VERSION, .record_size = sizeof(Trace_Record)};
+
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    SwapHeader(&header);
+
+    if (fwrite(&header, sizeof(Trace_Header), 1, trace->f) != 1)
+    {
+        Trace_Close(trace);
+        return -1;
+    }
+
+    return 0;
+}
+
+void Trace_Attach(Trace *trace, Chip8 *chip8)
+{
+    Chip8_Hooks hooks = {
+        .pre_instruction = PreInstructionHook,
+        .post_instruction = PostInstructionHook,
+        .user_data = trace
+    };
+
+    Chip8_SetHooks(chip8, &hooks);
+}
+
+// returns -1 if this or any previous flush failed, the records after a failure are dropped
+int Trace_Flush(Trace *trace)
+{
+    SwapRecords(trace->records, trace->record_count);
+
+    if (!trace->error
+            && fwrite(trace->records, sizeof(Trace_Record), trace->record_count, trace->f) != trace->record_count)
+    {
+        trace->error = 1;
+    }
+
+    trace->record_count = 0;
+
+    return trace->error ? -1 : 0;
+}
+
+int Trace_Close(Trace *trace)
+{
+    int ret = Trace_Flush(trace);
+
+    if (fclose(trace->f) != 0)
+    {
+        ret = -1;
+    }
+
+    free(trace->records);
+    trace->records = NULL;
+    trace->f = NULL;
+
+    return ret;
+}
+
+int Trace_ReadHeader(FILE *f)
+{
+    Trace_Header header;
+
+    if (fread(&header, sizeof(Trace_Header), 1, f) != 1)
+    {
+        return -1;
+    }
+
+    SwapHeader(&header);
+
+    if (memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0
+            || header.version != TRACE_VERSION
+            || header.record_size != sizeof(Trace_Record))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+// reads up to count records following the header, returns the number read
+size_t Trace_ReadRecords(FILE *f, Trace_Record *records, size_t count)
+{
+    size_t read = fread(records, sizeof(Trace_Record), count, f);
+
+    SwapRecords(records, read);
+
+    return read;
+}
+
+static void PreInstructionHook(Chip8 *chip8, Chip8_InstructionType instruction_type, uint16_t instruction, void *user_data)
+{
+    (void)instruction_type;
+    (void)instruction;
+
+    Trace *trace = user_data;
+    Trace_Record *record = &trace->records[trace->record_count];
+
+    record->cycle = trace->cycle;
+    record->pc = chip8->pc;
+    record->opcode = (chip8->mem[chip8->pc] << 8) | chip8->mem[chip8->pc + 1];
+
+    memcpy(trace->v_before, chip8->v, REGISTER_COUNT);
+}
+
+static void PostInstructionHook(Chip8 *chip8, Chip8_InstructionType instruction_type, uint16_t instruction, void *user_data)
+{
+    (void)instruction_type;
+    (void)instruction;
+
+    Trace *trace = user_data;
+    Trace_Record *record = &trace->records[trace->record_count];
+    unsigned int reg = FindChangedRegister(trace->v_before, chip8->v);
+
+    record->i = chip8->i;
+    record->reg = reg < REGISTER_COUNT ? reg : TRACE_NO_REGISTER;
+    record->reg_value = reg < REGISTER_COUNT ? chip8->v[reg] : 0;
+
+    trace->cycle++;
+
+    if (++trace->record_count == TRACE_RING_SIZE)
+    {
+        Trace_Flush(trace);
+    }
+}
+
+static unsigned int FindChangedRegister(const uint8_t *before, const uint8_t *after)
+{
+    // compare the registers 8 at a time, the changed byte at the lowest address gives the register
+    for (unsigned int offset = 0; offset < REGISTER_COUNT; offset += 8)
+    {
+        uint64_t a, b;
+
+        memcpy(&a, before + offset, 8);
+        memcpy(&b, after + offset, 8);
+
+        if (a != b)
+        {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return offset + __builtin_clzll(a ^ b) / 8;
+#else
+            return offset + __builtin_ctzll(a ^ b) / 8;
+#endif
+        }
+    }
+
+    return REGISTER_COUNT;
+}
+
+// converts between the host and the file byte order, both ways, nothing to do on little endian hosts
+static void SwapHeader(Trace_Header *header)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    header->version = __builtin_bswap16(header->version);
+    header->record_size = __builtin_bswap16(header->record_size);
+#else
+    (void)header;
+#endif
+}
+
+static void SwapRecords(Trace_Record *records, size_t count)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (size_t r = 0; r < count; r++)
+    {
+        records[r].cycle = __builtin_bswap64(records[r].cycle);
+        records[r].pc = __builtin_bswap16(records[r].pc);
+        records[r].opcode = __builtin_bswap16(records[r].opcode);
+        records[r].i = __builtin_bswap16(records[r].i);
+    }
+#else
+    (void)records;
+    (void)count;
+#endif
+}
@@ -0,0 +1,50 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip-8.h"
+
+#define TRACE_MAGIC "C8TR"
+#define TRACE_VERSION 1
+#define TRACE_RING_SIZE 65536 // records buffered in memory before being flushed to disk
+#define TRACE_NO_REGISTER 0xFF
+
+// A trace file is a Trace_Header followed by Trace_Record entries, both stored little endian as laid out below
+// (big endian hosts swap them on the way to and from the file, see Trace_ReadRecords).
+typedef struct Trace_Header
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+} Trace_Header;
+
+typedef struct Trace_Record
+{
+    uint64_t cycle;     // number of instructions executed before this one
+    uint16_t pc;        // address of the instruction
+    uint16_t opcode;    // raw 16 bits opcode
+    uint16_t i;         // value of I after the instruction
+    uint8_t reg;        // first V register changed by the instruction (TRACE_NO_REGISTER if none)
+    uint8_t reg_value;  // value of that register after the instruction
+} Trace_Record;
+
+typedef struct Trace
+{
+    FILE *f;
+    Trace_Record *records;      // ring buffer
+    unsigned int record_count;  // records currently in the ring buffer
+    uint64_t cycle;
+    uint8_t v_before[REGISTER_COUNT];
+    int error;                  // set once a flush failed, Trace_Close then reports it
+} Trace;
+
+int Trace_Open(Trace *trace, const char *path);
+void Trace_Attach(Trace *trace, Chip8 *chip8);
+int Trace_Flush(Trace *trace);
+int Trace_Close(Trace *trace);
+int Trace_ReadHeader(FILE *f);
+size_t Trace_ReadRecords(FILE *f, Trace_Record *records, size_t count);
+
+#endif // TRACE_H
@@ -0,0 +1,63 @@
+#include <stdio.h>
+
+#include "chip-8.h"
+#include "disasm.h"
+#include "trace.h"
+
+#define DECODE_BATCH_SIZE 4096
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        printf("Usage: trace_decoder TRACE_PATH\n");
+        return 1;
+    }
+
+    const char *trace_path = argv[1];
+    FILE *f = fopen(trace_path, "rb");
+
+    if (!f)
+    {
+        printf("Failed to open trace (path: %s)\n", trace_path);
+        return 1;
+    }
+
+    if (Trace_ReadHeader(f) < 0)
+    {
+        printf("Invalid trace file (path: %s)\n", trace_path);
+        fclose(f);
+        return 1;
+    }
+
+    static Trace_Record records[DECODE_BATCH_SIZE];
+    char mnemonic[DISASM_MNEMONIC_MAX_LEN];
+    size_t count;
+
+    while ((count = Trace_ReadRecords(f, records, DECODE_BATCH_SIZE)) > 0)
+    {
+        for (size_t r = 0; r < count; r++)
+        {
+            Trace_Record *record = &records[r];
+            Chip8_InstructionType instruction_type;
+            uint16_t instruction;
+
+            Chip8_DecodeInstruction(record->opcode, &instruction_type, &instruction);
+            Disasm_FormatInstruction(instruction_type, instruction, mnemonic, sizeof(mnemonic));
+
+            printf("%llu\t0x%03X\t%04X\t%-20s I=0x%03X",
+                    (unsigned long long)record->cycle, record->pc, record->opcode, mnemonic, record->i);
+
+            if (record->reg != TRACE_NO_REGISTER)
+            {
+                printf(" V%X=0x%02X", record->reg, record->reg_value);
+            }
+
+            printf("\n");
+        }
+    }
+
+    fclose(f);
+
+    return 0;
+}
@@ -0,0 +1,176 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "vec_env.h"
+
+// unpacked pixels of byte b, most significant bit first
+#define UNPACK_1(b) {(b) >> 7 & 1, (b) >> 6 & 1, (b) >> 5 & 1, (b) >> 4 & 1, \
+        (b) >> 3 & 1, (b) >> 2 & 1, (b) >> 1 & 1, (b) & 1}
+#define UNPACK_4(b) UNPACK_1(b), UNPACK_1((b) + 1), UNPACK_1((b) + 2), UNPACK_1((b) + 3)
+#define UNPACK_16(b) UNPACK_4(b), UNPACK_4((b) + 4), UNPACK_4((b) + 8), UNPACK_4((b) + 12)
+#define UNPACK_64(b) UNPACK_16(b), UNPACK_16((b) + 16), UNPACK_16((b) + 32), UNPACK_16((b) + 48)
+
+static void ResetInstance(VecEnv *env, unsigned int index);
+static void WriteObservation(VecEnv *env, unsigned int index);
+
+// unpacked pixels of each display byte, written 8 pixels at a time; built at compile time so concurrent
+// VecEnv_Init calls never write it
+static const uint8_t unpacked_bytes[256][8] = {UNPACK_64(0), UNPACK_64(64), UNPACK_64(128), UNPACK_64(192)};
+
+int VecEnv_Init(VecEnv *env, const Chip8 *template, unsigned int count, unsigned int frames_per_step,
+        VecEnv_ObsFormat obs_format, uint8_t *observations, float *rewards, uint8_t *dones)
+{
+    memset(env, 0, sizeof(VecEnv));
+
+    env->instances = malloc(sizeof(Chip8) * count);
+    env->template = malloc(sizeof(Chip8));
+    env->before = malloc(sizeof(Chip8));
+    env->episode_frames = calloc(count, sizeof(unsigned int));
+    env->episodes = calloc(count, sizeof(uint32_t));
+
+    if (!env->instances || !env->template || !env->before || !env->episode_frames || !env->episodes)
+    {
+        VecEnv_Deinit(env);
+        return -1;
+    }
+
+    memcpy(env->template, template, sizeof(Chip8));
+    // the actions are set on each instance before it runs
+    Chip8_SetGetKeysCallback(env->template, NULL, NULL);
+
+    env->count = count;
+    env->frame_len = template->frequency / VEC_ENV_FRAME_RATE + 0.5;
+    env->frames_per_step = frames_per_step;
+    env->obs_format = obs_format;
+    env->observations = observations;
+    env->rewards = rewards;
+    env->dones = dones;
+
+    if (env->frame_len == 0) env->frame_len = 1;
+
+    VecEnv_Reset(env);
+
+    return 0;
+}
+
+void VecEnv_Deinit(VecEnv *env)
+{
+    free(env->instances);
+    free(env->template);
+    free(env->before);
+    free(env->episode_frames);
+    free(env->episodes);
+    memset(env, 0, sizeof(VecEnv));
+}
+
+void VecEnv_SetReward(VecEnv *env, VecEnv_RewardFn reward, void *user_data)
+{
+    env->reward = reward;
+    env->reward_user_data = user_data;
+}
+
+void VecEnv_Reset(VecEnv *env)
+{
+    for (unsigned int i = 0; i < env->count; i++)
+    {
+        ResetInstance(env, i);
+        WriteObservation(env, i);
+        env->rewards[i] = 0;
+        env->dones[i] = 0;
+    }
+}
+
+void VecEnv_Step(VecEnv *env, const uint16_t *actions)
+{
+    unsigned int step_len = env->frame_len * env->frames_per_step;
+
+    for (unsigned int i = 0; i < env->count; i++)
+    {
+        Chip8 *chip8 = &env->instances[i];
+
+        if (env->reward) memcpy(env->before, chip8, sizeof(Chip8));
+
+        Chip8_SetKeys(chip8, actions[i]);
+
+        // a faulted or finished program runs less than the whole step
+        int done = Chip8_Run(chip8, step_len) < step_len;
+
+        env->episode_frames[i] += env->frames_per_step;
+        env->rewards[i] = env->reward ? env->reward(env->before, chip8, env->reward_user_data) : 0;
+
+        if (env->max_episode_frames && env->episode_frames[i] >= env->max_episode_frames) done = 1;
+
+        env->dones[i] = done;
+
+        if (done) ResetInstance(env, i);
+
+        WriteObservation(env, i);
+    }
+}
+
+size_t VecEnv_ObservationSize(VecEnv_ObsFormat obs_format)
+{
+    return obs_format == VEC_ENV_OBS_PACKED ? DISPLAY_SIZE : DISPLAY_WIDTH * DISPLAY_HEIGHT;
+}
+
+// maps a POSIX shared memory object, so another process (e.g. the training side) reads the same buffer
+void *VecEnv_MapShared(const char *name, size_t size)
+{
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    if (ftruncate(fd, size) < 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    void *buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    return buffer == MAP_FAILED ? NULL : buffer;
+}
+
+void VecEnv_UnmapShared(void *buffer, size_t size)
+{
+    munmap(buffer, size);
+}
+
+static void ResetInstance(VecEnv *env, unsigned int index)
+{
+    Chip8 *chip8 = &env->instances[index];
+
+    memcpy(chip8, env->template, sizeof(Chip8));
+
+    // every instance and episode gets its own random numbers, still reproducible from run to run
+    Chip8_SetSeed(chip8, (index + 1) * 0x9E3779B9 + env->episodes[index]);
+
+    env->episodes[index]++;
+    env->episode_frames[index] = 0;
+}
+
+static void WriteObservation(VecEnv *env, unsigned int index)
+{
+    const uint8_t *display = env->instances[index].display;
+
+    if (env->obs_format == VEC_ENV_OBS_PACKED)
+    {
+        memcpy(env->observations + index * DISPLAY_SIZE, display, DISPLAY_SIZE);
+        return;
+    }
+
+    uint8_t *pixels = env->observations + index * DISPLAY_WIDTH * DISPLAY_HEIGHT;
+
+    for (int i = 0; i < DISPLAY_SIZE; i++)
+    {
+        memcpy(pixels + i * 8, unpacked_bytes[display[i]], 8);
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef VEC_ENV_H
+#define VEC_ENV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip-8.h"
+
+#define VEC_ENV_FRAME_RATE 60               // a frame runs frequency / 60 instructions
+
+// observation layouts
+typedef enum VecEnv_ObsFormat
+{
+    VEC_ENV_OBS_PACKED,                     // DISPLAY_SIZE bytes per instance, 1 bit per pixel (as Chip8.display)
+    VEC_ENV_OBS_UNPACKED                    // DISPLAY_WIDTH * DISPLAY_HEIGHT bytes per instance, 0 or 1 per pixel
+} VecEnv_ObsFormat;
+
+// reward of a step, given the state of an instance before and after it
+typedef float (*VecEnv_RewardFn)(const Chip8 *before, const Chip8 *after, void *user_data);
+
+/*
+ * Runs a batch of instances of the same ROM in lock step: each VecEnv_Step holds the keys given for each
+ * instance during frames_per_step frames, then writes observations, rewards and done flags straight into
+ * the buffers given at init (caller owned, possibly shared memory, see VecEnv_MapShared). Nothing is
+ * allocated or copied through intermediate buffers after VecEnv_Init.
+ *
+ * Instances that fault, reach the end of the program or run max_episode_frames frames are done: they are
+ * reset right away and their observation is the first one of the next episode.
+ */
+typedef struct VecEnv
+{
+    Chip8 *instances;
+    Chip8 *template;                        // loaded instance the episodes start from
+    unsigned int count;
+    unsigned int frame_len;                 // instructions per frame
+    unsigned int frames_per_step;
+    unsigned int max_episode_frames;        // 0 for no limit
+    VecEnv_ObsFormat obs_format;
+    uint8_t *observations;                  // count * VecEnv_ObservationSize(obs_format) bytes
+    float *rewards;                         // count entries
+    uint8_t *dones;                         // count entries
+    unsigned int *episode_frames;           // frames run by each instance in its episode
+    uint32_t *episodes;                     // episodes started by each instance, seeds RND
+    VecEnv_RewardFn reward;                 // NULL for no reward
+    void *reward_user_data;
+    Chip8 *before;                          // scratch state passed to the reward function
+} VecEnv;
+
+int VecEnv_Init(VecEnv *env, const Chip8 *template, unsigned int count, unsigned int frames_per_step,
+        VecEnv_ObsFormat obs_format, uint8_t *observations, float *rewards, uint8_t *dones);
+void VecEnv_Deinit(VecEnv *env);
+void VecEnv_SetReward(VecEnv *env, VecEnv_RewardFn reward, void *user_data);
+void VecEnv_Reset(VecEnv *env);
+void VecEnv_Step(VecEnv *env, const uint16_t *actions); // one key mask per instance, as given to Chip8_SetKeys
+size_t VecEnv_ObservationSize(VecEnv_ObsFormat obs_format);
+void *VecEnv_MapShared(const char *name, size_t size);
+void VecEnv_UnmapShared(void *buffer, size_t size);
+
+#endif // VEC_ENV_H
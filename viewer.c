@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "raylib.h"
+#include "frame_stream.h"
+#include "render.h"
+
+#define VIEWER_FPS 60
+
+static void SwitchInstance(FrameClient *client, int offset);
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        printf("Usage: viewer SOCKET_PATH [INSTANCE]\n");
+        return 1;
+    }
+
+    static FrameClient client;
+    static Render_Display display;
+    unsigned int instance = argc == 3 ? strtoul(argv[2], NULL, 10) : 0;
+
+    if (FrameClient_Connect(&client, argv[1]) < 0 || FrameClient_Subscribe(&client, instance) < 0)
+    {
+        printf("Failed to connect to the frame server (path: %s)\n", argv[1]);
+        return 1;
+    }
+
+    InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Chip-8 Viewer");
+    SetTargetFPS(VIEWER_FPS);
+
+    if (Render_LoadDisplay(&display) < 0)
+    {
+        CloseWindow();
+        FrameClient_Close(&client);
+        return 1;
+    }
+
+    int connected = 1;
+
+    Render_UpdateDisplay(&display, client.display);
+
+    while (!WindowShouldClose())
+    {
+        if (connected && IsKeyPressed(KEY_RIGHT)) SwitchInstance(&client, 1);
+        if (connected && IsKeyPressed(KEY_LEFT)) SwitchInstance(&client, -1);
+
+        // the last frame received stays on screen once the server is gone
+        int ret = connected ? FrameClient_Poll(&client) : 0;
+
+        if (ret < 0)
+        {
+            connected = 0;
+        }
+        else if (ret > 0)
+        {
+            Render_UpdateDisplay(&display, client.display);
+        }
+
+        const char *title = connected
+                ? TextFormat("Instance %d/%u", client.instance, client.instance_count)
+                : TextFormat("Instance %d (disconnected)", client.instance);
+
+        BeginDrawing();
+        ClearBackground(render_skin.colors[2]);
+        Render_DrawDisplay(&display);
+        Render_DrawHUD(title, TextFormat("Frame: %u", client.frame), "Left/Right to switch instance");
+        EndDrawing();
+    }
+
+    Render_UnloadDisplay(&display);
+    CloseWindow();
+    FrameClient_Close(&client);
+
+    return 0;
+}
+
+static void SwitchInstance(FrameClient *client, int offset)
+{
+    if (client->instance_count == 0) return;
+
+    unsigned int instance = (client->instance + client->instance_count + offset) % client->instance_count;
+
+    FrameClient_Subscribe(client, instance);
+}